@@ -48,6 +48,32 @@ namespace WarpTpsLib
 				Assert::IsTrue(m_times_v_ublas(2) == v(2), L"m_times_v_ublas(2) == v[2]");
 			}
 
+			TEST_METHOD(TestFixedVector)
+			{
+				static_assert(std::is_trivially_copyable<CFixedVector<3> >::value, "trivially copyable");
+				constexpr CFixedVector<3> vConst = CFixedVector<3>(1.0, 2.0) + CFixedVector<3>(0.0, 0.0, 4.0);
+				static_assert(vConst[0] == 1.0 && vConst[1] == 2.0 && vConst[2] == 4.0, "constexpr sum");
+
+				CFixedVector<3> vA(1.0, -2.0, 3.0), vB(0.5, 0.25, -1.0), vC(2.0, 2.0, 2.0);
+				CFixedVector<3> vResult = vA + vB - vC * 0.5;
+				Assert::AreEqual(0.5, vResult[0]);
+				Assert::AreEqual(-2.75, vResult[1]);
+				Assert::AreEqual(1.0, vResult[2]);
+				Assert::AreEqual(-3.0, Dot(vA, vB));
+				Assert::AreEqual(14.0, vA.GetLength2());
+
+				// an expression that refers to the vector it is assigned to
+				vResult = vB - vResult;
+				Assert::IsTrue(vResult == CFixedVector<3>(0.0, 3.0, -2.0));
+				vResult += 2.0 * vB;
+				Assert::IsTrue(vResult.IsApproxEqual(CFixedVector<3>(1.0, 3.5, -4.0)));
+
+				// round trip through CVectorD
+				CVectorD<3> vAdapter(vA);
+				Assert::IsTrue(vAdapter.IsApproxEqual(CVectorD<3>(1.0, -2.0, 3.0)));
+				Assert::IsTrue(vAdapter.GetFixed() == vA);
+			}
+
 
 			TEST_METHOD(TestAddLandmark)
 			{
@@ -113,10 +139,1384 @@ namespace WarpTpsLib
 				Logger::WriteMessage("Done TestWarpAtLandmarks");
 			}
 
+			// tests that moving destination landmarks (which reuses the 
+			//		factorization of L) still warps landmarks onto landmarks
+			TEST_METHOD(TestWarpAfterDestinationMove)
+			{
+				Logger::WriteMessage("TestWarpAfterDestinationMove");
+
+				CTPSTransform tpsTransform;
+				AddWarpLandmarks(tpsTransform, 120, 90);
+				AssertWarpsAtLandmarks(tpsTransform);
+
+				tpsTransform.SetLandmark<1>(4, CVectorD<3>(50.0, 20.0));
+				tpsTransform.SetLandmark<1>(6, CVectorD<3>(64.0, 80.0));
+				AssertWarpsAtLandmarks(tpsTransform);
+
+				Logger::WriteMessage("Done TestWarpAfterDestinationMove");
+			}
+
 			TEST_METHOD(TestInverseWarpAtLandmark)
 			{
 			}
 
+			// tests that resampling on several threads matches the serial result
+			TEST_METHOD(TestResampleThreadsMatchSerial)
+			{
+				Logger::WriteMessage("TestResampleThreadsMatchSerial");
+
+				const UINT width = 61, height = 47, bytesPerPixel = 3;
+				const UINT stride = 4 * ((width * bytesPerPixel + 3) / 4);
+				std::vector<BYTE> srcPixels = MakeTestImage(stride, height);
+
+				CTPSTransform tpsTransform;
+				AddWarpLandmarks(tpsTransform, width, height);
+
+				std::vector<BYTE> serialPixels(srcPixels.size());
+				std::vector<BYTE> parallelPixels(srcPixels.size());
+
+				tpsTransform.ResampleRaw(&srcPixels[0], &serialPixels[0], bytesPerPixel, width, height, stride, 0.75f);
+				tpsTransform.SetThreadCount(4);
+				tpsTransform.ResampleRaw(&srcPixels[0], &parallelPixels[0], bytesPerPixel, width, height, stride, 0.75f);
+				Assert::IsTrue(serialPixels == parallelPixels, L"ResampleRaw threaded == serial");
+
+				tpsTransform.SetThreadCount(1);
+				tpsTransform.ResampleRawWithField(&srcPixels[0], &serialPixels[0], bytesPerPixel, width, height, stride, 0.75f);
+				tpsTransform.SetThreadCount(0);
+				tpsTransform.ResampleRawWithField(&srcPixels[0], &parallelPixels[0], bytesPerPixel, width, height, stride, 0.75f);
+				Assert::IsTrue(serialPixels == parallelPixels, L"ResampleRawWithField threaded == serial");
+
+				Logger::WriteMessage("Done TestResampleThreadsMatchSerial");
+			}
+
+			// tests that the presampled field matches evaluating the field at each pixel
+			TEST_METHOD(TestPresampleMatchesEval)
+			{
+				Logger::WriteMessage("TestPresampleMatchesEval");
+
+				const UINT width = 53, height = 38, bytesPerPixel = 1;
+				const UINT stride = 4 * ((width * bytesPerPixel + 3) / 4);
+				std::vector<BYTE> srcPixels = MakeTestImage(stride, height);
+
+				CTPSTransform tpsTransform;
+				AddWarpLandmarks(tpsTransform, width, height);
+				tpsTransform.SetThreadCount(3);
+
+				// at 100% both paths evaluate exactly the same field
+				std::vector<BYTE> evalPixels(srcPixels.size());
+				std::vector<BYTE> fieldPixels(srcPixels.size());
+				tpsTransform.ResampleRaw(&srcPixels[0], &evalPixels[0], bytesPerPixel, width, height, stride, 1.0f);
+				tpsTransform.ResampleRawWithField(&srcPixels[0], &fieldPixels[0], bytesPerPixel, width, height, stride, 1.0f);
+				Assert::IsTrue(evalPixels == fieldPixels, L"presampled field == Eval");
+
+				Logger::WriteMessage("Done TestPresampleMatchesEval");
+			}
+
+			// tests that the row kernels specialized by pixel size match the general one
+			TEST_METHOD(TestResampleKernelsMatchGeneral)
+			{
+				Logger::WriteMessage("TestResampleKernelsMatchGeneral");
+
+				const UINT width = 37, height = 29;
+				std::vector<REAL> arrSrcX(width), arrSrcY(width);
+				const UINT arrBytesPerPixel[] = { 1, 3, 4 };
+				for (int nAtFormat = 0; nAtFormat < 3; nAtFormat++)
+				{
+					const UINT bytesPerPixel = arrBytesPerPixel[nAtFormat];
+					const UINT stride = 4 * ((width * bytesPerPixel + 3) / 4);
+					std::vector<BYTE> srcPixels = MakeTestImage(stride, height);
+					std::vector<BYTE> specialPixels(srcPixels.size());
+					std::vector<BYTE> generalPixels(srcPixels.size());
+
+					for (int dstAtY = 0; dstAtY < (int) height; dstAtY++)
+					{
+						// positions that run off each edge, including the half pixel
+						//		just outside that rounds onto the edge
+						for (UINT dstAtX = 0; dstAtX < width; dstAtX++)
+						{
+							arrSrcX[dstAtX] = 1.1 * dstAtX - 0.6 + 0.3 * sin(0.7 * dstAtY);
+							arrSrcY[dstAtX] = 1.05 * dstAtY - 0.5 + 0.2 * cos(0.3 * dstAtX);
+						}
+						ResampleRowNearest(&srcPixels[0], &specialPixels[0], bytesPerPixel, width, height, stride,
+							dstAtY, &arrSrcX[0], &arrSrcY[0]);
+						ResampleRowNearest<0>(&srcPixels[0], &generalPixels[0], bytesPerPixel, width, height, stride,
+							dstAtY, &arrSrcX[0], &arrSrcY[0]);
+					}
+					Assert::IsTrue(specialPixels == generalPixels, L"specialized kernel == general kernel");
+				}
+
+				Logger::WriteMessage("Done TestResampleKernelsMatchGeneral");
+			}
+
+			// tests that batch evaluation matches evaluating each point
+			TEST_METHOD(TestEvalPointsMatchesEval)
+			{
+				Logger::WriteMessage("TestEvalPointsMatchesEval");
+
+				CTPSTransform tpsTransform;
+				AddWarpLandmarks(tpsTransform, 200, 150);
+
+				// more points than one evaluation block, off the pixel grid
+				const int nCount = 700;
+				std::vector<REAL> arrX(nCount), arrY(nCount), arrXY(2 * nCount);
+				for (int nAt = 0; nAt < nCount; nAt++)
+				{
+					arrX[nAt] = arrXY[2 * nAt + 0] = -10.0 + 0.37 * nAt;
+					arrY[nAt] = arrXY[2 * nAt + 1] = 160.0 - 0.23 * nAt;
+				}
+
+				std::vector<REAL> arrOffsetX(nCount), arrOffsetY(nCount), arrOffsetXY(2 * nCount);
+				tpsTransform.SetThreadCount(2);
+				tpsTransform.EvalPoints(nCount, &arrX[0], &arrY[0], &arrOffsetX[0], &arrOffsetY[0], 0.6f);
+				tpsTransform.EvalPoints(nCount, &arrXY[0], &arrOffsetXY[0], 0.6f);
+
+				for (int nAt = 0; nAt < nCount; nAt++)
+				{
+					CVectorD<3, REAL>::Point_t vOffset;
+					tpsTransform.Eval(CVectorD<3, REAL>::Point_t(arrX[nAt], arrY[nAt], 0.0), vOffset, 0.6f);
+					Assert::IsTrue(arrOffsetX[nAt] == vOffset.get<X>() && arrOffsetY[nAt] == vOffset.get<Y>(), 
+						L"EvalPoints (SoA) == Eval");
+					Assert::IsTrue(arrOffsetXY[2 * nAt + 0] == vOffset.get<X>() && arrOffsetXY[2 * nAt + 1] == vOffset.get<Y>(),
+						L"EvalPoints (interleaved) == Eval");
+				}
+
+				Logger::WriteMessage("Done TestEvalPointsMatchesEval");
+			}
+
+			// tests the blocked evaluator, with more centers than a block and
+			//		a last partial group of centers, against a direct sum
+			TEST_METHOD(TestBlockedEvaluator)
+			{
+				Logger::WriteMessage("TestBlockedEvaluator");
+
+				const int nCenters = CTPSEvaluator<>::CENTER_BLOCK * 2 + 7;
+				std::vector<REAL> arrX(nCenters), arrY(nCenters);
+				std::vector<REAL> arrWx(nCenters + 3), arrWy(nCenters + 3);
+				srand(23);
+				for (int nAt = 0; nAt < nCenters; nAt++)
+				{
+					arrX[nAt] = 500.0 * rand() / RAND_MAX;
+					arrY[nAt] = 400.0 * rand() / RAND_MAX;
+					arrWx[nAt] = 1e-3 * (rand() - RAND_MAX / 2) / RAND_MAX;
+					arrWy[nAt] = 1e-3 * (rand() - RAND_MAX / 2) / RAND_MAX;
+				}
+				arrWx[nCenters] = 1.0; arrWx[nCenters + 1] = 0.5; arrWx[nCenters + 2] = -0.25;
+				arrWy[nCenters] = -2.0; arrWy[nCenters + 1] = 0.1; arrWy[nCenters + 2] = 0.3;
+
+				CRadialBasis basis;
+				CTPSEvaluator<> evaluator;
+				evaluator.SetBasis(nCenters, &arrX[0], &arrY[0], &arrWx[0], &arrWy[0], basis);
+
+				// a row longer than a point block, and the same pixels as points
+				const int nCount = CTPSEvaluator<>::POINT_BLOCK + CTPSEvaluator<>::KERNEL_BLOCK + 3;
+				const REAL y = 123.0, x0 = -20.0;
+				std::vector<REAL> arrRowDx(nCount), arrRowDy(nCount);
+				evaluator.EvalRow(y, x0, nCount, &arrRowDx[0], &arrRowDy[0]);
+				std::vector<REAL> arrPtX(nCount), arrPtY(nCount, y);
+				for (int nAt = 0; nAt < nCount; nAt++)
+				{
+					arrPtX[nAt] = x0 + (REAL) nAt;
+				}
+				std::vector<REAL> arrDx(nCount), arrDy(nCount);
+				evaluator.EvalPoints(nCount, &arrPtX[0], &arrPtY[0], &arrDx[0], &arrDy[0]);
+
+				for (int nAt = 0; nAt < nCount; nAt += 5)
+				{
+					REAL sumX = arrWx[nCenters] + arrWx[nCenters + 1] * arrPtX[nAt] + arrWx[nCenters + 2] * y;
+					REAL sumY = arrWy[nCenters] + arrWy[nCenters + 1] * arrPtX[nAt] + arrWy[nCenters + 2] * y;
+					for (int nAtCenter = 0; nAtCenter < nCenters; nAtCenter++)
+					{
+						REAL r2 = (arrPtX[nAt] - arrX[nAtCenter]) * (arrPtX[nAt] - arrX[nAtCenter])
+							+ (y - arrY[nAtCenter]) * (y - arrY[nAtCenter]);
+						sumX += arrWx[nAtCenter] * basis(r2);
+						sumY += arrWy[nAtCenter] * basis(r2);
+					}
+					Assert::AreEqual(sumX, arrRowDx[nAt], 1e-9);
+					Assert::AreEqual(sumY, arrRowDy[nAt], 1e-9);
+					Assert::IsTrue(arrDx[nAt] == arrRowDx[nAt] && arrDy[nAt] == arrRowDy[nAt],
+						L"EvalPoints == EvalRow");
+				}
+
+				Logger::WriteMessage("Done TestBlockedEvaluator");
+			}
+
+			// tests the specialized kernels against the general pow form
+			TEST_METHOD(TestRadialBasisKernels)
+			{
+				Logger::WriteMessage("TestRadialBasisKernels");
+
+				const REAL arrExp[] = { 2.0, 0.0, 1.0, 3.0, 4.0, 5.0, 2.5 };
+				const CRadialBasis::KernelType arrType[] = { 
+					CRadialBasis::THIN_PLATE, CRadialBasis::EVEN_POWER, CRadialBasis::ODD_POWER,
+					CRadialBasis::ODD_POWER, CRadialBasis::EVEN_POWER, CRadialBasis::ODD_POWER,
+					CRadialBasis::GENERAL_POWER };
+
+				for (int nExp = 0; nExp < 7; nExp++)
+				{
+					CRadialBasis basis(1.5, arrExp[nExp]);
+					Assert::IsTrue(basis.GetKernelType() == arrType[nExp], L"kernel selected for exponent");
+					Assert::IsTrue(basis(0.0) == 0.0, L"basis is zero at r == 0");
+
+					for (REAL r = 0.01; r < 5000.0; r *= 1.7)
+					{
+						REAL expected = 1.5 * pow(r, arrExp[nExp]) * log(r);
+						REAL actual = basis(r * r);
+						Assert::IsTrue(fabs(actual - expected) <= 1e-12 * (1.0 + fabs(expected)), 
+							L"specialized kernel == k * pow(r, r_exp) * log(r)");
+					}
+				}
+
+				// the kernels with a length scale
+				const CRadialBasis::KernelType arrScaled[] = { 
+					CRadialBasis::GAUSSIAN, CRadialBasis::MULTIQUADRIC, CRadialBasis::INVERSE_MULTIQUADRIC,
+					CRadialBasis::WENDLAND_C2, CRadialBasis::WENDLAND_C4 };
+				for (int nType = 0; nType < 5; nType++)
+				{
+					CRadialBasis basis(1.5);
+					basis.SetKernel(arrScaled[nType], 40.0);
+					Assert::IsTrue(basis.GetKernelType() == arrScaled[nType], L"kernel selected");
+					for (REAL r = 0.0; r < 100.0; r += 3.7)
+					{
+						const REAL s = r / 40.0;
+						REAL expected = 0.0;
+						switch (arrScaled[nType])
+						{
+						case CRadialBasis::GAUSSIAN: expected = 1.5 * exp(-s * s); break;
+						case CRadialBasis::MULTIQUADRIC: expected = 1.5 * sqrt(r * r + 1600.0); break;
+						case CRadialBasis::INVERSE_MULTIQUADRIC: expected = 1.5 / sqrt(r * r + 1600.0); break;
+						case CRadialBasis::WENDLAND_C2: expected = (s < 1.0) ? 1.5 * pow(1.0 - s, 4.0) * (4.0 * s + 1.0) : 0.0; break;
+						default: expected = (s < 1.0) ? 1.5 * pow(1.0 - s, 6.0) * (35.0 * s * s + 18.0 * s + 3.0) / 3.0 : 0.0; break;
+						}
+						Assert::AreEqual(expected, basis(r * r), 1e-12 * (1.0 + fabs(expected)));
+					}
+				}
+
+				// the block form of every kernel gives the scalar values
+				std::vector<CRadialBasis> arrBasis;
+				for (int nExp = 0; nExp < 7; nExp++)
+				{
+					arrBasis.push_back(CRadialBasis(1.5, arrExp[nExp]));
+				}
+				for (int nType = 0; nType < 5; nType++)
+				{
+					arrBasis.push_back(CRadialBasis(1.5));
+					arrBasis.back().SetKernel(arrScaled[nType], 40.0);
+				}
+				const int nCount = 50;
+				REAL arrR2[nCount], arrD[nCount];
+				for (int nAt = 0; nAt < nCount; nAt++)
+				{
+					arrR2[nAt] = (REAL) (nAt * nAt * nAt);
+				}
+				for (const CRadialBasis& basis : arrBasis)
+				{
+					basis.Dispatch([&](const auto& kernel) { kernel.Eval(nCount, arrR2, arrD); });
+					for (int nAt = 0; nAt < nCount; nAt++)
+					{
+						Assert::IsTrue(arrD[nAt] == basis(arrR2[nAt]), L"block form == scalar form");
+					}
+				}
+
+				Logger::WriteMessage("Done TestRadialBasisKernels");
+			}
+
+			// tests the bordered and rank-2 updates against fresh factors
+			TEST_METHOD(TestLUFactorizationUpdate)
+			{
+				Logger::WriteMessage("TestLUFactorizationUpdate");
+
+				// a symmetric, indefinite matrix, like L
+				const int n = 12;
+				ublas::matrix<REAL> mA(n + 1, n + 1);
+				for (int nRow = 0; nRow <= n; nRow++)
+				{
+					for (int nCol = 0; nCol <= nRow; nCol++)
+					{
+						mA(nRow, nCol) = mA(nCol, nRow) = (nRow == nCol) ? 0.0 : sin(1.3 * nRow + 0.7 * nCol * nCol);
+					}
+				}
+
+				// factor the leading block, then border it
+				CLUFactorization lu;
+				Assert::IsTrue(lu.Factorize(ublas::subrange(mA, 0, n, 0, n)), L"factorize");
+				ublas::vector<REAL> vB = ublas::subrange(ublas::column(mA, n), 0, n);
+				Assert::IsTrue(lu.Append(vB, mA(n, n)), L"append");
+				Assert::IsTrue(lu.GetSize() == n + 1, L"appended size");
+				AssertSolves(lu, mA, L"bordered factors solve");
+
+				// change a row and column, including the diagonal
+				ublas::vector<REAL> vDelta(n + 1);
+				for (int nAt = 0; nAt <= n; nAt++)
+				{
+					vDelta(nAt) = cos(2.1 * nAt);
+				}
+				for (int nAt = 0; nAt <= n; nAt++)
+				{
+					mA(nAt, 5) += vDelta(nAt);
+					if (nAt != 5) mA(5, nAt) += vDelta(nAt);
+				}
+				Assert::IsTrue(lu.UpdateSymmetric(5, vDelta), L"rank-2 update");
+				Assert::IsTrue(lu.GetUpdateCount() == 2, L"update count");
+				AssertSolves(lu, mA, L"updated factors solve");
+
+				Logger::WriteMessage("Done TestLUFactorizationUpdate");
+			}
+
+			// tests that adding and removing landmarks one at a time gives the
+			//		same field as building the transform from scratch
+			TEST_METHOD(TestAddRemoveLandmark)
+			{
+				Logger::WriteMessage("TestAddRemoveLandmark");
+
+				std::vector<CVectorD<3>> arrSource, arrDest;
+				for (int nAt = 0; nAt < 40; nAt++)
+				{
+					arrSource.push_back(CVectorD<3>(100.0 + 90.0 * sin(2.3 * nAt), 100.0 + 90.0 * cos(3.1 * nAt)));
+					arrDest.push_back(CVectorD<3>(arrSource.back()[0] + 4.0 * sin(nAt), arrSource.back()[1] - 3.0 * cos(nAt)));
+				}
+
+				CTPSTransform tpsTransform;
+				for (int nAt = 0; nAt < 36; nAt++)
+				{
+					tpsTransform.AddLandmark(arrSource[nAt], arrDest[nAt]);
+				}
+				CVectorD<3, REAL>::Point_t vOffset;
+				tpsTransform.Eval(CVectorD<3, REAL>::Point_t(50.0, 50.0, 0.0), vOffset, 1.0);
+
+				// add, remove and reuse slots, evaluating in between
+				for (int nAt = 36; nAt < 40; nAt++)
+				{
+					tpsTransform.AddLandmark(arrSource[nAt], arrDest[nAt]);
+					tpsTransform.Eval(CVectorD<3, REAL>::Point_t(50.0, 50.0, 0.0), vOffset, 1.0);
+				}
+				tpsTransform.RemoveLandmark(10);
+				tpsTransform.Eval(CVectorD<3, REAL>::Point_t(50.0, 50.0, 0.0), vOffset, 1.0);
+				tpsTransform.RemoveLandmark(20);
+				tpsTransform.AddLandmark(arrSource[10], arrDest[10]);
+				tpsTransform.Eval(CVectorD<3, REAL>::Point_t(50.0, 50.0, 0.0), vOffset, 1.0);
+				tpsTransform.RemoveLandmark(0);
+				Assert::IsTrue(tpsTransform.GetLandmarkCount() == 38, L"landmark count");
+
+				// the same landmarks, in the same order, from scratch
+				CTPSTransform tpsExpected;
+				for (int nAt = 0; nAt < tpsTransform.GetLandmarkCount(); nAt++)
+				{
+					tpsExpected.AddLandmark(tpsTransform.GetLandmark<0>(nAt), tpsTransform.GetLandmark<1>(nAt));
+				}
+				Assert::IsTrue(tpsTransform.GetLandmark<0>(37).IsApproxEqual(arrSource[10]), L"re-added landmark is last");
+
+				for (REAL y = 0.0; y < 200.0; y += 13.0)
+				{
+					for (REAL x = 0.0; x < 200.0; x += 11.0)
+					{
+						CVectorD<3, REAL>::Point_t vActual, vExpected;
+						tpsTransform.Eval(CVectorD<3, REAL>::Point_t(x, y, 0.0), vActual, 1.0);
+						tpsExpected.Eval(CVectorD<3, REAL>::Point_t(x, y, 0.0), vExpected, 1.0);
+						Assert::IsTrue(fabs(vActual.get<X>() - vExpected.get<X>()) < 1e-6
+							&& fabs(vActual.get<Y>() - vExpected.get<Y>()) < 1e-6,
+							L"incremental field == full field");
+					}
+				}
+				AssertWarpsAtLandmarks(tpsTransform);
+
+				Logger::WriteMessage("Done TestAddRemoveLandmark");
+			}
+
+			// tests that dragging a source landmark, with an update of the 
+			//		factors per move, gives the field built from scratch
+			TEST_METHOD(TestDragSourceLandmark)
+			{
+				Logger::WriteMessage("TestDragSourceLandmark");
+
+				CTPSTransform tpsTransform;
+				for (int nAt = 0; nAt < 40; nAt++)
+				{
+					CVectorD<3> vSource(100.0 + 90.0 * sin(2.3 * nAt), 100.0 + 90.0 * cos(3.1 * nAt));
+					CVectorD<3> vDest(vSource[0] + 4.0 * sin(nAt), vSource[1] - 3.0 * cos(nAt));
+					tpsTransform.AddLandmark(vSource, vDest);
+				}
+
+				// drag a source landmark in small steps, as CDibView does, and
+				//		move a destination (leaving its source where it is)
+				CVectorD<3, REAL>::Point_t vOffset;
+				for (int nStep = 0; nStep < 8; nStep++)
+				{
+					CVectorD<3> vSource = tpsTransform.GetLandmark<0>(5);
+					vSource[0] += 1.5;
+					vSource[1] -= 0.5;
+					tpsTransform.SetLandmark<0>(5, vSource);
+					tpsTransform.Eval(CVectorD<3, REAL>::Point_t(50.0, 50.0, 0.0), vOffset, 1.0);
+
+					CVectorD<3, REAL>::Point_t vL0, vL1;
+					std::tie(vL0, vL1) = tpsTransform.GetLandmarkTuple(9);
+					bg::add_point(vL1, CVectorD<3, REAL>::Point_t(0.5, 0.25, 0.0));
+					tpsTransform.SetLandmarkTuple(9, std::make_tuple(vL0, vL1));
+					tpsTransform.Eval(CVectorD<3, REAL>::Point_t(50.0, 50.0, 0.0), vOffset, 1.0);
+				}
+
+				// two landmarks moved between recalcs
+				CVectorD<3> vSource = tpsTransform.GetLandmark<0>(12);
+				vSource[1] += 7.0;
+				tpsTransform.SetLandmark<0>(12, vSource);
+				vSource = tpsTransform.GetLandmark<0>(30);
+				vSource[0] -= 6.0;
+				tpsTransform.SetLandmark<0>(30, vSource);
+
+				CTPSTransform tpsExpected;
+				for (int nAt = 0; nAt < tpsTransform.GetLandmarkCount(); nAt++)
+				{
+					tpsExpected.AddLandmark(tpsTransform.GetLandmark<0>(nAt), tpsTransform.GetLandmark<1>(nAt));
+				}
+
+				for (REAL y = 0.0; y < 200.0; y += 13.0)
+				{
+					for (REAL x = 0.0; x < 200.0; x += 11.0)
+					{
+						CVectorD<3, REAL>::Point_t vActual, vExpected;
+						tpsTransform.Eval(CVectorD<3, REAL>::Point_t(x, y, 0.0), vActual, 1.0);
+						tpsExpected.Eval(CVectorD<3, REAL>::Point_t(x, y, 0.0), vExpected, 1.0);
+						Assert::IsTrue(fabs(vActual.get<X>() - vExpected.get<X>()) < 1e-6
+							&& fabs(vActual.get<Y>() - vExpected.get<Y>()) < 1e-6,
+							L"updated field == full field");
+					}
+				}
+				AssertWarpsAtLandmarks(tpsTransform);
+
+				Logger::WriteMessage("Done TestDragSourceLandmark");
+			}
+
+			// tests that the compact field formats hold the field to their precision
+			TEST_METHOD(TestCompactFieldFormats)
+			{
+				Logger::WriteMessage("TestCompactFieldFormats");
+
+				CDisplacementField field;
+				field.SetFormat(CDisplacementField::FORMAT_FIXED16, 16.0);
+				field.Resize(4, 2);
+				Assert::AreEqual((size_t) (2 * 4 * 2 * sizeof(short)), field.GetBytes());
+
+				const REAL arrDx[] = { 0.0, 1.03, -2.5, 5000.0 };
+				const REAL arrDy[] = { -0.03, 0.5, 7.9375, -5000.0 };
+				field.SetRow(1, arrDx, arrDy);
+				REAL dx, dy;
+				field.Get(5, dx, dy);
+				Assert::AreEqual(1.0, dx);
+				Assert::AreEqual(0.5, dy);
+				field.Get(6, dx, dy);
+				Assert::AreEqual(-2.5, dx);
+				Assert::AreEqual(7.9375, dy);
+				field.Get(7, dx, dy);
+				Assert::AreEqual(32767.0 / 16.0, dx, L"saturates");
+				Assert::AreEqual(-32768.0 / 16.0, dy, L"saturates");
+
+				// NaN is stored as zero, and a subpixels that is not positive
+				//		falls back to the default
+				const REAL arrNaN[] = { NAN, 0.0, 0.0, 0.0 };
+				field.SetRow(0, arrNaN, arrNaN);
+				field.Get(0, dx, dy);
+				Assert::IsTrue(dx == 0.0 && dy == 0.0, L"NaN stored as zero");
+				field.SetFormat(CDisplacementField::FORMAT_FIXED16, 0.0);
+				Assert::AreEqual(32.0, field.GetSubpixels());
+				Assert::AreEqual(1.0 / 32.0, field.GetScale());
+
+				// the compact fields warp nearly as the double field does
+				const UINT width = 59, height = 43, bytesPerPixel = 1;
+				const UINT stride = 4 * ((width * bytesPerPixel + 3) / 4);
+				std::vector<BYTE> srcPixels = MakeTestImage(stride, height);
+
+				CTPSTransform tpsTransform;
+				AddWarpLandmarks(tpsTransform, width, height);
+				std::vector<BYTE> expectedPixels(srcPixels.size());
+				tpsTransform.ResampleRawWithField(&srcPixels[0], &expectedPixels[0], bytesPerPixel, width, height, stride, 0.8f);
+
+				const CDisplacementField::Format arrFormats[] = 
+					{ CDisplacementField::FORMAT_FLOAT, CDisplacementField::FORMAT_FIXED16 };
+				for (int nAtFormat = 0; nAtFormat < 2; nAtFormat++)
+				{
+					tpsTransform.SetFieldFormat(arrFormats[nAtFormat], 64.0);
+					std::vector<BYTE> actualPixels(srcPixels.size());
+					tpsTransform.ResampleRawWithField(&srcPixels[0], &actualPixels[0], bytesPerPixel, width, height, stride, 0.8f);
+
+					// only pixels near a rounding edge can differ
+					int nDiffer = 0;
+					for (size_t nAt = 0; nAt < srcPixels.size(); nAt++)
+					{
+						nDiffer += (actualPixels[nAt] != expectedPixels[nAt]) ? 1 : 0;
+					}
+					Assert::IsTrue(nDiffer * 20 < (int) (width * height), L"compact field ~= double field");
+				}
+
+				Logger::WriteMessage("Done TestCompactFieldFormats");
+			}
+
+			// tests that the float presample is within its error bound of the
+			//		double one, and stays in double for a rough warp
+			TEST_METHOD(TestSinglePrecision)
+			{
+				Logger::WriteMessage("TestSinglePrecision");
+
+				// the float kernels match the double ones
+				CRadialBasis basis;
+				float arrR2f[3] = { 0.0f, 2.0f, 1e6f }, arrDf[3];
+				basis.Dispatch([&](const auto& kernel) { kernel.Eval(3, arrR2f, arrDf); });
+				for (int nAt = 0; nAt < 3; nAt++)
+				{
+					Assert::AreEqual(basis(arrR2f[nAt]), (REAL) arrDf[nAt], 1e-6 * (1.0 + fabs(basis(arrR2f[nAt]))));
+				}
+
+				// which take their log from FastLog, within an ulp of log
+				for (float x = 1e-30f; x < 1e30f; x *= 1.0137f)
+				{
+					const REAL expected = log((REAL) x);
+					Assert::IsTrue(fabs(FastLog(x) - expected) <= 2.0 * FLT_EPSILON * fabs(expected),
+						L"FastLog(x) ~= log(x)");
+				}
+				Assert::IsTrue(FastLog(1.0f) == 0.0f, L"FastLog(1) == 0");
+
+				// a smooth warp of a large image
+				const int width = 640, height = 480;
+				CTPSTransform tpsTransform;
+				srand(17);
+				for (int nAt = 0; nAt < 100; nAt++)
+				{
+					REAL x = width * (REAL) rand() / RAND_MAX;
+					REAL y = height * (REAL) rand() / RAND_MAX;
+					tpsTransform.AddLandmark(CVectorD<3>(x, y),
+						CVectorD<3>(x + 20.0 * sin(6.0 * y / width), y + 20.0 * cos(5.0 * x / width)));
+				}
+				CDisplacementField expected = tpsTransform.GetPresampledField(width, height);
+
+				tpsTransform.SetSinglePrecision(TRUE);
+				Assert::IsTrue(tpsTransform.GetSinglePrecision());
+				const CDisplacementField& field = tpsTransform.GetPresampledField(width, height);
+				REAL maxError = 0.0;
+				for (int nAt = 0; nAt < width * height; nAt++)
+				{
+					REAL dx, dy, expectedDx, expectedDy;
+					field.Get(nAt, dx, dy);
+					expected.Get(nAt, expectedDx, expectedDy);
+					maxError = __max(maxError, __max(fabs(dx - expectedDx), fabs(dy - expectedDy)));
+				}
+				Assert::IsTrue(maxError > 0.0, L"summed in float");
+				Assert::IsTrue(maxError < 1e-3, L"float field ~= double field");
+
+				// random offsets of close landmarks have large weights, and too
+				//		large an error bound for float
+				for (int nAt = 0; nAt < 20; nAt++)
+				{
+					REAL x = 0.5 * width + 10.0 * rand() / RAND_MAX;
+					REAL y = 0.5 * height + 10.0 * rand() / RAND_MAX;
+					tpsTransform.AddLandmark(CVectorD<3>(x, y),
+						CVectorD<3>(x + 10.0 * rand() / RAND_MAX, y - 10.0 * rand() / RAND_MAX));
+				}
+				tpsTransform.SetSinglePrecision(FALSE);
+				expected = tpsTransform.GetPresampledField(width, height);
+				tpsTransform.SetSinglePrecision(TRUE);
+				tpsTransform.GetPresampledField(width, height);
+				for (int nAt = 0; nAt < width * height; nAt += 97)
+				{
+					REAL dx, dy, expectedDx, expectedDy;
+					field.Get(nAt, dx, dy);
+					expected.Get(nAt, expectedDx, expectedDy);
+					Assert::AreEqual(expectedDx, dx);
+					Assert::AreEqual(expectedDy, dy);
+				}
+
+				Logger::WriteMessage("Done TestSinglePrecision");
+			}
+
+			// tests that the lattice presample interpolates the field to about the tolerance
+			TEST_METHOD(TestPresampleLatticeTolerance)
+			{
+				Logger::WriteMessage("TestPresampleLatticeTolerance");
+
+				const int width = 211, height = 157;
+				CTPSTransform tpsTransform;
+				AddWarpLandmarks(tpsTransform, width, height);
+				tpsTransform.AddLandmark(CVectorD<3>(0.2 * width, 0.7 * height), CVectorD<3>(0.25 * width, 0.72 * height));
+				tpsTransform.SetThreadCount(2);
+
+				const REAL arrTolerance[] = { 0.2, 0.02 };
+				for (int nAtTolerance = 0; nAtTolerance < 2; nAtTolerance++)
+				{
+					tpsTransform.SetPresampleTolerance(arrTolerance[nAtTolerance]);
+					const CDisplacementField& field = tpsTransform.GetPresampledField(width, height);
+
+					// the error is estimated at a few points of each cell, so it can
+					//		go a little over elsewhere
+					REAL maxError = 0.0;
+					for (int atY = 0; atY < height; atY++)
+					{
+						for (int atX = 0; atX < width; atX++)
+						{
+							REAL dx, dy;
+							field.Get(atY * width + atX, dx, dy);
+							CVectorD<3, REAL>::Point_t vOffset;
+							tpsTransform.Eval(CVectorD<3, REAL>::Point_t(atX, atY, 0.0), vOffset, 1.0);
+							maxError = __max(maxError, __max(fabs(dx - vOffset.get<X>()), fabs(dy - vOffset.get<Y>())));
+						}
+					}
+					Assert::IsTrue(maxError < 1.5 * arrTolerance[nAtTolerance], L"lattice field within tolerance");
+				}
+
+				Logger::WriteMessage("Done TestPresampleLatticeTolerance");
+			}
+
+			// tests the far field tree against the exact sums: points, the kernel
+			//		product at the centers, and a transform with the tree on
+			TEST_METHOD(TestTreeEvaluatorMatchesDirect)
+			{
+				Logger::WriteMessage("TestTreeEvaluatorMatchesDirect");
+
+				// clustered and spread centers, so the tree has several levels
+				const int nCenters = 600;
+				std::vector<REAL> arrX(nCenters), arrY(nCenters);
+				std::vector<REAL> arrWx(nCenters + 3), arrWy(nCenters + 3);
+				srand(12);
+				for (int nAt = 0; nAt < nCenters; nAt++)
+				{
+					REAL spread = (nAt % 3 == 0) ? 20.0 : 400.0;
+					arrX[nAt] = 100.0 + spread * rand() / RAND_MAX;
+					arrY[nAt] = 50.0 + spread * rand() / RAND_MAX;
+					arrWx[nAt] = 1e-3 * (rand() - RAND_MAX / 2) / RAND_MAX;
+					arrWy[nAt] = 1e-3 * (rand() - RAND_MAX / 2) / RAND_MAX;
+				}
+				arrWx[nCenters] = 1.0; arrWx[nCenters + 1] = 0.5; arrWx[nCenters + 2] = -0.25;
+				arrWy[nCenters] = -2.0; arrWy[nCenters + 1] = 0.1; arrWy[nCenters + 2] = 0.3;
+
+				CRadialBasis basis;
+				CTPSEvaluator<> direct;
+				direct.SetBasis(nCenters, &arrX[0], &arrY[0], &arrWx[0], &arrWy[0], basis);
+				CTPSTreeEvaluator tree;
+				tree.SetTheta(0.5);
+				tree.SetBasis(nCenters, &arrX[0], &arrY[0], &arrWx[0], &arrWy[0], basis);
+				Assert::IsTrue(tree.GetNodeCount() > 1, L"tree is split");
+
+				const int nPoints = 500;
+				std::vector<REAL> arrPtX(nPoints), arrPtY(nPoints);
+				for (int nAt = 0; nAt < nPoints; nAt++)
+				{
+					arrPtX[nAt] = 600.0 * rand() / RAND_MAX;
+					arrPtY[nAt] = 600.0 * rand() / RAND_MAX;
+				}
+				std::vector<REAL> arrExpectedDx(nPoints), arrExpectedDy(nPoints);
+				std::vector<REAL> arrActualDx(nPoints), arrActualDy(nPoints);
+				direct.EvalPoints(nPoints, &arrPtX[0], &arrPtY[0], &arrExpectedDx[0], &arrExpectedDy[0], 0.5);
+				tree.EvalPoints(nPoints, &arrPtX[0], &arrPtY[0], &arrActualDx[0], &arrActualDy[0], 0.5);
+				for (int nAt = 0; nAt < nPoints; nAt++)
+				{
+					Assert::AreEqual(arrExpectedDx[nAt], arrActualDx[nAt], 1e-4);
+					Assert::AreEqual(arrExpectedDy[nAt], arrActualDy[nAt], 1e-4);
+				}
+
+				// theta 0 sums every center exactly
+				tree.SetTheta(0.0);
+				REAL dx, dy, expectedDx, expectedDy;
+				tree.EvalPoint(arrPtX[0], arrPtY[0], dx, dy);
+				direct.EvalPoint(arrPtX[0], arrPtY[0], expectedDx, expectedDy);
+				Assert::AreEqual(expectedDx, dx, 1e-9);
+				Assert::AreEqual(expectedDy, dy, 1e-9);
+
+				// the kernel product, summed directly
+				tree.SetTheta(0.5);
+				std::vector<REAL> arrKWx(nCenters), arrKWy(nCenters);
+				tree.MultiplyKernel(&arrWx[0], &arrWy[0], &arrKWx[0], &arrKWy[0]);
+				for (int nAt = 0; nAt < nCenters; nAt += 7)
+				{
+					REAL sumX = 0.0, sumY = 0.0;
+					for (int nAtCenter = 0; nAtCenter < nCenters; nAtCenter++)
+					{
+						REAL r2 = (arrX[nAt] - arrX[nAtCenter]) * (arrX[nAt] - arrX[nAtCenter])
+							+ (arrY[nAt] - arrY[nAtCenter]) * (arrY[nAt] - arrY[nAtCenter]);
+						sumX += arrWx[nAtCenter] * basis(r2);
+						sumY += arrWy[nAtCenter] * basis(r2);
+					}
+					Assert::AreEqual(sumX, arrKWx[nAt], 1e-4);
+					Assert::AreEqual(sumY, arrKWy[nAt], 1e-4);
+				}
+
+				// and through the transform
+				const int width = 97, height = 83;
+				CTPSTransform tpsTransform;
+				AddWarpLandmarks(tpsTransform, width, height);
+				for (int nAt = 0; nAt < 100; nAt++)
+				{
+					CVectorD<3> vSrc(width * (REAL) rand() / RAND_MAX, height * (REAL) rand() / RAND_MAX);
+					CVectorD<3> vDst(vSrc[0] + 3.0 * rand() / RAND_MAX, vSrc[1] - 3.0 * rand() / RAND_MAX);
+					tpsTransform.AddLandmark(vSrc, vDst);
+				}
+				std::vector<CVectorD<3, REAL>::Point_t> arrExpected(height);
+				for (int atY = 0; atY < height; atY++)
+				{
+					tpsTransform.Eval(CVectorD<3, REAL>::Point_t(atY, atY, 0.0), arrExpected[atY], 1.0);
+				}
+				tpsTransform.SetFarFieldTheta(0.5);
+				const CDisplacementField& field = tpsTransform.GetPresampledField(width, height);
+				for (int atY = 0; atY < height; atY++)
+				{
+					field.Get(atY * width + atY, dx, dy);
+					Assert::AreEqual(arrExpected[atY].get<X>(), dx, 1e-4);
+					Assert::AreEqual(arrExpected[atY].get<Y>(), dy, 1e-4);
+				}
+
+				// ResampleRaw uses the tree too, as its snapshot does.  a coarse
+				//		theta moves pixels, so the direct field would differ
+				tpsTransform.SetFarFieldTheta(0.95);
+				const UINT stride = width * 3;
+				std::vector<BYTE> srcPixels = MakeTestImage(stride, height);
+				std::vector<BYTE> dstTransform(stride * height), dstSnapshot(stride * height);
+				tpsTransform.ResampleRaw(srcPixels.data(), dstTransform.data(), 3, width, height, stride, 1.0f);
+				tpsTransform.Compile()->ResampleRaw(srcPixels.data(), dstSnapshot.data(), 3, width, height, stride, 1.0f);
+				Assert::IsTrue(dstTransform == dstSnapshot, L"transform and snapshot resample alike");
+
+				Logger::WriteMessage("Done TestTreeEvaluatorMatchesDirect");
+			}
+
+			// tests that the GMRES solve gives the field of the dense solve, and
+			//		that a drag starts it from the last weights
+			TEST_METHOD(TestIterativeSolveMatchesDense)
+			{
+				Logger::WriteMessage("TestIterativeSolveMatchesDense");
+
+				// enough landmarks for the coarse level of the preconditioner
+				CTPSTransform tpsDense, tpsIterative;
+				srand(13);
+				for (int nAt = 0; nAt < 300; nAt++)
+				{
+					CVectorD<3> vSrc(512.0 * rand() / RAND_MAX, 384.0 * rand() / RAND_MAX);
+					CVectorD<3> vDst(vSrc[0] + 8.0 * rand() / RAND_MAX - 4.0, vSrc[1] + 8.0 * rand() / RAND_MAX - 4.0);
+					tpsDense.AddLandmark(vSrc, vDst);
+					tpsIterative.AddLandmark(vSrc, vDst);
+				}
+				tpsIterative.SetIterativeSolveThreshold(100);
+
+				const int nPoints = 200;
+				std::vector<REAL> arrX(nPoints), arrY(nPoints);
+				for (int nAt = 0; nAt < nPoints; nAt++)
+				{
+					arrX[nAt] = 512.0 * rand() / RAND_MAX;
+					arrY[nAt] = 384.0 * rand() / RAND_MAX;
+				}
+				std::vector<REAL> arrExpectedDx(nPoints), arrExpectedDy(nPoints);
+				std::vector<REAL> arrActualDx(nPoints), arrActualDy(nPoints);
+
+				int nFirstIterations = 0;
+				for (int nStep = 0; nStep < 2; nStep++)
+				{
+					tpsDense.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrExpectedDx[0], &arrExpectedDy[0], 1.0f);
+					tpsIterative.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrActualDx[0], &arrActualDy[0], 1.0f);
+					Assert::IsTrue(tpsIterative.GetIterativeSolveIterations() > 0, L"solved iteratively");
+					for (int nAt = 0; nAt < nPoints; nAt++)
+					{
+						Assert::AreEqual(arrExpectedDx[nAt], arrActualDx[nAt], 1e-5);
+						Assert::AreEqual(arrExpectedDy[nAt], arrActualDy[nAt], 1e-5);
+					}
+
+					if (nStep == 0)
+					{
+						nFirstIterations = tpsIterative.GetIterativeSolveIterations();
+
+						// drag a destination a little
+						CVectorD<3> vDest = tpsDense.GetLandmark<1>(17);
+						vDest[0] += 0.5;
+						tpsDense.SetLandmark<1>(17, vDest);
+						tpsIterative.SetLandmark<1>(17, vDest);
+					}
+				}
+				Assert::IsTrue(tpsIterative.GetIterativeSolveIterations() <= nFirstIterations, L"warm start");
+
+				Logger::WriteMessage("Done TestIterativeSolveMatchesDense");
+			}
+
+			// tests that the float factors, refined in REAL, give the field
+			//		of the dense solve, and are kept while destinations move
+			TEST_METHOD(TestMixedPrecisionSolve)
+			{
+				Logger::WriteMessage("TestMixedPrecisionSolve");
+
+				CTPSTransform tpsDense, tpsMixed;
+				srand(17);
+				for (int nAt = 0; nAt < 200; nAt++)
+				{
+					CVectorD<3> vSrc(1024.0 * rand() / RAND_MAX, 768.0 * rand() / RAND_MAX);
+					CVectorD<3> vDst(vSrc[0] + 16.0 * rand() / RAND_MAX - 8.0, vSrc[1] + 16.0 * rand() / RAND_MAX - 8.0);
+					tpsDense.AddLandmark(vSrc, vDst);
+					tpsMixed.AddLandmark(vSrc, vDst);
+				}
+				tpsMixed.SetMixedPrecisionThreshold(100);
+
+				const int nPoints = 200;
+				std::vector<REAL> arrX(nPoints), arrY(nPoints);
+				for (int nAt = 0; nAt < nPoints; nAt++)
+				{
+					arrX[nAt] = 1024.0 * rand() / RAND_MAX;
+					arrY[nAt] = 768.0 * rand() / RAND_MAX;
+				}
+				std::vector<REAL> arrExpectedDx(nPoints), arrExpectedDy(nPoints);
+				std::vector<REAL> arrActualDx(nPoints), arrActualDy(nPoints);
+
+				for (int nStep = 0; nStep < 2; nStep++)
+				{
+					tpsDense.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrExpectedDx[0], &arrExpectedDy[0], 1.0f);
+					tpsMixed.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrActualDx[0], &arrActualDy[0], 1.0f);
+					Assert::IsTrue(tpsMixed.GetMixedPrecisionResidual() <= 1e-13, L"refined to REAL");
+					Assert::IsTrue(tpsMixed.GetConditionEstimate() > 1.0, L"condition estimated");
+					for (int nAt = 0; nAt < nPoints; nAt++)
+					{
+						Assert::AreEqual(arrExpectedDx[nAt], arrActualDx[nAt], 1e-8);
+						Assert::AreEqual(arrExpectedDy[nAt], arrActualDy[nAt], 1e-8);
+					}
+
+					// drag a destination; the factors are reused
+					CVectorD<3> vDest = tpsDense.GetLandmark<1>(23);
+					vDest[1] -= 2.0;
+					tpsDense.SetLandmark<1>(23, vDest);
+					tpsMixed.SetLandmark<1>(23, vDest);
+				}
+
+				Logger::WriteMessage("Done TestMixedPrecisionSolve");
+			}
+
+			// tests that L assembled over several threads, for the dense and
+			//		the mixed precision solves, gives the serial weights
+			TEST_METHOD(TestParallelAssembly)
+			{
+				Logger::WriteMessage("TestParallelAssembly");
+
+				// enough landmarks for several bands of rows
+				CTPSTransform tpsSerial, tpsParallel, tpsMixedSerial, tpsMixedParallel;
+				srand(29);
+				for (int nAt = 0; nAt < 400; nAt++)
+				{
+					CVectorD<3> vSrc(1024.0 * rand() / RAND_MAX, 768.0 * rand() / RAND_MAX);
+					CVectorD<3> vDst(vSrc[0] + 16.0 * rand() / RAND_MAX - 8.0, vSrc[1] + 16.0 * rand() / RAND_MAX - 8.0);
+					tpsSerial.AddLandmark(vSrc, vDst);
+					tpsParallel.AddLandmark(vSrc, vDst);
+					tpsMixedSerial.AddLandmark(vSrc, vDst);
+					tpsMixedParallel.AddLandmark(vSrc, vDst);
+				}
+				tpsSerial.SetThreadCount(1);
+				tpsParallel.SetThreadCount(4);
+				tpsMixedSerial.SetThreadCount(1);
+				tpsMixedParallel.SetThreadCount(4);
+				tpsMixedSerial.SetMixedPrecisionThreshold(100);
+				tpsMixedParallel.SetMixedPrecisionThreshold(100);
+
+				const int nPoints = 100;
+				std::vector<REAL> arrX(nPoints), arrY(nPoints);
+				for (int nAt = 0; nAt < nPoints; nAt++)
+				{
+					arrX[nAt] = 1024.0 * rand() / RAND_MAX;
+					arrY[nAt] = 768.0 * rand() / RAND_MAX;
+				}
+				std::vector<REAL> arrExpectedDx(nPoints), arrExpectedDy(nPoints);
+				std::vector<REAL> arrActualDx(nPoints), arrActualDy(nPoints);
+				tpsSerial.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrExpectedDx[0], &arrExpectedDy[0], 1.0f);
+				tpsParallel.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrActualDx[0], &arrActualDy[0], 1.0f);
+				Assert::IsTrue(arrExpectedDx == arrActualDx && arrExpectedDy == arrActualDy, L"dense");
+
+				tpsMixedSerial.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrExpectedDx[0], &arrExpectedDy[0], 1.0f);
+				tpsMixedParallel.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrActualDx[0], &arrActualDy[0], 1.0f);
+				Assert::IsTrue(arrExpectedDx == arrActualDx && arrExpectedDy == arrActualDy, L"mixed precision");
+
+				Logger::WriteMessage("Done TestParallelAssembly");
+			}
+
+			// tests that the kernels with a length scale interpolate the
+			//		landmarks, and that EvalPoints matches Eval for them
+			TEST_METHOD(TestScaledKernels)
+			{
+				Logger::WriteMessage("TestScaledKernels");
+
+				CTPSTransform tpsTransform;
+				AddWarpLandmarks(tpsTransform, 200, 150);
+				const CRadialBasis::KernelType arrType[] = { 
+					CRadialBasis::GAUSSIAN, CRadialBasis::MULTIQUADRIC, CRadialBasis::INVERSE_MULTIQUADRIC };
+				for (int nType = 0; nType < 3; nType++)
+				{
+					tpsTransform.SetKernel(arrType[nType], 60.0);
+					Assert::IsTrue(tpsTransform.GetKernelType() == arrType[nType], L"kernel selected");
+					Assert::AreEqual(60.0, tpsTransform.GetKernelScale());
+
+					for (int nAt = 0; nAt < tpsTransform.GetLandmarkCount(); nAt++)
+					{
+						const CVectorD<3>& vSrc = tpsTransform.GetLandmark<0>(nAt);
+						const CVectorD<3>& vDst = tpsTransform.GetLandmark<1>(nAt);
+						REAL x = vSrc[0], y = vSrc[1], dx, dy;
+						tpsTransform.EvalPoints(1, &x, &y, &dx, &dy, 1.0f);
+						Assert::AreEqual(vDst[0] - vSrc[0], dx, 1e-6);
+						Assert::AreEqual(vDst[1] - vSrc[1], dy, 1e-6);
+
+						CVectorD<3, REAL>::Point_t vOffset;
+						tpsTransform.Eval(CVectorD<3, REAL>::Point_t(x + 3.5, y - 2.25, 0.0), vOffset, 0.6f);
+						x += 3.5;
+						y -= 2.25;
+						tpsTransform.EvalPoints(1, &x, &y, &dx, &dy, 0.6f);
+						Assert::IsTrue(dx == vOffset.get<X>() && dy == vOffset.get<Y>(), L"EvalPoints == Eval");
+					}
+				}
+
+				// a landmark added after a solve borders the factors, with a
+				//		diagonal of phi(0), which is not zero for these kernels
+				for (int nType = 0; nType < 3; nType++)
+				{
+					CTPSTransform tpsIncremental;
+					tpsIncremental.SetKernel(arrType[nType], 30.0);
+					for (int nAt = 0; nAt < 59; nAt++)
+					{
+						REAL x = 100.0 + 90.0 * sin(2.3 * nAt), y = 100.0 + 90.0 * cos(3.1 * nAt);
+						tpsIncremental.AddLandmark(CVectorD<3>(x, y), CVectorD<3>(x + 4.0 * sin(nAt), y - 3.0 * cos(nAt)));
+					}
+					CVectorD<3, REAL>::Point_t vOffset;
+					tpsIncremental.Eval(CVectorD<3, REAL>::Point_t(50.0, 50.0, 0.0), vOffset, 1.0);
+					tpsIncremental.AddLandmark(CVectorD<3>(104.0, 97.0), CVectorD<3>(108.0, 95.0));
+					AssertWarpsAtLandmarks(tpsIncremental);
+				}
+
+				// and back to the thin plate
+				tpsTransform.SetKernel(CRadialBasis::THIN_PLATE, 0.0);
+				Assert::IsTrue(tpsTransform.GetKernelType() == CRadialBasis::THIN_PLATE, L"polyharmonic again");
+
+				Logger::WriteMessage("Done TestScaledKernels");
+			}
+
+			// tests that a compactly supported basis still interpolates the
+			//		landmarks, is affine away from them, and presamples to the
+			//		field EvalPoints gives
+			TEST_METHOD(TestCompactSupport)
+			{
+				Logger::WriteMessage("TestCompactSupport");
+
+				// the landmarks in the left half of the image
+				const int width = 160, height = 96;
+				CTPSTransform tpsTransform;
+				srand(15);
+				for (int nAt = 0; nAt < 300; nAt++)
+				{
+					CVectorD<3> vSrc(64.0 * rand() / RAND_MAX, height * (REAL) rand() / RAND_MAX);
+					CVectorD<3> vDst(vSrc[0] + 8.0 * rand() / RAND_MAX - 4.0, vSrc[1] + 8.0 * rand() / RAND_MAX - 4.0);
+					tpsTransform.AddLandmark(vSrc, vDst);
+				}
+
+				for (int nContinuity = 2; nContinuity <= 4; nContinuity += 2)
+				{
+					tpsTransform.SetSupportRadius(20.0, nContinuity);
+					Assert::AreEqual(20.0, tpsTransform.GetSupportRadius());
+
+					// the landmarks are interpolated
+					for (int nAt = 0; nAt < tpsTransform.GetLandmarkCount(); nAt++)
+					{
+						const CVectorD<3>& vSrc = tpsTransform.GetLandmark<0>(nAt);
+						const CVectorD<3>& vDst = tpsTransform.GetLandmark<1>(nAt);
+						CVectorD<3, REAL>::Point_t vOffset;
+						tpsTransform.Eval(CVectorD<3, REAL>::Point_t(vSrc[0], vSrc[1], 0.0), vOffset, 1.0f);
+						Assert::AreEqual(vDst[0] - vSrc[0], vOffset.get<X>(), 1e-6);
+						Assert::AreEqual(vDst[1] - vSrc[1], vOffset.get<Y>(), 1e-6);
+					}
+
+					// past the radius of every landmark, the field is affine
+					REAL arrX[3] = { 100.0, 120.0, 140.0 }, arrY[3] = { 10.0, 50.0, 90.0 };
+					REAL arrDx[3], arrDy[3];
+					tpsTransform.EvalPoints(3, arrX, arrY, arrDx, arrDy, 1.0f);
+					Assert::AreEqual(2.0 * arrDx[1], arrDx[0] + arrDx[2], 1e-9);
+					Assert::AreEqual(2.0 * arrDy[1], arrDy[0] + arrDy[2], 1e-9);
+
+					// and the row kernel agrees with the point kernel
+					const CDisplacementField& field = tpsTransform.GetPresampledField(width, height);
+					for (int atY = 0; atY < height; atY++)
+					{
+						REAL x = (REAL) ((atY * 7) % width), y = (REAL) atY;
+						REAL dxPoint, dyPoint, dx, dy;
+						tpsTransform.EvalPoints(1, &x, &y, &dxPoint, &dyPoint, 1.0f);
+						field.Get(atY * width + (atY * 7) % width, dx, dy);
+						Assert::AreEqual(dxPoint, dx, 1e-9);
+						Assert::AreEqual(dyPoint, dy, 1e-9);
+					}
+				}
+
+				// dragging a destination reuses the factors
+				CVectorD<3> vDst = tpsTransform.GetLandmark<1>(17);
+				vDst[0] += 2.0;
+				tpsTransform.SetLandmark<1>(17, vDst);
+				const CVectorD<3>& vSrc = tpsTransform.GetLandmark<0>(17);
+				CVectorD<3, REAL>::Point_t vOffset;
+				tpsTransform.Eval(CVectorD<3, REAL>::Point_t(vSrc[0], vSrc[1], 0.0), vOffset, 1.0f);
+				Assert::AreEqual(vDst[0] - vSrc[0], vOffset.get<X>(), 1e-6);
+
+				Logger::WriteMessage("Done TestCompactSupport");
+			}
+
+			// tests that an approximate TPS fit to dense samples of a TPS
+			//		stays close to it
+			TEST_METHOD(TestApproximateTPS)
+			{
+				Logger::WriteMessage("TestApproximateTPS");
+
+				// a smooth warp, from a few landmarks
+				CTPSTransform tpsExact;
+				srand(14);
+				for (int nAt = 0; nAt < 12; nAt++)
+				{
+					CVectorD<3> vSrc(512.0 * rand() / RAND_MAX, 384.0 * rand() / RAND_MAX);
+					CVectorD<3> vDst(vSrc[0] + 20.0 * rand() / RAND_MAX - 10.0, vSrc[1] + 20.0 * rand() / RAND_MAX - 10.0);
+					tpsExact.AddLandmark(vSrc, vDst);
+				}
+
+				// and dense correspondences sampled from it
+				CTPSTransform tpsApprox;
+				for (int nAt = 0; nAt < 2000; nAt++)
+				{
+					CVectorD<3> vSrc(512.0 * rand() / RAND_MAX, 384.0 * rand() / RAND_MAX);
+					CVectorD<3, REAL>::Point_t vOffset;
+					tpsExact.Eval(CVectorD<3, REAL>::Point_t(vSrc[0], vSrc[1], 0.0), vOffset, 1.0f);
+					CVectorD<3> vDst(vSrc[0] + vOffset.get<X>(), vSrc[1] + vOffset.get<Y>());
+					tpsApprox.AddLandmark(vSrc, vDst);
+				}
+				tpsApprox.SetApproximateCenterCount(100);
+
+				const int nPoints = 200;
+				std::vector<REAL> arrX(nPoints), arrY(nPoints);
+				for (int nAt = 0; nAt < nPoints; nAt++)
+				{
+					arrX[nAt] = 64.0 + 384.0 * rand() / RAND_MAX;
+					arrY[nAt] = 48.0 + 288.0 * rand() / RAND_MAX;
+				}
+				std::vector<REAL> arrExpectedDx(nPoints), arrExpectedDy(nPoints);
+				std::vector<REAL> arrActualDx(nPoints), arrActualDy(nPoints);
+				tpsExact.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrExpectedDx[0], &arrExpectedDy[0], 1.0f);
+				tpsApprox.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrActualDx[0], &arrActualDy[0], 1.0f);
+				for (int nAt = 0; nAt < nPoints; nAt++)
+				{
+					Assert::AreEqual(arrExpectedDx[nAt], arrActualDx[nAt], 1.0);
+					Assert::AreEqual(arrExpectedDy[nAt], arrActualDy[nAt], 1.0);
+
+					// and Eval agrees with EvalPoints
+					CVectorD<3, REAL>::Point_t vOffset;
+					tpsApprox.Eval(CVectorD<3, REAL>::Point_t(arrX[nAt], arrY[nAt], 0.0), vOffset, 1.0f);
+					Assert::AreEqual(arrActualDx[nAt], vOffset.get<X>(), 1e-9);
+					Assert::AreEqual(arrActualDy[nAt], vOffset.get<Y>(), 1e-9);
+				}
+
+				// the regularization smooths, but still follows the warp
+				tpsApprox.SetApproximateRegularization(1000.0);
+				tpsApprox.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrActualDx[0], &arrActualDy[0], 1.0f);
+				for (int nAt = 0; nAt < nPoints; nAt++)
+				{
+					Assert::AreEqual(arrExpectedDx[nAt], arrActualDx[nAt], 1.0);
+					Assert::AreEqual(arrExpectedDy[nAt], arrActualDy[nAt], 1.0);
+				}
+
+				Logger::WriteMessage("Done TestApproximateTPS");
+			}
+
+			// tests the budget and least recently used order of the basis field cache
+			TEST_METHOD(TestBasisFieldCache)
+			{
+				Logger::WriteMessage("TestBasisFieldCache");
+
+				CBasisFieldCache cache;
+				Assert::IsTrue(cache.Insert(0, 10) == NULL, L"no budget, no images");
+
+				cache.SetBudget(3 * 10 * sizeof(float));
+				cache.Insert(0, 10)[0] = 0.0f;
+				cache.Insert(1, 10)[0] = 1.0f;
+				cache.Insert(2, 10)[0] = 2.0f;
+				Assert::AreEqual(3, cache.GetCount());
+
+				// using 0 makes 1 the least recently used, so it goes first
+				Assert::AreEqual(0.0f, cache.Find(0)[0]);
+				cache.Insert(3, 10);
+				Assert::IsTrue(cache.Find(1) == NULL, L"least recently used dropped");
+				Assert::IsTrue(cache.Find(0) != NULL && cache.Find(2) != NULL, L"others kept");
+				Assert::IsTrue(cache.GetUsedBytes() <= cache.GetBudget(), L"within budget");
+
+				Assert::IsTrue(cache.Insert(4, 40) == NULL, L"one image over the budget");
+				cache.SetBudget(10 * sizeof(float));
+				Assert::AreEqual(1, cache.GetCount());
+
+				Logger::WriteMessage("Done TestBasisFieldCache");
+			}
+
+			// tests that dragging destinations with the basis fields cached gives
+			//		the same field as a full presample
+			TEST_METHOD(TestDragDestinationWithBasisFields)
+			{
+				Logger::WriteMessage("TestDragDestinationWithBasisFields");
+
+				const UINT width = 67, height = 51, bytesPerPixel = 1;
+				const UINT stride = 4 * ((width * bytesPerPixel + 3) / 4);
+				std::vector<BYTE> srcPixels = MakeTestImage(stride, height);
+
+				CTPSTransform tpsTransform;
+				AddWarpLandmarks(tpsTransform, width, height);
+				tpsTransform.SetBasisFieldCacheSize(2 * width * height * sizeof(float));
+				tpsTransform.SetThreadCount(2);
+
+				std::vector<BYTE> actualPixels(srcPixels.size());
+				std::vector<BYTE> expectedPixels(srcPixels.size());
+				tpsTransform.ResampleRawWithField(&srcPixels[0], &actualPixels[0], bytesPerPixel, width, height, stride, 1.0f);
+
+				// drag two destinations in turn, then both at once, then a third
+				//		that pushes the first out of the cache
+				const int arrDragged[] = { 4, 4, 5, 4, 5, 6, 4 };
+				for (int nStep = 0; nStep < 7; nStep++)
+				{
+					CVectorD<3> vDest = tpsTransform.GetLandmark<1>(arrDragged[nStep]);
+					vDest[0] += 0.7;
+					vDest[1] -= 0.4;
+					tpsTransform.SetLandmark<1>(arrDragged[nStep], vDest);
+					if (nStep == 3)
+					{
+						vDest = tpsTransform.GetLandmark<1>(5);
+						vDest[1] += 1.3;
+						tpsTransform.SetLandmark<1>(5, vDest);
+					}
+					tpsTransform.ResampleRawWithField(&srcPixels[0], &actualPixels[0], bytesPerPixel, width, height, stride, 1.0f);
+
+					CTPSTransform tpsExpected;
+					for (int nAt = 0; nAt < tpsTransform.GetLandmarkCount(); nAt++)
+					{
+						tpsExpected.AddLandmark(tpsTransform.GetLandmark<0>(nAt), tpsTransform.GetLandmark<1>(nAt));
+					}
+					tpsExpected.ResampleRawWithField(&srcPixels[0], &expectedPixels[0], bytesPerPixel, width, height, stride, 1.0f);
+
+					// the float fields can move a pixel that is right on a rounding edge
+					int nDiffer = 0;
+					for (size_t nAt = 0; nAt < srcPixels.size(); nAt++)
+					{
+						nDiffer += (actualPixels[nAt] != expectedPixels[nAt]) ? 1 : 0;
+					}
+					Assert::IsTrue(nDiffer * 200 < (int) (width * height), L"updated field == full field");
+				}
+				AssertWarpsAtLandmarks(tpsTransform);
+
+				Logger::WriteMessage("Done TestDragDestinationWithBasisFields");
+			}
+
+			// tests that a compiled snapshot evaluates and resamples as the
+			//		transform did, from several threads at once, while the
+			//		transform is edited
+			TEST_METHOD(TestCompiledSnapshot)
+			{
+				Logger::WriteMessage("TestCompiledSnapshot");
+
+				const UINT width = 64, height = 48, bytesPerPixel = 3;
+				const UINT stride = 4 * ((width * bytesPerPixel + 3) / 4);
+				std::vector<BYTE> srcPixels = MakeTestImage(stride, height);
+
+				CTPSTransform tpsTransform;
+				AddWarpLandmarks(tpsTransform, width, height);
+				std::shared_ptr<const CTPSSnapshot> pSnapshot = tpsTransform.Compile(width, height);
+				Assert::AreEqual(tpsTransform.GetLandmarkCount(), pSnapshot->GetLandmarkCount());
+				Assert::IsTrue(pSnapshot->HasPresampledField(width, height), L"field compiled");
+
+				const int nPoints = 50;
+				std::vector<REAL> arrX(nPoints), arrY(nPoints);
+				for (int nAt = 0; nAt < nPoints; nAt++)
+				{
+					arrX[nAt] = (REAL) ((nAt * 37) % width) + 0.25;
+					arrY[nAt] = (REAL) ((nAt * 11) % height) + 0.5;
+				}
+				std::vector<REAL> arrExpectedDx(nPoints), arrExpectedDy(nPoints);
+				std::vector<REAL> arrActualDx(nPoints), arrActualDy(nPoints);
+				tpsTransform.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrExpectedDx[0], &arrExpectedDy[0], 0.8f);
+				std::vector<BYTE> expectedPixels(srcPixels.size());
+				tpsTransform.ResampleRawWithField(&srcPixels[0], &expectedPixels[0], bytesPerPixel, width, height, stride, 0.8f);
+
+				// render from the snapshot on several threads, while the
+				//		landmarks of the transform are moved and it renders
+				const int nThreads = 4;
+				std::vector<std::vector<BYTE> > arrPixels(nThreads, std::vector<BYTE>(srcPixels.size()));
+				std::vector<std::vector<REAL> > arrDx(nThreads, std::vector<REAL>(nPoints));
+				std::vector<std::vector<REAL> > arrDy(nThreads, std::vector<REAL>(nPoints));
+				std::vector<std::thread> arrWorkers;
+				for (int nThread = 0; nThread < nThreads; nThread++)
+				{
+					arrWorkers.push_back(std::thread([&, nThread]() {
+						for (int nRepeat = 0; nRepeat < 5; nRepeat++)
+						{
+							pSnapshot->ResampleRawWithField(&srcPixels[0], &arrPixels[nThread][0], bytesPerPixel, width, height, stride, 0.8f);
+							pSnapshot->EvalPoints(nPoints, &arrX[0], &arrY[0], &arrDx[nThread][0], &arrDy[nThread][0], 0.8f);
+						}
+					}));
+				}
+				std::vector<BYTE> editedPixels(srcPixels.size());
+				for (int nStep = 0; nStep < 5; nStep++)
+				{
+					CVectorD<3> vDest = tpsTransform.GetLandmark<1>(4);
+					vDest[0] += 1.5;
+					tpsTransform.SetLandmark<1>(4, vDest);
+					tpsTransform.ResampleRawWithField(&srcPixels[0], &editedPixels[0], bytesPerPixel, width, height, stride, 0.8f);
+				}
+				for (auto& worker : arrWorkers)
+				{
+					worker.join();
+				}
+
+				for (int nThread = 0; nThread < nThreads; nThread++)
+				{
+					Assert::IsTrue(arrPixels[nThread] == expectedPixels, L"snapshot field == transform field");
+					Assert::IsTrue(arrDx[nThread] == arrExpectedDx && arrDy[nThread] == arrExpectedDy,
+						L"snapshot EvalPoints == transform EvalPoints");
+				}
+				Assert::IsTrue(editedPixels != expectedPixels, L"transform changed");
+
+				// without the field, the snapshot evaluates each row
+				std::shared_ptr<const CTPSSnapshot> pNoField = tpsTransform.Compile();
+				Assert::IsFalse(pNoField->HasPresampledField(width, height), L"no field compiled");
+				std::vector<BYTE> rawPixels(srcPixels.size());
+				pNoField->ResampleRaw(&srcPixels[0], &rawPixels[0], bytesPerPixel, width, height, stride, 1.0f);
+				tpsTransform.ResampleRawWithField(&srcPixels[0], &expectedPixels[0], bytesPerPixel, width, height, stride, 1.0f);
+				Assert::IsTrue(rawPixels == expectedPixels, L"snapshot ResampleRaw == presampled field");
+
+				Logger::WriteMessage("Done TestCompiledSnapshot");
+			}
+
+			// tests that edits between BeginUpdate and EndUpdate are not 
+			//		seen until the batch ends, and then give the same warp
+			//		as the landmarks added one at a time
+			TEST_METHOD(TestBatchedUpdate)
+			{
+				Logger::WriteMessage("TestBatchedUpdate");
+
+				const UINT width = 60, height = 45, bytesPerPixel = 1;
+				const UINT stride = 4 * ((width * bytesPerPixel + 3) / 4);
+				std::vector<BYTE> srcPixels = MakeTestImage(stride, height);
+
+				CTPSTransform tpsTransform;
+				AddWarpLandmarks(tpsTransform, width, height);
+
+				const int nPoints = 40;
+				std::vector<REAL> arrX(nPoints), arrY(nPoints);
+				for (int nAt = 0; nAt < nPoints; nAt++)
+				{
+					arrX[nAt] = (REAL) ((nAt * 29) % width) + 0.5;
+					arrY[nAt] = (REAL) ((nAt * 13) % height) + 0.25;
+				}
+				std::vector<REAL> arrBeforeDx(nPoints), arrBeforeDy(nPoints);
+				std::vector<REAL> arrDx(nPoints), arrDy(nPoints);
+				tpsTransform.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrBeforeDx[0], &arrBeforeDy[0], 1.0f);
+				std::vector<BYTE> beforePixels(srcPixels.size()), pixels(srcPixels.size());
+				tpsTransform.ResampleRawWithField(&srcPixels[0], &beforePixels[0], bytesPerPixel, width, height, stride, 1.0f);
+
+				// half way through the batch, the warp is still the old one
+				const REAL arrSourceXY[] = { 0.2 * width, 0.7 * height, 0.8 * width, 0.3 * height };
+				const REAL arrDestXY[] = { 0.25 * width, 0.65 * height, 0.75 * width, 0.35 * height };
+				tpsTransform.BeginUpdate();
+				CVectorD<3> vDest = tpsTransform.GetLandmark<1>(5);
+				vDest[1] += 3.0;
+				tpsTransform.SetLandmark<1>(5, vDest);
+				Assert::AreEqual(7, tpsTransform.AddLandmarks(2, arrSourceXY, arrDestXY));
+				Assert::IsTrue(tpsTransform.IsUpdating(), L"nested update still open");
+				Assert::IsTrue(tpsTransform.Compile() == nullptr, L"no snapshot during update");
+
+				tpsTransform.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrDx[0], &arrDy[0], 1.0f);
+				Assert::IsTrue(arrDx == arrBeforeDx && arrDy == arrBeforeDy, L"EvalPoints during update");
+				CVectorD<3>::Point_t vOffset;
+				tpsTransform.Eval(CVectorD<3>(arrX[3], arrY[3]).point(), vOffset, 1.0f);
+				Assert::AreEqual(arrBeforeDx[3], vOffset.get<X>(), 1e-9);
+				Assert::AreEqual(arrBeforeDy[3], vOffset.get<Y>(), 1e-9);
+				tpsTransform.ResampleRawWithField(&srcPixels[0], &pixels[0], bytesPerPixel, width, height, stride, 1.0f);
+				Assert::IsTrue(pixels == beforePixels, L"ResampleRawWithField during update");
+
+				tpsTransform.EndUpdate();
+				Assert::IsFalse(tpsTransform.IsUpdating(), L"update closed");
+				std::shared_ptr<const CTPSSnapshot> pSnapshot = tpsTransform.Compile();
+				Assert::IsTrue(pSnapshot != nullptr, L"snapshot after update");
+				Assert::AreEqual(tpsTransform.GetLandmarkCount(), pSnapshot->GetLandmarkCount());
+
+				// after the batch, the same warp as the landmarks added one
+				//		at a time to a new transform
+				CTPSTransform tpsExpected;
+				for (int nAt = 0; nAt < tpsTransform.GetLandmarkCount(); nAt++)
+				{
+					tpsExpected.AddLandmark(tpsTransform.GetLandmark<0>(nAt), tpsTransform.GetLandmark<1>(nAt));
+				}
+				Assert::AreEqual(9, tpsExpected.GetLandmarkCount());
+				std::vector<REAL> arrExpectedDx(nPoints), arrExpectedDy(nPoints);
+				tpsExpected.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrExpectedDx[0], &arrExpectedDy[0], 1.0f);
+				tpsTransform.EvalPoints(nPoints, &arrX[0], &arrY[0], &arrDx[0], &arrDy[0], 1.0f);
+				for (int nAt = 0; nAt < nPoints; nAt++)
+				{
+					Assert::AreEqual(arrExpectedDx[nAt], arrDx[nAt], 1e-8);
+					Assert::AreEqual(arrExpectedDy[nAt], arrDy[nAt], 1e-8);
+				}
+				AssertWarpsAtLandmarks(tpsTransform);
+				std::vector<REAL> arrSnapshotDx(nPoints), arrSnapshotDy(nPoints);
+				pSnapshot->EvalPoints(nPoints, &arrX[0], &arrY[0], &arrSnapshotDx[0], &arrSnapshotDy[0], 1.0f);
+				Assert::IsTrue(arrSnapshotDx == arrDx && arrSnapshotDy == arrDy, L"snapshot of the batch");
+
+				// and the field is presampled again
+				std::vector<BYTE> expectedPixels(srcPixels.size());
+				tpsExpected.ResampleRawWithField(&srcPixels[0], &expectedPixels[0], bytesPerPixel, width, height, stride, 1.0f);
+				tpsTransform.ResampleRawWithField(&srcPixels[0], &pixels[0], bytesPerPixel, width, height, stride, 1.0f);
+				Assert::IsTrue(pixels == expectedPixels, L"field after update");
+
+				// an unbalanced EndUpdate is ignored, so the next batch still holds
+				tpsTransform.EndUpdate();
+				Assert::IsFalse(tpsTransform.IsUpdating(), L"no update open");
+				tpsTransform.BeginUpdate();
+				Assert::IsTrue(tpsTransform.IsUpdating(), L"update opened after an unbalanced EndUpdate");
+				tpsTransform.EndUpdate();
+
+				Logger::WriteMessage("Done TestBatchedUpdate");
+			}
+
+			// checks the factors against a solve with the matrix they factor
+			void AssertSolves(const CLUFactorization& lu, const ublas::matrix<REAL>& mA, const wchar_t *message)
+			{
+				ublas::matrix<REAL> mX(mA.size1(), 1);
+				for (std::size_t nAt = 0; nAt < mA.size1(); nAt++)
+				{
+					mX(nAt, 0) = 1.0 + 0.1 * nAt;
+				}
+				ublas::matrix<REAL> mB = ublas::prod(mA, mX);
+				lu.Solve(mB);
+				for (std::size_t nAt = 0; nAt < mA.size1(); nAt++)
+				{
+					Assert::IsTrue(fabs(mB(nAt, 0) - mX(nAt, 0)) < 1e-9, message);
+				}
+			}
+
+			// checks that each source landmark maps onto its destination landmark
+			void AssertWarpsAtLandmarks(CTPSTransform& tpsTransform, REAL tolerance = 1e-6)
+			{
+				for (int nLandmark = 0; nLandmark < tpsTransform.GetLandmarkCount(); nLandmark++)
+				{
+					CVectorD<3, REAL>::Point_t vOffset;
+					tpsTransform.Eval(tpsTransform.GetLandmark<0>(nLandmark).point(), vOffset, 1.0);
+
+					CVectorD<3, REAL> vTransformed(tpsTransform.GetLandmark<0>(nLandmark));
+					vTransformed[0] += vOffset.get<X>();
+					vTransformed[1] += vOffset.get<Y>();
+					Assert::IsTrue(vTransformed.IsApproxEqual(tpsTransform.GetLandmark<1>(nLandmark), tolerance),
+						L"landmark warps onto its destination");
+				}
+			}
+
+			// adds corner landmarks plus a few displaced interior landmarks
+			void AddWarpLandmarks(CTPSTransform& tpsTransform, UINT width, UINT height)
+			{
+				tpsTransform.AddLandmark(CVectorD<3>(0.0, 0.0));
+				tpsTransform.AddLandmark(CVectorD<3>(0.0, height));
+				tpsTransform.AddLandmark(CVectorD<3>(width, height));
+				tpsTransform.AddLandmark(CVectorD<3>(width, 0.0));
+				tpsTransform.AddLandmark(CVectorD<3>(0.3 * width, 0.4 * height), CVectorD<3>(0.35 * width, 0.3 * height));
+				tpsTransform.AddLandmark(CVectorD<3>(0.7 * width, 0.6 * height), CVectorD<3>(0.6 * width, 0.65 * height));
+				tpsTransform.AddLandmark(CVectorD<3>(0.5 * width, 0.8 * height), CVectorD<3>(0.55 * width, 0.85 * height));
+			}
+
+			// makes a deterministic pseudo-random image
+			std::vector<BYTE> MakeTestImage(UINT stride, UINT height)
+			{
+				std::vector<BYTE> pixels(stride * height);
+				for (size_t nAt = 0; nAt < pixels.size(); nAt++)
+				{
+					pixels[nAt] = (BYTE)((nAt * 2654435761u) >> 13);
+				}
+				return pixels;
+			}
+
 			void FlushStream(std::stringstream& stream)
 			{
 				Logger::WriteMessage(stream.str().c_str()); 
@@ -0,0 +1,174 @@
+//////////////////////////////////////////////////////////////////////
+// BasisFieldCache.h: interface for the CBasisFieldCache class.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <list>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////
+// class CBasisFieldCache
+//
+// holds float images, one per landmark, within a memory budget.  when
+//		a new image would go over the budget, the least recently used
+//		images are dropped.  a budget of zero turns the cache off
+//////////////////////////////////////////////////////////////////////
+class CBasisFieldCache
+{
+public:
+	// construction
+	CBasisFieldCache();
+
+	// the memory budget, in bytes
+	size_t GetBudget() const { return m_nBudget; }
+	void SetBudget(size_t nBytes);
+
+	// the memory held by the cached images, in bytes
+	size_t GetUsedBytes() const { return m_nUsedBytes; }
+
+	// the number of cached images
+	int GetCount() const { return (int) m_lstFields.size(); }
+
+	// drops all images
+	void Clear();
+
+	// returns the image for the landmark, or NULL if it is not cached
+	const float *Find(int nLandmark);
+
+	// allocates the image for the landmark, dropping images to stay in
+	//		budget.  returns NULL if one image is over the budget
+	float *Insert(int nLandmark, int nPixels);
+
+	// drops the image for the landmark, if it is cached
+	void Remove(int nLandmark);
+
+private:
+	// makes room for nBytes more, dropping the least recently used
+	void Evict(size_t nBytes);
+
+	// an image and its landmark
+	struct CField
+	{
+		int m_nLandmark;
+		std::vector<float> m_arrPixels;
+	};
+
+	// the images, most recently used first
+	std::list<CField> m_lstFields;
+
+	// the budget, and the memory used
+	size_t m_nBudget;
+	size_t m_nUsedBytes;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CBasisFieldCache::CBasisFieldCache
+//
+// constructs an empty cache, turned off
+//////////////////////////////////////////////////////////////////////
+inline CBasisFieldCache::CBasisFieldCache()
+	: m_nBudget(0)
+	, m_nUsedBytes(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// CBasisFieldCache::SetBudget
+//
+// sets the budget, dropping images if it shrinks
+//////////////////////////////////////////////////////////////////////
+inline void CBasisFieldCache::SetBudget(size_t nBytes)
+{
+	m_nBudget = nBytes;
+	Evict(0);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CBasisFieldCache::Clear
+//
+// drops all images
+//////////////////////////////////////////////////////////////////////
+inline void CBasisFieldCache::Clear()
+{
+	m_lstFields.clear();
+	m_nUsedBytes = 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CBasisFieldCache::Find
+//
+// looks up the image, and moves it to the front of the list
+//////////////////////////////////////////////////////////////////////
+inline const float *CBasisFieldCache::Find(int nLandmark)
+{
+	for (auto iter = m_lstFields.begin(); iter != m_lstFields.end(); iter++)
+	{
+		if (iter->m_nLandmark == nLandmark)
+		{
+			m_lstFields.splice(m_lstFields.begin(), m_lstFields, iter);
+			return m_lstFields.front().m_arrPixels.data();
+		}
+	}
+
+	return NULL;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CBasisFieldCache::Insert
+//
+// allocates a new image at the front of the list
+//////////////////////////////////////////////////////////////////////
+inline float *CBasisFieldCache::Insert(int nLandmark, int nPixels)
+{
+	const size_t nBytes = nPixels * sizeof(float);
+	if (nBytes > m_nBudget)
+	{
+		return NULL;
+	}
+
+	// replace any existing image for the landmark
+	Remove(nLandmark);
+	Evict(nBytes);
+
+	m_lstFields.push_front(CField());
+	m_lstFields.front().m_nLandmark = nLandmark;
+	m_lstFields.front().m_arrPixels.resize(nPixels);
+	m_nUsedBytes += nBytes;
+
+	return m_lstFields.front().m_arrPixels.data();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CBasisFieldCache::Remove
+//
+// drops the image for the landmark
+//////////////////////////////////////////////////////////////////////
+inline void CBasisFieldCache::Remove(int nLandmark)
+{
+	for (auto iter = m_lstFields.begin(); iter != m_lstFields.end(); iter++)
+	{
+		if (iter->m_nLandmark == nLandmark)
+		{
+			m_nUsedBytes -= iter->m_arrPixels.size() * sizeof(float);
+			m_lstFields.erase(iter);
+			return;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CBasisFieldCache::Evict
+//
+// drops images from the back of the list until nBytes more fit
+//////////////////////////////////////////////////////////////////////
+inline void CBasisFieldCache::Evict(size_t nBytes)
+{
+	while (!m_lstFields.empty() && m_nUsedBytes + nBytes > m_nBudget)
+	{
+		m_nUsedBytes -= m_lstFields.back().m_arrPixels.size() * sizeof(float);
+		m_lstFields.pop_back();
+	}
+}
@@ -0,0 +1,282 @@
+//////////////////////////////////////////////////////////////////////
+// DisplacementField.h: interface for the CDisplacementField class.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+// REAL
+#include "MathUtil.h"
+
+//////////////////////////////////////////////////////////////////////
+// class CDisplacementField
+//
+// holds the presampled dx and dy of each pixel as two planes, in one of
+//		three formats:
+//			FORMAT_DOUBLE  - 16 bytes per pixel, exact
+//			FORMAT_FLOAT   - 8 bytes per pixel
+//			FORMAT_FIXED16 - 4 bytes per pixel, in steps of 1/subpixels,
+//							 saturating at +/- 32768 steps
+//////////////////////////////////////////////////////////////////////
+class CDisplacementField
+{
+public:
+	enum Format { FORMAT_DOUBLE, FORMAT_FLOAT, FORMAT_FIXED16 };
+
+	// construction
+	CDisplacementField();
+
+	// sets the storage format.  the values are dropped if it changes.  a
+	//		subpixels that is not positive is taken as the default, 32
+	void SetFormat(Format format, REAL subpixels = 32.0);
+	Format GetFormat() const { return m_format; }
+	REAL GetSubpixels() const { return m_subpixels; }
+
+	// the stored value times the scale is the offset in pixels
+	REAL GetScale() const { return (m_format == FORMAT_FIXED16) ? 1.0 / m_subpixels : 1.0; }
+
+	// sets the size of the field; the values are undefined after
+	void Resize(int width, int height);
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+
+	// the memory held by the planes, in bytes
+	size_t GetBytes() const;
+
+	// stores a row of offsets
+	void SetRow(int nY, const REAL *pDx, const REAL *pDy);
+
+	// stores the offsets of nCount pixels starting at pixel nAt
+	void SetSpan(int nAt, int nCount, const REAL *pDx, const REAL *pDy);
+
+	// adds (dx, dy) times the scalar field to the pixels [nStart, nEnd)
+	void AddScaled(int nStart, int nEnd, const float *pField, REAL dx, REAL dy);
+
+	// returns the offset at a pixel
+	void Get(int nAt, REAL& dx, REAL& dy) const;
+
+	// the planes of the current format, for the resample loops
+	void GetPlanes(const REAL *&pDx, const REAL *&pDy) const { pDx = m_arrDxDouble.data(); pDy = m_arrDyDouble.data(); }
+	void GetPlanes(const float *&pDx, const float *&pDy) const { pDx = m_arrDxFloat.data(); pDy = m_arrDyFloat.data(); }
+	void GetPlanes(const short *&pDx, const short *&pDy) const { pDx = m_arrDxFixed.data(); pDy = m_arrDyFixed.data(); }
+
+protected:
+	// converts to the fixed point steps, saturating
+	short ToFixed(REAL value) const;
+
+private:
+	Format m_format;
+	REAL m_subpixels;
+
+	int m_width;
+	int m_height;
+
+	// only the planes of the current format are allocated
+	std::vector<REAL> m_arrDxDouble;
+	std::vector<REAL> m_arrDyDouble;
+	std::vector<float> m_arrDxFloat;
+	std::vector<float> m_arrDyFloat;
+	std::vector<short> m_arrDxFixed;
+	std::vector<short> m_arrDyFixed;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CDisplacementField::CDisplacementField
+//
+// constructs an empty field of doubles
+//////////////////////////////////////////////////////////////////////
+inline CDisplacementField::CDisplacementField()
+	: m_format(FORMAT_DOUBLE)
+	, m_subpixels(32.0)
+	, m_width(0)
+	, m_height(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// CDisplacementField::SetFormat
+//
+// frees the planes of the old format and allocates the new ones
+//////////////////////////////////////////////////////////////////////
+inline void CDisplacementField::SetFormat(Format format, REAL subpixels)
+{
+	m_format = format;
+	m_subpixels = (subpixels > 0.0) ? subpixels : 32.0;
+
+	std::vector<REAL>().swap(m_arrDxDouble);
+	std::vector<REAL>().swap(m_arrDyDouble);
+	std::vector<float>().swap(m_arrDxFloat);
+	std::vector<float>().swap(m_arrDyFloat);
+	std::vector<short>().swap(m_arrDxFixed);
+	std::vector<short>().swap(m_arrDyFixed);
+	Resize(m_width, m_height);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CDisplacementField::Resize
+//
+// sizes the planes of the current format
+//////////////////////////////////////////////////////////////////////
+inline void CDisplacementField::Resize(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+
+	const size_t nPixels = (size_t) width * height;
+	switch (m_format)
+	{
+	case FORMAT_DOUBLE:
+		m_arrDxDouble.resize(nPixels);
+		m_arrDyDouble.resize(nPixels);
+		break;
+	case FORMAT_FLOAT:
+		m_arrDxFloat.resize(nPixels);
+		m_arrDyFloat.resize(nPixels);
+		break;
+	case FORMAT_FIXED16:
+		m_arrDxFixed.resize(nPixels);
+		m_arrDyFixed.resize(nPixels);
+		break;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CDisplacementField::GetBytes
+//
+// both planes of the current format
+//////////////////////////////////////////////////////////////////////
+inline size_t CDisplacementField::GetBytes() const
+{
+	const size_t nPixels = (size_t) m_width * m_height;
+	switch (m_format)
+	{
+	case FORMAT_FLOAT:
+		return 2 * nPixels * sizeof(float);
+	case FORMAT_FIXED16:
+		return 2 * nPixels * sizeof(short);
+	default:
+		return 2 * nPixels * sizeof(REAL);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CDisplacementField::SetRow
+//
+// converts a row of offsets to the current format
+//////////////////////////////////////////////////////////////////////
+inline void CDisplacementField::SetRow(int nY, const REAL *pDx, const REAL *pDy)
+{
+	SetSpan(nY * m_width, m_width, pDx, pDy);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CDisplacementField::SetSpan
+//
+// converts a span of offsets to the current format
+//////////////////////////////////////////////////////////////////////
+inline void CDisplacementField::SetSpan(int nAt, int nCount, const REAL *pDx, const REAL *pDy)
+{
+	switch (m_format)
+	{
+	case FORMAT_DOUBLE:
+		std::copy(pDx, pDx + nCount, &m_arrDxDouble[nAt]);
+		std::copy(pDy, pDy + nCount, &m_arrDyDouble[nAt]);
+		break;
+	case FORMAT_FLOAT:
+		for (int nAtSpan = 0; nAtSpan < nCount; nAtSpan++)
+		{
+			m_arrDxFloat[nAt + nAtSpan] = (float) pDx[nAtSpan];
+			m_arrDyFloat[nAt + nAtSpan] = (float) pDy[nAtSpan];
+		}
+		break;
+	case FORMAT_FIXED16:
+		for (int nAtSpan = 0; nAtSpan < nCount; nAtSpan++)
+		{
+			m_arrDxFixed[nAt + nAtSpan] = ToFixed(pDx[nAtSpan]);
+			m_arrDyFixed[nAt + nAtSpan] = ToFixed(pDy[nAtSpan]);
+		}
+		break;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CDisplacementField::AddScaled
+//
+// adds a scaled scalar field to both planes.  with fixed point each
+//		add rounds again, so repeated adds drift by up to half a step
+//		each
+//////////////////////////////////////////////////////////////////////
+inline void CDisplacementField::AddScaled(int nStart, int nEnd, const float *pField, REAL dx, REAL dy)
+{
+	switch (m_format)
+	{
+	case FORMAT_DOUBLE:
+		for (int nAt = nStart; nAt < nEnd; nAt++)
+		{
+			m_arrDxDouble[nAt] += dx * pField[nAt];
+			m_arrDyDouble[nAt] += dy * pField[nAt];
+		}
+		break;
+	case FORMAT_FLOAT:
+		for (int nAt = nStart; nAt < nEnd; nAt++)
+		{
+			m_arrDxFloat[nAt] = (float) (m_arrDxFloat[nAt] + dx * pField[nAt]);
+			m_arrDyFloat[nAt] = (float) (m_arrDyFloat[nAt] + dy * pField[nAt]);
+		}
+		break;
+	case FORMAT_FIXED16:
+		for (int nAt = nStart; nAt < nEnd; nAt++)
+		{
+			m_arrDxFixed[nAt] = ToFixed(m_arrDxFixed[nAt] / m_subpixels + dx * pField[nAt]);
+			m_arrDyFixed[nAt] = ToFixed(m_arrDyFixed[nAt] / m_subpixels + dy * pField[nAt]);
+		}
+		break;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CDisplacementField::Get
+//
+// converts the offset at a pixel back to pixels
+//////////////////////////////////////////////////////////////////////
+inline void CDisplacementField::Get(int nAt, REAL& dx, REAL& dy) const
+{
+	switch (m_format)
+	{
+	case FORMAT_DOUBLE:
+		dx = m_arrDxDouble[nAt];
+		dy = m_arrDyDouble[nAt];
+		break;
+	case FORMAT_FLOAT:
+		dx = m_arrDxFloat[nAt];
+		dy = m_arrDyFloat[nAt];
+		break;
+	case FORMAT_FIXED16:
+		dx = m_arrDxFixed[nAt] / m_subpixels;
+		dy = m_arrDyFixed[nAt] / m_subpixels;
+		break;
+	default:
+		dx = dy = 0.0;
+		break;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CDisplacementField::ToFixed
+//
+// rounds to the nearest step, saturating at the range of a short.
+//		NaN, which would pass the clamps, becomes zero
+//////////////////////////////////////////////////////////////////////
+inline short CDisplacementField::ToFixed(REAL value) const
+{
+	REAL steps = floor(value * m_subpixels + 0.5);
+	if (isnan(steps)) {
+		return 0;
+	}
+	return (short) __max(-32768.0, __min(32767.0, steps));
+}
@@ -0,0 +1,290 @@
+//////////////////////////////////////////////////////////////////////
+// FixedVector.h: declaration and definition of the CFixedVector
+//		template class and its expression templates.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <type_traits>
+
+// math utilities
+#include "MathUtil.h"
+
+template<int DIM, class TYPE>
+class CFixedVector;
+
+//////////////////////////////////////////////////////////////////////
+// class CFixedVectorExpr<EXPR, DIM, TYPE>
+//
+// base for vector expressions: a vector, or a sum, difference or
+//		scaling of them.  expressions are evaluated an element at a
+//		time when assigned to a CFixedVector, so a + b - c * s makes
+//		no temporary vectors
+//////////////////////////////////////////////////////////////////////
+template<class EXPR, int DIM, class TYPE>
+class CFixedVectorExpr
+{
+public:
+	// the expression this is the base of
+	constexpr const EXPR& Self() const { return static_cast<const EXPR&>(*this); }
+
+	// evaluates one element of the expression
+	constexpr TYPE Get(int nAt) const { return Self().Get(nAt); }
+};
+
+//////////////////////////////////////////////////////////////////////
+// CFixedVectorOperand<EXPR>
+//
+// how an expression holds its operands: vectors by reference, and the
+//		temporary expressions built from them by value
+//////////////////////////////////////////////////////////////////////
+template<class EXPR>
+struct CFixedVectorOperand
+{
+	typedef const EXPR type;
+};
+
+template<int DIM, class TYPE>
+struct CFixedVectorOperand<CFixedVector<DIM, TYPE> >
+{
+	typedef const CFixedVector<DIM, TYPE>& type;
+};
+
+//////////////////////////////////////////////////////////////////////
+// class CFixedVectorSum<LEFT, RIGHT, DIM, TYPE>
+//
+// the sum of two vector expressions
+//////////////////////////////////////////////////////////////////////
+template<class LEFT, class RIGHT, int DIM, class TYPE>
+class CFixedVectorSum : public CFixedVectorExpr<CFixedVectorSum<LEFT, RIGHT, DIM, TYPE>, DIM, TYPE>
+{
+public:
+	constexpr CFixedVectorSum(const LEFT& left, const RIGHT& right)
+		: m_left(left), m_right(right) { }
+
+	constexpr TYPE Get(int nAt) const { return m_left.Get(nAt) + m_right.Get(nAt); }
+
+private:
+	typename CFixedVectorOperand<LEFT>::type m_left;
+	typename CFixedVectorOperand<RIGHT>::type m_right;
+};
+
+//////////////////////////////////////////////////////////////////////
+// class CFixedVectorDifference<LEFT, RIGHT, DIM, TYPE>
+//
+// the difference of two vector expressions
+//////////////////////////////////////////////////////////////////////
+template<class LEFT, class RIGHT, int DIM, class TYPE>
+class CFixedVectorDifference : public CFixedVectorExpr<CFixedVectorDifference<LEFT, RIGHT, DIM, TYPE>, DIM, TYPE>
+{
+public:
+	constexpr CFixedVectorDifference(const LEFT& left, const RIGHT& right)
+		: m_left(left), m_right(right) { }
+
+	constexpr TYPE Get(int nAt) const { return m_left.Get(nAt) - m_right.Get(nAt); }
+
+private:
+	typename CFixedVectorOperand<LEFT>::type m_left;
+	typename CFixedVectorOperand<RIGHT>::type m_right;
+};
+
+//////////////////////////////////////////////////////////////////////
+// class CFixedVectorScaled<EXPR, DIM, TYPE>
+//
+// a vector expression times a scalar
+//////////////////////////////////////////////////////////////////////
+template<class EXPR, int DIM, class TYPE>
+class CFixedVectorScaled : public CFixedVectorExpr<CFixedVectorScaled<EXPR, DIM, TYPE>, DIM, TYPE>
+{
+public:
+	constexpr CFixedVectorScaled(const EXPR& expr, TYPE scale)
+		: m_expr(expr), m_scale(scale) { }
+
+	constexpr TYPE Get(int nAt) const { return m_expr.Get(nAt) * m_scale; }
+
+private:
+	typename CFixedVectorOperand<EXPR>::type m_expr;
+	TYPE m_scale;
+};
+
+//////////////////////////////////////////////////////////////////////
+// class CFixedVector<DIM, TYPE>
+//
+// a fixed-size vector whose elements are held in place.  unlike
+//		CVectorD, it has no element pointer and no destructor, so it is
+//		trivially copyable: arrays of them are moved with memcpy, and
+//		loops over them vectorize.  used for the library's internal
+//		math; CVectorD converts to and from it
+//////////////////////////////////////////////////////////////////////
+template<int DIM = 3, class TYPE = REAL>
+class CFixedVector : public CFixedVectorExpr<CFixedVector<DIM, TYPE>, DIM, TYPE>
+{
+public:
+	// constructors: elements that are not given are zero
+	constexpr CFixedVector() : m_arrElements{} { }
+	constexpr CFixedVector(TYPE x, TYPE y) : m_arrElements{ x, y } { }
+	constexpr CFixedVector(TYPE x, TYPE y, TYPE z) : m_arrElements{ x, y, z } { }
+	constexpr CFixedVector(TYPE x, TYPE y, TYPE z, TYPE w) : m_arrElements{ x, y, z, w } { }
+
+	// evaluates an expression
+	template<class EXPR>
+	constexpr CFixedVector(const CFixedVectorExpr<EXPR, DIM, TYPE>& expr)
+		: m_arrElements{}
+	{
+		for (int nAt = 0; nAt < DIM; nAt++)
+			m_arrElements[nAt] = expr.Get(nAt);
+	}
+
+	// assignment from an expression
+	template<class EXPR>
+	constexpr CFixedVector& operator=(const CFixedVectorExpr<EXPR, DIM, TYPE>& expr)
+	{
+		// evaluate to a temporary first, in case the expression refers to this
+		TYPE arrElements[DIM] = {};
+		for (int nAt = 0; nAt < DIM; nAt++)
+			arrElements[nAt] = expr.Get(nAt);
+		for (int nAt = 0; nAt < DIM; nAt++)
+			m_arrElements[nAt] = arrElements[nAt];
+		return (*this);
+	}
+
+	// element accessors
+	static constexpr int GetDim() { return DIM; }
+	constexpr TYPE& operator[](int nAt) { return m_arrElements[nAt]; }
+	constexpr const TYPE& operator[](int nAt) const { return m_arrElements[nAt]; }
+	constexpr TYPE Get(int nAt) const { return m_arrElements[nAt]; }
+	TYPE *GetElements() { return m_arrElements; }
+	const TYPE *GetElements() const { return m_arrElements; }
+
+	// in-place vector arithmetic
+	template<class EXPR>
+	constexpr CFixedVector& operator+=(const CFixedVectorExpr<EXPR, DIM, TYPE>& expr)
+	{
+		for (int nAt = 0; nAt < DIM; nAt++)
+			m_arrElements[nAt] += expr.Get(nAt);
+		return (*this);
+	}
+
+	template<class EXPR>
+	constexpr CFixedVector& operator-=(const CFixedVectorExpr<EXPR, DIM, TYPE>& expr)
+	{
+		for (int nAt = 0; nAt < DIM; nAt++)
+			m_arrElements[nAt] -= expr.Get(nAt);
+		return (*this);
+	}
+
+	constexpr CFixedVector& operator*=(TYPE scale)
+	{
+		for (int nAt = 0; nAt < DIM; nAt++)
+			m_arrElements[nAt] *= scale;
+		return (*this);
+	}
+
+	// squared length and length
+	constexpr TYPE GetLength2() const
+	{
+		TYPE length2 = 0;
+		for (int nAt = 0; nAt < DIM; nAt++)
+			length2 += m_arrElements[nAt] * m_arrElements[nAt];
+		return length2;
+	}
+
+	TYPE GetLength() const { return (TYPE) sqrt(GetLength2()); }
+
+	// tests for approximate equality using the epsilon
+	BOOL IsApproxEqual(const CFixedVector& v, TYPE epsilon = DEFAULT_EPSILON) const
+	{
+		return CFixedVector(*this - v).GetLength() < epsilon;
+	}
+
+private:
+	// the vector's elements
+	TYPE m_arrElements[DIM];
+};
+
+static_assert(std::is_trivially_copyable<CFixedVector<3, REAL> >::value,
+	"CFixedVector must be trivially copyable");
+static_assert(sizeof(CFixedVector<3, REAL>) == 3 * sizeof(REAL),
+	"CFixedVector must hold only its elements");
+
+//////////////////////////////////////////////////////////////////////
+// operator+(CFixedVectorExpr, CFixedVectorExpr)
+//
+// the sum of two vector expressions, evaluated when assigned
+//////////////////////////////////////////////////////////////////////
+template<class LEFT, class RIGHT, int DIM, class TYPE>
+constexpr CFixedVectorSum<LEFT, RIGHT, DIM, TYPE> operator+(const CFixedVectorExpr<LEFT, DIM, TYPE>& left,
+	const CFixedVectorExpr<RIGHT, DIM, TYPE>& right)
+{
+	return CFixedVectorSum<LEFT, RIGHT, DIM, TYPE>(left.Self(), right.Self());
+}
+
+//////////////////////////////////////////////////////////////////////
+// operator-(CFixedVectorExpr, CFixedVectorExpr)
+//
+// the difference of two vector expressions, evaluated when assigned
+//////////////////////////////////////////////////////////////////////
+template<class LEFT, class RIGHT, int DIM, class TYPE>
+constexpr CFixedVectorDifference<LEFT, RIGHT, DIM, TYPE> operator-(const CFixedVectorExpr<LEFT, DIM, TYPE>& left,
+	const CFixedVectorExpr<RIGHT, DIM, TYPE>& right)
+{
+	return CFixedVectorDifference<LEFT, RIGHT, DIM, TYPE>(left.Self(), right.Self());
+}
+
+//////////////////////////////////////////////////////////////////////
+// operator*(CFixedVectorExpr, TYPE)
+//
+// a vector expression scaled, evaluated when assigned
+//////////////////////////////////////////////////////////////////////
+template<class EXPR, int DIM, class TYPE>
+constexpr CFixedVectorScaled<EXPR, DIM, TYPE> operator*(const CFixedVectorExpr<EXPR, DIM, TYPE>& expr,
+	TYPE scale)
+{
+	return CFixedVectorScaled<EXPR, DIM, TYPE>(expr.Self(), scale);
+}
+
+template<class EXPR, int DIM, class TYPE>
+constexpr CFixedVectorScaled<EXPR, DIM, TYPE> operator*(TYPE scale,
+	const CFixedVectorExpr<EXPR, DIM, TYPE>& expr)
+{
+	return CFixedVectorScaled<EXPR, DIM, TYPE>(expr.Self(), scale);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Dot(CFixedVectorExpr, CFixedVectorExpr)
+//
+// the dot product of two vector expressions
+//////////////////////////////////////////////////////////////////////
+template<class LEFT, class RIGHT, int DIM, class TYPE>
+constexpr TYPE Dot(const CFixedVectorExpr<LEFT, DIM, TYPE>& left,
+	const CFixedVectorExpr<RIGHT, DIM, TYPE>& right)
+{
+	TYPE dot = 0;
+	for (int nAt = 0; nAt < DIM; nAt++)
+		dot += left.Get(nAt) * right.Get(nAt);
+	return dot;
+}
+
+//////////////////////////////////////////////////////////////////////
+// operator==(CFixedVector, CFixedVector)
+//
+// exact equality; use IsApproxEqual for approximate equality
+//////////////////////////////////////////////////////////////////////
+template<int DIM, class TYPE>
+constexpr bool operator==(const CFixedVector<DIM, TYPE>& vLeft,
+	const CFixedVector<DIM, TYPE>& vRight)
+{
+	for (int nAt = 0; nAt < DIM; nAt++)
+		if (vLeft[nAt] != vRight[nAt])
+			return false;
+	return true;
+}
+
+template<int DIM, class TYPE>
+constexpr bool operator!=(const CFixedVector<DIM, TYPE>& vLeft,
+	const CFixedVector<DIM, TYPE>& vRight)
+{
+	return !(vLeft == vRight);
+}
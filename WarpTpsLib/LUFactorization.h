@@ -0,0 +1,446 @@
+//////////////////////////////////////////////////////////////////////
+// LUFactorization.h: interface for the CLUFactorization class.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// math utilities
+#include "MathUtil.h"
+
+//////////////////////////////////////////////////////////////////////
+// class CLUFactorization
+//
+// holds the LU factors (with partial pivoting) of a square matrix,
+//		P A0 = L U, in the in-place form produced by ublas::lu_factorize,
+//		plus a low-rank correction A = A0 + U_c V_c^T that is updated in
+//		O(n^2) as rows and columns of a symmetric A change.  solves go
+//		through the Sherman-Morrison-Woodbury identity
+//			A^-1 = A0^-1 - Z C^-1 V_c^T A0^-1
+//		with Z = A0^-1 U_c and the capacitance C = I + V_c^T Z.  the 
+//		matrix can also grow by one row and column, either by bordering
+//		the factors, or (exactly) by an identity row that a correction
+//		then fills in.  an update that leaves C ill-conditioned reports
+//		failure, and the caller refactors from scratch
+//////////////////////////////////////////////////////////////////////
+class CLUFactorization
+{
+public:
+	// construction
+	CLUFactorization();
+
+	// factorizes the matrix and drops any correction; returns false if
+	//		it is singular
+	bool Factorize(const ublas::matrix<REAL>& mA);
+
+	// discards the factors
+	void Clear();
+
+	// true if the factors are usable
+	bool IsValid() const { return m_bValid; }
+
+	// dimension of the factored matrix
+	int GetSize() const { return (int) m_mLU.size1(); }
+
+	// number of updates applied since the last Factorize, and the rank
+	//		of the correction they have built up
+	int GetUpdateCount() const { return m_nUpdates; }
+	int GetCorrectionRank() const { return (int) m_mV.size2(); }
+
+	// solves A X = B in place, for all columns of B at once
+	void Solve(ublas::matrix<REAL>& mB) const;
+
+	// borders the factors of a symmetric matrix with one more row and 
+	//		column: A' = [A b; b^T d].  only possible without a correction,
+	//		and fails (leaving the factors as they were) on a small pivot
+	bool Append(const ublas::vector<REAL>& vB, REAL d);
+
+	// grows the matrix by one row and column of the identity
+	void AppendIdentity();
+
+	// changes row and column k of a symmetric matrix by vDelta (the
+	//		change to column k, including its diagonal element)
+	bool UpdateSymmetric(int k, const ublas::vector<REAL>& vDelta);
+
+protected:
+	// solves A0 X = B in place, with the factors of A0
+	void SolveFactors(ublas::matrix<REAL>& mB) const;
+
+	// true if the pivot is too small, relative to the matrix scale
+	bool IsPivotTooSmall(REAL pivot) const;
+
+private:
+	// the factors of A0: unit-lower L below the diagonal, U on and above
+	ublas::matrix<REAL> m_mLU;
+
+	// the row permutation, as the sequence of row swaps
+	ublas::permutation_matrix<std::size_t> m_pm;
+
+	// the correction, as V_c and Z = A0^-1 U_c (one column per rank)
+	ublas::matrix<REAL> m_mV;
+	ublas::matrix<REAL> m_mZ;
+
+	// the capacitance matrix, and its factors
+	ublas::matrix<REAL> m_mC;
+	ublas::matrix<REAL> m_mC_LU;
+	ublas::permutation_matrix<std::size_t> m_pmC;
+
+	// largest element of the factored matrix, to scale the pivot test
+	REAL m_scale;
+
+	// updates since the last factorization
+	int m_nUpdates;
+
+	// flag to indicate the factors are usable
+	bool m_bValid;
+};
+
+//////////////////////////////////////////////////////////////////////
+// tolerances for the updates
+//////////////////////////////////////////////////////////////////////
+
+// smallest pivot accepted by a bordering, relative to the matrix scale
+const REAL LU_UPDATE_PIVOT_TOLERANCE = 1e-13;
+
+// largest multiplier accepted by a bordering.  partial pivoting keeps
+//		the multipliers at or below 1, so growth past this means the 
+//		bordered factors would lose the stability of the original ones
+const REAL LU_UPDATE_MAX_MULTIPLIER = 1e3;
+
+// smallest ratio of the smallest to the largest pivot of the 
+//		capacitance matrix; below this the correction has lost nearly
+//		all of its digits
+const REAL LU_CAPACITANCE_TOLERANCE = 1e-13;
+
+//////////////////////////////////////////////////////////////////////
+// CLUFactorization::CLUFactorization
+//
+// constructs an empty factorization
+//////////////////////////////////////////////////////////////////////
+inline CLUFactorization::CLUFactorization()
+	: m_pm(0)
+	, m_pmC(0)
+	, m_scale(0.0)
+	, m_nUpdates(0)
+	, m_bValid(false)
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLUFactorization::Factorize
+//
+// factorizes the matrix from scratch
+//////////////////////////////////////////////////////////////////////
+inline bool CLUFactorization::Factorize(const ublas::matrix<REAL>& mA)
+{
+	m_mLU = mA;
+	m_pm = ublas::permutation_matrix<std::size_t>(mA.size1());
+	m_nUpdates = 0;
+
+	// no correction
+	m_mV.resize(mA.size1(), 0, false);
+	m_mZ.resize(mA.size1(), 0, false);
+	m_mC.resize(0, 0, false);
+	m_mC_LU.resize(0, 0, false);
+	m_pmC = ublas::permutation_matrix<std::size_t>(0);
+
+	m_scale = 0.0;
+	for (std::size_t nRow = 0; nRow < mA.size1(); nRow++)
+	{
+		for (std::size_t nCol = 0; nCol < mA.size2(); nCol++)
+		{
+			m_scale = __max(m_scale, fabs(mA(nRow, nCol)));
+		}
+	}
+
+	m_bValid = (ublas::lu_factorize(m_mLU, m_pm) == 0);
+	return m_bValid;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLUFactorization::Clear
+//
+// discards the factors
+//////////////////////////////////////////////////////////////////////
+inline void CLUFactorization::Clear()
+{
+	m_mLU.resize(0, 0, false);
+	m_pm = ublas::permutation_matrix<std::size_t>(0);
+	m_mV.resize(0, 0, false);
+	m_mZ.resize(0, 0, false);
+	m_mC.resize(0, 0, false);
+	m_mC_LU.resize(0, 0, false);
+	m_pmC = ublas::permutation_matrix<std::size_t>(0);
+	m_nUpdates = 0;
+	m_bValid = false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLUFactorization::Solve
+//
+// solves with the factors of A0, then removes the part of the solution
+//		that the correction accounts for
+//////////////////////////////////////////////////////////////////////
+inline void CLUFactorization::Solve(ublas::matrix<REAL>& mB) const
+{
+	ASSERT(m_bValid);
+	SolveFactors(mB);
+
+	if (GetCorrectionRank() > 0)
+	{
+		ublas::matrix<REAL> mT = ublas::prod(ublas::trans(m_mV), mB);
+		ublas::lu_substitute(m_mC_LU, m_pmC, mT);
+		mB -= ublas::prod(m_mZ, mT);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLUFactorization::SolveFactors
+//
+// forward and back substitution along the rows of the factors, which
+//		are contiguous, updating all columns of B together
+//////////////////////////////////////////////////////////////////////
+inline void CLUFactorization::SolveFactors(ublas::matrix<REAL>& mB) const
+{
+	const int n = GetSize();
+	const int nCols = (int) mB.size2();
+	ASSERT((int) mB.size1() == n);
+
+	ublas::swap_rows(m_pm, mB);
+
+	// L has a unit diagonal
+	for (int nRow = 1; nRow < n; nRow++)
+	{
+		const REAL *pL = &m_mLU(nRow, 0);
+		for (int nAtCol = 0; nAtCol < nCols; nAtCol++)
+		{
+			REAL sum = mB(nRow, nAtCol);
+			for (int nAt = 0; nAt < nRow; nAt++)
+			{
+				sum -= pL[nAt] * mB(nAt, nAtCol);
+			}
+			mB(nRow, nAtCol) = sum;
+		}
+	}
+
+	for (int nRow = n - 1; nRow >= 0; nRow--)
+	{
+		const REAL *pU = &m_mLU(nRow, 0);
+		for (int nAtCol = 0; nAtCol < nCols; nAtCol++)
+		{
+			REAL sum = mB(nRow, nAtCol);
+			for (int nAt = nRow + 1; nAt < n; nAt++)
+			{
+				sum -= pU[nAt] * mB(nAt, nAtCol);
+			}
+			mB(nRow, nAtCol) = sum / pU[nRow];
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLUFactorization::IsPivotTooSmall
+//
+// tests a bordering pivot against the scale of the matrix
+//////////////////////////////////////////////////////////////////////
+inline bool CLUFactorization::IsPivotTooSmall(REAL pivot) const
+{
+	return !(fabs(pivot) > LU_UPDATE_PIVOT_TOLERANCE * m_scale);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLUFactorization::Append
+//
+// borders the factors of a symmetric matrix.  the new row is not
+//		pivoted, so
+//			P' = [P 0; 0 1],  L' = [L 0; l^T 1],  U' = [U u; 0 delta]
+//		with L u = P b, U^T l = b and delta = d - l . u
+//////////////////////////////////////////////////////////////////////
+inline bool CLUFactorization::Append(const ublas::vector<REAL>& vB, REAL d)
+{
+	if (!m_bValid || GetCorrectionRank() > 0)
+	{
+		return false;
+	}
+
+	const int n = GetSize();
+	ASSERT((int) vB.size() == n);
+
+	// forward substitution for u, with the rows of b permuted
+	ublas::vector<REAL> vU(vB);
+	ublas::swap_rows(m_pm, vU);
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		REAL sum = vU(nRow);
+		for (int nCol = 0; nCol < nRow; nCol++)
+		{
+			sum -= m_mLU(nRow, nCol) * vU(nCol);
+		}
+		vU(nRow) = sum;
+	}
+
+	// forward substitution for l, through U^T
+	ublas::vector<REAL> vL(vB);
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		REAL sum = vL(nRow);
+		for (int nCol = 0; nCol < nRow; nCol++)
+		{
+			sum -= m_mLU(nCol, nRow) * vL(nCol);
+		}
+		vL(nRow) = sum / m_mLU(nRow, nRow);
+		if (fabs(vL(nRow)) > LU_UPDATE_MAX_MULTIPLIER)
+		{
+			return false;
+		}
+	}
+
+	// the new pivot
+	REAL delta = d - ublas::inner_prod(vL, vU);
+	REAL scale = __max(m_scale, __max(fabs(d), ublas::norm_inf(vB)));
+	if (!(fabs(delta) > LU_UPDATE_PIVOT_TOLERANCE * scale))
+	{
+		return false;
+	}
+	m_scale = scale;
+
+	// grow the factors and the permutation
+	m_mLU.resize(n + 1, n + 1, true);
+	for (int nAt = 0; nAt < n; nAt++)
+	{
+		m_mLU(nAt, n) = vU(nAt);
+		m_mLU(n, nAt) = vL(nAt);
+	}
+	m_mLU(n, n) = delta;
+
+	m_pm.resize(n + 1, true);
+	m_pm(n) = n;
+
+	m_mV.resize(n + 1, 0, false);
+	m_mZ.resize(n + 1, 0, false);
+
+	m_nUpdates++;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLUFactorization::AppendIdentity
+//
+// an identity row and column is decoupled from the rest of A0, so its
+//		factors are the identity too.  the correction does not touch it
+//////////////////////////////////////////////////////////////////////
+inline void CLUFactorization::AppendIdentity()
+{
+	const int n = GetSize();
+	const int r = GetCorrectionRank();
+
+	m_mLU.resize(n + 1, n + 1, true);
+	for (int nAt = 0; nAt < n; nAt++)
+	{
+		m_mLU(nAt, n) = 0.0;
+		m_mLU(n, nAt) = 0.0;
+	}
+	m_mLU(n, n) = 1.0;
+
+	m_pm.resize(n + 1, true);
+	m_pm(n) = n;
+
+	m_mV.resize(n + 1, r, true);
+	m_mZ.resize(n + 1, r, true);
+	for (int nAt = 0; nAt < r; nAt++)
+	{
+		m_mV(n, nAt) = 0.0;
+		m_mZ(n, nAt) = 0.0;
+	}
+
+	m_scale = __max(m_scale, 1.0);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CLUFactorization::UpdateSymmetric
+//
+// a change of row and column k by delta is the rank-2 correction
+//		w e_k^T + e_k w^T, with w = delta - delta_k / 2 e_k, so U_c 
+//		gains the columns (w, e_k) and V_c the columns (e_k, w).  this 
+//		costs two solves with the factors of A0, and the refactoring of
+//		the (small) capacitance matrix.  the pivot test on C only 
+//		catches a correction that has clearly broken down; callers that
+//		need a guarantee check the residual of their solution
+//////////////////////////////////////////////////////////////////////
+inline bool CLUFactorization::UpdateSymmetric(int k, const ublas::vector<REAL>& vDelta)
+{
+	if (!m_bValid)
+	{
+		return false;
+	}
+
+	const int n = GetSize();
+	const int r = GetCorrectionRank();
+	ASSERT((int) vDelta.size() == n);
+
+	ublas::vector<REAL> vW(vDelta);
+	vW(k) -= 0.5 * vDelta(k);
+
+	// nothing to correct
+	const REAL normW = ublas::norm_inf(vW);
+	if (normW == 0.0)
+	{
+		m_nUpdates++;
+		return true;
+	}
+
+	// the new columns of V_c and Z, with w and e_k scaled to the same
+	//		size so that the capacitance matrix stays balanced
+	const REAL scale = sqrt(normW);
+	m_mV.resize(n, r + 2, true);
+	m_mZ.resize(n, r + 2, true);
+	for (int nAt = 0; nAt < n; nAt++)
+	{
+		const REAL e = (nAt == k) ? scale : 0.0;
+		m_mV(nAt, r + 0) = e;
+		m_mV(nAt, r + 1) = vW(nAt) / scale;
+		m_mZ(nAt, r + 0) = vW(nAt) / scale;
+		m_mZ(nAt, r + 1) = e;
+	}
+	ublas::matrix_range<ublas::matrix<REAL>> mNewZ(m_mZ, ublas::range(0, n), ublas::range(r, r + 2));
+	ublas::matrix<REAL> mSolve(mNewZ);
+	SolveFactors(mSolve);
+	mNewZ = mSolve;
+
+	// the new rows and columns of C = I + V_c^T Z
+	m_mC.resize(r + 2, r + 2, true);
+	for (int nRow = 0; nRow < r + 2; nRow++)
+	{
+		for (int nCol = (nRow < r) ? r : 0; nCol < r + 2; nCol++)
+		{
+			m_mC(nRow, nCol) = ((nRow == nCol) ? 1.0 : 0.0)
+				+ ublas::inner_prod(ublas::column(m_mV, nRow), ublas::column(m_mZ, nCol));
+		}
+	}
+
+	// factor C, and check how far its pivots spread
+	m_mC_LU = m_mC;
+	m_pmC = ublas::permutation_matrix<std::size_t>(r + 2);
+	if (ublas::lu_factorize(m_mC_LU, m_pmC) != 0)
+	{
+		m_bValid = false;
+		return false;
+	}
+
+	REAL minPivot = fabs(m_mC_LU(0, 0));
+	REAL maxPivot = minPivot;
+	for (int nAt = 1; nAt < r + 2; nAt++)
+	{
+		minPivot = __min(minPivot, fabs(m_mC_LU(nAt, nAt)));
+		maxPivot = __max(maxPivot, fabs(m_mC_LU(nAt, nAt)));
+	}
+	if (!(minPivot > LU_CAPACITANCE_TOLERANCE * maxPivot))
+	{
+		m_bValid = false;
+		return false;
+	}
+
+	m_nUpdates++;
+	return true;
+}
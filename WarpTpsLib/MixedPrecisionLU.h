@@ -0,0 +1,442 @@
+//////////////////////////////////////////////////////////////////////
+// MixedPrecisionLU.h: interface for the CMixedPrecisionLU class.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+// math utilities
+#include "MathUtil.h"
+
+// passes of the symmetric scaling that brings the rows and columns of
+//		the matrix to about unit size
+const int MIXED_LU_EQUILIBRATION_PASSES = 4;
+
+// most refinement steps for a solve
+const int MIXED_LU_MAX_REFINEMENTS = 20;
+
+// relative size of a correction at which the refinement stops
+const REAL MIXED_LU_TOLERANCE = 1e-15;
+
+// largest backward error a solve is accepted with
+const REAL MIXED_LU_MAX_BACKWARD_ERROR = 1e-13;
+
+//////////////////////////////////////////////////////////////////////
+// class CMixedPrecisionLU
+//
+// solves A X = B with the LU factors (with partial pivoting) of A in
+//		float, which take half the memory and bandwidth of REAL ones
+//		and factor at twice the vector width, then refines the solution
+//		against A in REAL until it is as accurate as a REAL solve.  A
+//		is first scaled symmetrically, S A S, so that its rows and
+//		columns are of about unit size: for L, the x and y columns grow
+//		with the image size and K with its square, and the scaling
+//		normalizes them as if the landmarks were in unit coordinates.
+//		the refinement converges while the condition number of S A S is
+//		well below 1 / FLT_EPSILON; Solve reports failure when it does
+//		not, and the caller factors in REAL instead
+//////////////////////////////////////////////////////////////////////
+class CMixedPrecisionLU
+{
+public:
+	// construction
+	CMixedPrecisionLU();
+
+	// scales and factorizes the matrix, and estimates its condition;
+	//		returns false if it is singular in float
+	bool Factorize(const ublas::matrix<REAL>& mA);
+
+	// discards the factors
+	void Clear();
+
+	// true if the factors are usable
+	bool IsValid() const { return m_bValid; }
+
+	// dimension of the factored matrix
+	int GetSize() const { return m_n; }
+
+	// solves A X = B in place, for all columns of B at once; returns
+	//		false if the refinement stalled above MIXED_LU_MAX_BACKWARD_ERROR
+	bool Solve(ublas::matrix<REAL>& mB);
+
+	// the normwise backward error of the last solve, for the scaled
+	//		system: |S (B - A X)| / (|S A S| |S^-1 X| + |S B|), infinity norm
+	REAL GetResidual() const { return m_residual; }
+
+	// refinement steps taken by the last solve
+	int GetRefinementCount() const { return m_nRefinements; }
+
+	// estimate of the 1-norm condition number of the scaled matrix
+	REAL GetConditionEstimate() const { return m_condition; }
+
+protected:
+	// solves S A S x = b in place with the float factors, or its
+	//		transpose
+	void SolveFactors(float *pB) const;
+	void SolveFactorsTranspose(float *pB) const;
+
+	// estimates the 1-norm of (S A S)^-1 from a few solves (Hager)
+	REAL EstimateInverseNorm() const;
+
+private:
+	// the matrix, and the infinity norm of S A S
+	int m_n;
+	ublas::matrix<REAL> m_mA;
+	REAL m_normScaled;
+
+	// the symmetric scaling
+	std::vector<REAL> m_arrScale;
+
+	// the factors of S A S by rows: unit-lower L below the diagonal, U on
+	//		and above, with the row swapped into each row at each step
+	std::vector<float> m_arrLU;
+	std::vector<int> m_arrPivot;
+
+	// the reports
+	REAL m_residual;
+	int m_nRefinements;
+	REAL m_condition;
+
+	// flag to indicate the factors are usable
+	bool m_bValid;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CMixedPrecisionLU::CMixedPrecisionLU
+//
+// constructs an empty factorization
+//////////////////////////////////////////////////////////////////////
+inline CMixedPrecisionLU::CMixedPrecisionLU()
+{
+	Clear();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CMixedPrecisionLU::Clear
+//
+// discards the factors
+//////////////////////////////////////////////////////////////////////
+inline void CMixedPrecisionLU::Clear()
+{
+	m_n = 0;
+	m_mA.resize(0, 0, false);
+	m_normScaled = 0.0;
+	m_arrScale.clear();
+	m_arrLU.clear();
+	m_arrPivot.clear();
+	m_residual = 0.0;
+	m_nRefinements = 0;
+	m_condition = 0.0;
+	m_bValid = false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CMixedPrecisionLU::Factorize
+//
+// each pass of the scaling divides row and column i by the square
+//		root of the largest element of row i.  the scaled matrix is then
+//		narrowed to float and factored by rows: at each step the pivot
+//		row is swapped in, and the rows below it are updated along
+//		their contiguous tails
+//////////////////////////////////////////////////////////////////////
+inline bool CMixedPrecisionLU::Factorize(const ublas::matrix<REAL>& mA)
+{
+	Clear();
+	m_n = (int) mA.size1();
+	m_mA = mA;
+	const int n = m_n;
+
+	// the scaling
+	m_arrScale.assign(n, 1.0);
+	for (int nPass = 0; nPass < MIXED_LU_EQUILIBRATION_PASSES; nPass++)
+	{
+		std::vector<REAL> arrMax(n, 0.0);
+		for (int nRow = 0; nRow < n; nRow++)
+		{
+			for (int nCol = 0; nCol < n; nCol++)
+			{
+				arrMax[nRow] = __max(arrMax[nRow],
+					fabs(mA(nRow, nCol)) * m_arrScale[nRow] * m_arrScale[nCol]);
+			}
+		}
+		for (int nRow = 0; nRow < n; nRow++)
+		{
+			if (arrMax[nRow] > 0.0)
+			{
+				m_arrScale[nRow] /= sqrt(arrMax[nRow]);
+			}
+		}
+	}
+
+	m_arrLU.resize((size_t) n * n);
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		for (int nCol = 0; nCol < n; nCol++)
+		{
+			m_arrLU[(size_t) nRow * n + nCol] =
+				(float) (mA(nRow, nCol) * m_arrScale[nRow] * m_arrScale[nCol]);
+		}
+	}
+
+	// factor
+	m_arrPivot.resize(n);
+	for (int nStep = 0; nStep < n; nStep++)
+	{
+		int nPivot = nStep;
+		for (int nRow = nStep + 1; nRow < n; nRow++)
+		{
+			if (fabs(m_arrLU[(size_t) nRow * n + nStep]) > fabs(m_arrLU[(size_t) nPivot * n + nStep]))
+			{
+				nPivot = nRow;
+			}
+		}
+		m_arrPivot[nStep] = nPivot;
+		if (m_arrLU[(size_t) nPivot * n + nStep] == 0.0f)
+		{
+			Clear();
+			return false;
+		}
+		if (nPivot != nStep)
+		{
+			std::swap_ranges(&m_arrLU[(size_t) nStep * n], &m_arrLU[(size_t) nStep * n] + n,
+				&m_arrLU[(size_t) nPivot * n]);
+		}
+
+		const float *pPivotRow = &m_arrLU[(size_t) nStep * n];
+		const float invPivot = 1.0f / pPivotRow[nStep];
+		for (int nRow = nStep + 1; nRow < n; nRow++)
+		{
+			float *pRow = &m_arrLU[(size_t) nRow * n];
+			const float l = pRow[nStep] * invPivot;
+			pRow[nStep] = l;
+			if (l != 0.0f)
+			{
+				for (int nCol = nStep + 1; nCol < n; nCol++)
+				{
+					pRow[nCol] -= l * pPivotRow[nCol];
+				}
+			}
+		}
+	}
+
+	m_bValid = true;
+
+	// the condition number, from the norm of S A S
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		REAL sum = 0.0;
+		for (int nCol = 0; nCol < n; nCol++)
+		{
+			sum += fabs(mA(nRow, nCol)) * m_arrScale[nRow] * m_arrScale[nCol];
+		}
+		m_normScaled = __max(m_normScaled, sum);
+	}
+	m_condition = m_normScaled * EstimateInverseNorm();
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CMixedPrecisionLU::Solve
+//
+// each step solves for the correction from the residual of the
+//		current solution, computed in REAL against the unscaled matrix.
+//		the float factors reduce the error by about cond * FLT_EPSILON
+//		per step.  the steps stop when the correction (measured in the
+//		scaled unknowns, so the affine and radial weights count alike)
+//		is at REAL precision, or stops shrinking
+//////////////////////////////////////////////////////////////////////
+inline bool CMixedPrecisionLU::Solve(ublas::matrix<REAL>& mB)
+{
+	ASSERT(m_bValid);
+	const int n = m_n;
+	const int nCols = (int) mB.size2();
+	ASSERT((int) mB.size1() == n);
+
+	ublas::matrix<REAL> mX(n, nCols);
+	mX.clear();
+	ublas::matrix<REAL> mResidual = mB;
+	std::vector<float> arrCorrection(n);
+
+	REAL normB = 0.0;
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		for (int nCol = 0; nCol < nCols; nCol++)
+		{
+			normB = __max(normB, fabs(mB(nRow, nCol)) * m_arrScale[nRow]);
+		}
+	}
+
+	REAL correction = 1.0;
+	m_residual = 0.0;
+	m_nRefinements = 0;
+	while (normB > 0.0 && m_nRefinements < MIXED_LU_MAX_REFINEMENTS)
+	{
+		// the corrections, one column at a time
+		REAL normCorrection = 0.0;
+		for (int nCol = 0; nCol < nCols; nCol++)
+		{
+			for (int nRow = 0; nRow < n; nRow++)
+			{
+				arrCorrection[nRow] = (float) (mResidual(nRow, nCol) * m_arrScale[nRow]);
+			}
+			SolveFactors(&arrCorrection[0]);
+			for (int nRow = 0; nRow < n; nRow++)
+			{
+				normCorrection = __max(normCorrection, (REAL) fabs(arrCorrection[nRow]));
+				mX(nRow, nCol) += (REAL) arrCorrection[nRow] * m_arrScale[nRow];
+			}
+		}
+		m_nRefinements++;
+
+		// the residual, in REAL
+		mResidual = mB - ublas::prod(m_mA, mX);
+		REAL normX = 0.0, normResidual = 0.0;
+		for (int nRow = 0; nRow < n; nRow++)
+		{
+			for (int nCol = 0; nCol < nCols; nCol++)
+			{
+				normX = __max(normX, fabs(mX(nRow, nCol)) / m_arrScale[nRow]);
+				normResidual = __max(normResidual, fabs(mResidual(nRow, nCol)) * m_arrScale[nRow]);
+			}
+		}
+		m_residual = normResidual / (m_normScaled * normX + normB);
+
+		const REAL lastCorrection = correction;
+		correction = normCorrection / normX;
+		if (correction <= MIXED_LU_TOLERANCE
+			|| (m_nRefinements > 1 && correction > 0.5 * lastCorrection))
+		{
+			break;
+		}
+	}
+
+	mB = mX;
+	return m_residual <= MIXED_LU_MAX_BACKWARD_ERROR;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CMixedPrecisionLU::SolveFactors
+//
+// applies the row swaps, then forward and back substitution along the
+//		rows of the factors
+//////////////////////////////////////////////////////////////////////
+inline void CMixedPrecisionLU::SolveFactors(float *pB) const
+{
+	const int n = m_n;
+	for (int nStep = 0; nStep < n; nStep++)
+	{
+		std::swap(pB[nStep], pB[m_arrPivot[nStep]]);
+	}
+
+	// L has a unit diagonal
+	for (int nRow = 1; nRow < n; nRow++)
+	{
+		const float *pL = &m_arrLU[(size_t) nRow * n];
+		float sum = pB[nRow];
+		for (int nAt = 0; nAt < nRow; nAt++)
+		{
+			sum -= pL[nAt] * pB[nAt];
+		}
+		pB[nRow] = sum;
+	}
+
+	for (int nRow = n - 1; nRow >= 0; nRow--)
+	{
+		const float *pU = &m_arrLU[(size_t) nRow * n];
+		float sum = pB[nRow];
+		for (int nAt = nRow + 1; nAt < n; nAt++)
+		{
+			sum -= pU[nAt] * pB[nAt];
+		}
+		pB[nRow] = sum / pU[nRow];
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CMixedPrecisionLU::SolveFactorsTranspose
+//
+// solves U' then L' by columns of the factors, which are their rows,
+//		then undoes the row swaps in reverse
+//////////////////////////////////////////////////////////////////////
+inline void CMixedPrecisionLU::SolveFactorsTranspose(float *pB) const
+{
+	const int n = m_n;
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		const float *pU = &m_arrLU[(size_t) nRow * n];
+		pB[nRow] /= pU[nRow];
+		const float b = pB[nRow];
+		for (int nAt = nRow + 1; nAt < n; nAt++)
+		{
+			pB[nAt] -= pU[nAt] * b;
+		}
+	}
+
+	for (int nRow = n - 1; nRow >= 1; nRow--)
+	{
+		const float *pL = &m_arrLU[(size_t) nRow * n];
+		const float b = pB[nRow];
+		for (int nAt = 0; nAt < nRow; nAt++)
+		{
+			pB[nAt] -= pL[nAt] * b;
+		}
+	}
+
+	for (int nStep = n - 1; nStep >= 0; nStep--)
+	{
+		std::swap(pB[nStep], pB[m_arrPivot[nStep]]);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CMixedPrecisionLU::EstimateInverseNorm
+//
+// Hager's estimate: the 1-norm of the inverse is the largest of its
+//		column sums, which is found by an ascent over the unit 1-norm
+//		vectors, each step one solve with the matrix and one with its
+//		transpose.  it is nearly always within a factor of 3, in at
+//		most a few steps
+//////////////////////////////////////////////////////////////////////
+inline REAL CMixedPrecisionLU::EstimateInverseNorm() const
+{
+	const int n = m_n;
+	std::vector<float> arrX(n, 1.0f / (float) n), arrY(n), arrZ(n);
+	REAL estimate = 0.0;
+	for (int nStep = 0; nStep < 5; nStep++)
+	{
+		arrY = arrX;
+		SolveFactors(&arrY[0]);
+		estimate = 0.0;
+		for (int nAt = 0; nAt < n; nAt++)
+		{
+			estimate += fabs(arrY[nAt]);
+			arrZ[nAt] = (arrY[nAt] >= 0.0f) ? 1.0f : -1.0f;
+		}
+
+		// the gradient; at a maximum no unit vector ascends further
+		SolveFactorsTranspose(&arrZ[0]);
+		int nMax = 0;
+		REAL ztx = 0.0;
+		for (int nAt = 0; nAt < n; nAt++)
+		{
+			ztx += arrZ[nAt] * arrX[nAt];
+			if (fabs(arrZ[nAt]) > fabs(arrZ[nMax]))
+			{
+				nMax = nAt;
+			}
+		}
+		if (fabs(arrZ[nMax]) <= ztx)
+		{
+			break;
+		}
+		std::fill(arrX.begin(), arrX.end(), 0.0f);
+		arrX[nMax] = 1.0f;
+	}
+
+	return estimate;
+}
@@ -0,0 +1,223 @@
+//////////////////////////////////////////////////////////////////////
+// PointGrid.h: interface for the CPointGrid class.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+// math utilities
+#include "MathUtil.h"
+
+// most cells per point; sparse points get larger cells instead
+const int POINT_GRID_CELLS_PER_POINT = 4;
+
+//////////////////////////////////////////////////////////////////////
+// class CPointGrid
+//
+// a uniform grid of square cells over a set of points, to find the
+//		points near a position without looking at all of them.  the
+//		point indices are sorted by cell, with the start of each cell
+//		in an offset array, so the grid is two flat arrays
+//////////////////////////////////////////////////////////////////////
+class CPointGrid
+{
+public:
+	// construction
+	CPointGrid();
+
+	// sorts the points into cells of at least cellSize on a side
+	void SetPoints(int nPoints, const REAL *pX, const REAL *pY, REAL cellSize);
+
+	// removes all points
+	void Clear();
+
+	// number of points
+	int GetPointCount() const { return (int) m_arrX.size(); }
+
+	// calls func(nIndex) for each point in a cell that overlaps the box
+	//		[x0, x1] x [y0, y1], which includes every point in the box
+	template<class FUNC>
+	void ForEachInBox(REAL x0, REAL y0, REAL x1, REAL y1, FUNC func) const;
+
+	// calls func(nIndex, r2) for each point closer than radius to (x, y)
+	template<class FUNC>
+	void ForEachNear(REAL x, REAL y, REAL radius, FUNC func) const;
+
+private:
+	// the cell holding a coordinate, clamped to the grid
+	int CellX(REAL x) const;
+	int CellY(REAL y) const;
+
+	// the points
+	std::vector<REAL> m_arrX;
+	std::vector<REAL> m_arrY;
+
+	// the grid's corner, cell size and cell counts
+	REAL m_minX;
+	REAL m_minY;
+	REAL m_cellSize;
+	int m_nCellsX;
+	int m_nCellsY;
+
+	// the point indices sorted by cell, and where each cell starts
+	std::vector<int> m_arrCellStart;
+	std::vector<int> m_arrSorted;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CPointGrid::CPointGrid
+//
+// constructs an empty grid
+//////////////////////////////////////////////////////////////////////
+inline CPointGrid::CPointGrid()
+{
+	Clear();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CPointGrid::SetPoints
+//
+// sizes the grid to the bounding box of the points, and sorts them
+//		into their cells with a counting sort
+//////////////////////////////////////////////////////////////////////
+inline void CPointGrid::SetPoints(int nPoints, const REAL *pX, const REAL *pY, REAL cellSize)
+{
+	Clear();
+	if (nPoints == 0)
+	{
+		return;
+	}
+
+	m_arrX.assign(pX, pX + nPoints);
+	m_arrY.assign(pY, pY + nPoints);
+	m_minX = *std::min_element(pX, pX + nPoints);
+	m_minY = *std::min_element(pY, pY + nPoints);
+	const REAL width = *std::max_element(pX, pX + nPoints) - m_minX;
+	const REAL height = *std::max_element(pY, pY + nPoints) - m_minY;
+
+	// not so many cells that most are empty
+	const REAL minCellSize = sqrt(width * height / (POINT_GRID_CELLS_PER_POINT * nPoints));
+	m_cellSize = (cellSize > minCellSize) ? cellSize : minCellSize;
+	if (m_cellSize <= 0.0)
+	{
+		m_cellSize = 1.0;
+	}
+	m_nCellsX = (int) (width / m_cellSize) + 1;
+	m_nCellsY = (int) (height / m_cellSize) + 1;
+
+	m_arrCellStart.assign(m_nCellsX * m_nCellsY + 1, 0);
+	std::vector<int> arrCell(nPoints);
+	for (int nAt = 0; nAt < nPoints; nAt++)
+	{
+		arrCell[nAt] = CellY(pY[nAt]) * m_nCellsX + CellX(pX[nAt]);
+		m_arrCellStart[arrCell[nAt] + 1]++;
+	}
+	for (int nAtCell = 0; nAtCell < m_nCellsX * m_nCellsY; nAtCell++)
+	{
+		m_arrCellStart[nAtCell + 1] += m_arrCellStart[nAtCell];
+	}
+	m_arrSorted.resize(nPoints);
+	std::vector<int> arrFill(m_arrCellStart.begin(), m_arrCellStart.end() - 1);
+	for (int nAt = 0; nAt < nPoints; nAt++)
+	{
+		m_arrSorted[arrFill[arrCell[nAt]]++] = nAt;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CPointGrid::Clear
+//
+// removes all points, leaving a grid with no cells
+//////////////////////////////////////////////////////////////////////
+inline void CPointGrid::Clear()
+{
+	m_arrX.clear();
+	m_arrY.clear();
+	m_minX = 0.0;
+	m_minY = 0.0;
+	m_cellSize = 1.0;
+	m_nCellsX = 0;
+	m_nCellsY = 0;
+	m_arrCellStart.assign(1, 0);
+	m_arrSorted.clear();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CPointGrid::CellX
+//
+// the column of cells holding x, clamped to the grid
+//////////////////////////////////////////////////////////////////////
+inline int CPointGrid::CellX(REAL x) const
+{
+	const REAL cell = floor((x - m_minX) / m_cellSize);
+	return (cell < 0.0) ? 0 : (cell >= m_nCellsX) ? m_nCellsX - 1 : (int) cell;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CPointGrid::CellY
+//
+// the row of cells holding y, clamped to the grid
+//////////////////////////////////////////////////////////////////////
+inline int CPointGrid::CellY(REAL y) const
+{
+	const REAL cell = floor((y - m_minY) / m_cellSize);
+	return (cell < 0.0) ? 0 : (cell >= m_nCellsY) ? m_nCellsY - 1 : (int) cell;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CPointGrid::ForEachInBox
+//
+// visits the cells overlapping the box, row by row.  a box entirely
+//		off the grid visits nothing
+//////////////////////////////////////////////////////////////////////
+template<class FUNC>
+inline void CPointGrid::ForEachInBox(REAL x0, REAL y0, REAL x1, REAL y1, FUNC func) const
+{
+	if (m_arrX.empty()
+		|| x1 < m_minX || x0 > m_minX + m_nCellsX * m_cellSize
+		|| y1 < m_minY || y0 > m_minY + m_nCellsY * m_cellSize)
+	{
+		return;
+	}
+
+	const int nCellX0 = CellX(x0);
+	const int nCellX1 = CellX(x1);
+	const int nCellY1 = CellY(y1);
+	for (int nCellY = CellY(y0); nCellY <= nCellY1; nCellY++)
+	{
+		// the cells of a row are contiguous, so are their points
+		const int nStart = m_arrCellStart[nCellY * m_nCellsX + nCellX0];
+		const int nEnd = m_arrCellStart[nCellY * m_nCellsX + nCellX1 + 1];
+		for (int nAtSorted = nStart; nAtSorted < nEnd; nAtSorted++)
+		{
+			func(m_arrSorted[nAtSorted]);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CPointGrid::ForEachNear
+//
+// visits the points in the box around the circle, keeping those
+//		inside it
+//////////////////////////////////////////////////////////////////////
+template<class FUNC>
+inline void CPointGrid::ForEachNear(REAL x, REAL y, REAL radius, FUNC func) const
+{
+	const REAL radius2 = radius * radius;
+	ForEachInBox(x - radius, y - radius, x + radius, y + radius,
+		[&](int nIndex) {
+			const REAL dx = m_arrX[nIndex] - x;
+			const REAL dy = m_arrY[nIndex] - y;
+			const REAL r2 = dx * dx + dy * dy;
+			if (r2 < radius2)
+			{
+				func(nIndex, r2);
+			}
+		});
+}
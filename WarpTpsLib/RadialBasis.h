@@ -0,0 +1,607 @@
+//////////////////////////////////////////////////////////////////////
+// RadialBasis.h: interface for the CRadialBasis class.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// math utilities
+#include "MathUtil.h"
+
+//////////////////////////////////////////////////////////////////////
+// FastLog
+//
+// natural log of a positive, finite float, written without calls or
+//		branches so that a loop over it vectorizes.  x is split into
+//		m * 2^e with m in [sqrt(1/2), sqrt(2)), and log(m) comes from
+//		the Cephes minimax polynomial in m - 1, with ln 2 split in two
+//		for the e * ln 2 term.  the result is within 1 ulp of log(x)
+//////////////////////////////////////////////////////////////////////
+inline float FastLog(float x)
+{
+	// offset the bits so that the exponent field rounds m into 
+	//		[sqrt(1/2), sqrt(2)), then put m's bits back under a zero 
+	//		exponent, all in integers
+	std::uint32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	bits += 0x3f800000 - 0x3f3504f3;
+	const int e = (int) (bits >> 23) - 127;
+	bits = (bits & 0x007fffff) + 0x3f3504f3;
+	float m;
+	memcpy(&m, &bits, sizeof(m));
+	const float f = m - 1.0f;
+
+	const float z = f * f;
+	float y = 7.0376836292E-2f;
+	y = y * f - 1.1514610310E-1f;
+	y = y * f + 1.1676998740E-1f;
+	y = y * f - 1.2420140846E-1f;
+	y = y * f + 1.4249322787E-1f;
+	y = y * f - 1.6668057665E-1f;
+	y = y * f + 2.0000714765E-1f;
+	y = y * f - 2.4999993993E-1f;
+	y = y * f + 3.3333331174E-1f;
+	y = y * f * z;
+
+	const float fe = (float) e;
+	y += -2.12194440e-4f * fe;
+	y += -0.5f * z;
+	return f + y + 0.693359375f * fe;
+}
+
+//////////////////////////////////////////////////////////////////////
+// BlockLog
+//
+// the log used by the kernels' block forms: the library's log in REAL,
+//		so that they match the scalar forms, and FastLog in float
+//////////////////////////////////////////////////////////////////////
+inline double BlockLog(double x)
+{
+	return log(x);
+}
+
+inline float BlockLog(float x)
+{
+	return FastLog(x);
+}
+
+//////////////////////////////////////////////////////////////////////
+// radial basis kernels
+//
+// each kernel evaluates its basis from the squared distance r2.  the
+//		polyharmonic kernels k * r^r_exp * log(r) return 0 at r == 0.
+//		they are small value types, so a loop templated on one inlines
+//		the kernel.  each also has a block form, Eval, over an array of
+//		squared distances, written without branches (any zero at r == 0
+//		or past the support is a select) so that the loop vectorizes.
+//		the block form is templated on the scalar type: for REAL it
+//		gives the same values as the scalar form, and for float it 
+//		runs at twice the vector width, with FastLog in place of log
+//////////////////////////////////////////////////////////////////////
+
+// r_exp == 2: k * r^2 * log(r) == 0.5 * k * r^2 * log(r^2)
+struct CThinPlateKernel
+{
+	REAL m_halfK;
+
+	REAL operator()(REAL r2) const
+	{
+		return (r2 > 0.0) ? (m_halfK * r2 * log(r2)) : 0.0;
+	}
+
+	template<class TYPE>
+	void Eval(int nCount, const TYPE *pR2, TYPE *pD) const
+	{
+		const TYPE halfK = (TYPE) m_halfK;
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			const TYPE r2 = pR2[nAt];
+			const TYPE d = halfK * r2 * BlockLog(r2);
+			pD[nAt] = (r2 > (TYPE) 0.0) ? d : (TYPE) 0.0;
+		}
+	}
+};
+
+// even r_exp == 2 * m_nPower: (r^2)^m_nPower * 0.5 * k * log(r^2)
+struct CEvenPowerKernel
+{
+	REAL m_halfK;
+	int m_nPower;
+
+	REAL operator()(REAL r2) const
+	{
+		REAL d = m_halfK * log(r2);
+		for (int nAt = 0; nAt < m_nPower; nAt++)
+		{
+			d *= r2;
+		}
+		return (r2 > 0.0) ? d : 0.0;
+	}
+
+	template<class TYPE>
+	void Eval(int nCount, const TYPE *pR2, TYPE *pD) const
+	{
+		const TYPE halfK = (TYPE) m_halfK;
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			pD[nAt] = halfK * BlockLog(pR2[nAt]);
+		}
+		for (int nPower = 0; nPower < m_nPower; nPower++)
+		{
+			for (int nAt = 0; nAt < nCount; nAt++)
+			{
+				pD[nAt] *= pR2[nAt];
+			}
+		}
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			pD[nAt] = (pR2[nAt] > (TYPE) 0.0) ? pD[nAt] : (TYPE) 0.0;
+		}
+	}
+};
+
+// odd r_exp == 2 * m_nPower + 1: (r^2)^m_nPower * k * r * log(r)
+struct COddPowerKernel
+{
+	REAL m_k;
+	int m_nPower;
+
+	REAL operator()(REAL r2) const
+	{
+		const REAL r = sqrt(r2);
+		REAL d = m_k * r * log(r);
+		for (int nAt = 0; nAt < m_nPower; nAt++)
+		{
+			d *= r2;
+		}
+		return (r2 > 0.0) ? d : 0.0;
+	}
+
+	template<class TYPE>
+	void Eval(int nCount, const TYPE *pR2, TYPE *pD) const
+	{
+		const TYPE k = (TYPE) m_k;
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			const TYPE r = sqrt(pR2[nAt]);
+			pD[nAt] = k * r * BlockLog(r);
+		}
+		for (int nPower = 0; nPower < m_nPower; nPower++)
+		{
+			for (int nAt = 0; nAt < nCount; nAt++)
+			{
+				pD[nAt] *= pR2[nAt];
+			}
+		}
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			pD[nAt] = (pR2[nAt] > (TYPE) 0.0) ? pD[nAt] : (TYPE) 0.0;
+		}
+	}
+};
+
+// any other r_exp: k * pow(r, r_exp) * log(r)
+struct CGeneralPowerKernel
+{
+	REAL m_k;
+	REAL m_r_exp;
+
+	REAL operator()(REAL r2) const
+	{
+		const REAL r = sqrt(r2);
+		return (r > 0.0) ? (m_k * pow(r, m_r_exp) * log(r)) : 0.0;
+	}
+
+	template<class TYPE>
+	void Eval(int nCount, const TYPE *pR2, TYPE *pD) const
+	{
+		const TYPE k = (TYPE) m_k;
+		const TYPE r_exp = (TYPE) m_r_exp;
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			const TYPE r = sqrt(pR2[nAt]);
+			const TYPE d = k * pow(r, r_exp) * log(r);
+			pD[nAt] = (r > (TYPE) 0.0) ? d : (TYPE) 0.0;
+		}
+	}
+};
+
+// Wendland C2: k * (1 - s)^4 * (4 s + 1), with s = r / radius, and 0
+//		beyond the radius
+struct CWendlandC2Kernel
+{
+	REAL m_k;
+	REAL m_invRadius2;
+
+	REAL operator()(REAL r2) const
+	{
+		const REAL s2 = r2 * m_invRadius2;
+		if (s2 >= 1.0)
+		{
+			return 0.0;
+		}
+		const REAL s = sqrt(s2);
+		const REAL t = 1.0 - s;
+		const REAL t2 = t * t;
+		return m_k * t2 * t2 * (4.0 * s + 1.0);
+	}
+
+	// past the radius, 1 - s is clamped to 0 rather than returning early
+	template<class TYPE>
+	void Eval(int nCount, const TYPE *pR2, TYPE *pD) const
+	{
+		const TYPE k = (TYPE) m_k;
+		const TYPE invRadius2 = (TYPE) m_invRadius2;
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			const TYPE s = sqrt(pR2[nAt] * invRadius2);
+			const TYPE t = (s < (TYPE) 1.0) ? (TYPE) 1.0 - s : (TYPE) 0.0;
+			const TYPE t2 = t * t;
+			pD[nAt] = k * t2 * t2 * ((TYPE) 4.0 * s + (TYPE) 1.0);
+		}
+	}
+};
+
+// Wendland C4: k * (1 - s)^6 * (35 s^2 + 18 s + 3) / 3, with s = 
+//		r / radius, and 0 beyond the radius
+struct CWendlandC4Kernel
+{
+	REAL m_k;
+	REAL m_invRadius2;
+
+	REAL operator()(REAL r2) const
+	{
+		const REAL s2 = r2 * m_invRadius2;
+		if (s2 >= 1.0)
+		{
+			return 0.0;
+		}
+		const REAL s = sqrt(s2);
+		const REAL t = 1.0 - s;
+		const REAL t2 = t * t;
+		return m_k * t2 * t2 * t2 * (35.0 * s2 + 18.0 * s + 3.0) * (1.0 / 3.0);
+	}
+
+	template<class TYPE>
+	void Eval(int nCount, const TYPE *pR2, TYPE *pD) const
+	{
+		const TYPE k = (TYPE) m_k;
+		const TYPE third = (TYPE) (1.0 / 3.0);
+		const TYPE invRadius2 = (TYPE) m_invRadius2;
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			const TYPE s2 = pR2[nAt] * invRadius2;
+			const TYPE s = sqrt(s2);
+			const TYPE t = (s < (TYPE) 1.0) ? (TYPE) 1.0 - s : (TYPE) 0.0;
+			const TYPE t2 = t * t;
+			pD[nAt] = k * t2 * t2 * t2 * ((TYPE) 35.0 * s2 + (TYPE) 18.0 * s + (TYPE) 3.0) * third;
+		}
+	}
+};
+
+// Gaussian: k * exp(-r^2 / c^2)
+struct CGaussianKernel
+{
+	REAL m_k;
+	REAL m_invScale2;
+
+	REAL operator()(REAL r2) const
+	{
+		return m_k * exp(-r2 * m_invScale2);
+	}
+
+	template<class TYPE>
+	void Eval(int nCount, const TYPE *pR2, TYPE *pD) const
+	{
+		const TYPE k = (TYPE) m_k;
+		const TYPE invScale2 = (TYPE) m_invScale2;
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			pD[nAt] = k * exp(-pR2[nAt] * invScale2);
+		}
+	}
+};
+
+// multiquadric: k * sqrt(r^2 + c^2)
+struct CMultiquadricKernel
+{
+	REAL m_k;
+	REAL m_scale2;
+
+	REAL operator()(REAL r2) const
+	{
+		return m_k * sqrt(r2 + m_scale2);
+	}
+
+	template<class TYPE>
+	void Eval(int nCount, const TYPE *pR2, TYPE *pD) const
+	{
+		const TYPE k = (TYPE) m_k;
+		const TYPE scale2 = (TYPE) m_scale2;
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			pD[nAt] = k * sqrt(pR2[nAt] + scale2);
+		}
+	}
+};
+
+// inverse multiquadric: k / sqrt(r^2 + c^2)
+struct CInverseMultiquadricKernel
+{
+	REAL m_k;
+	REAL m_scale2;
+
+	REAL operator()(REAL r2) const
+	{
+		return m_k / sqrt(r2 + m_scale2);
+	}
+
+	template<class TYPE>
+	void Eval(int nCount, const TYPE *pR2, TYPE *pD) const
+	{
+		const TYPE k = (TYPE) m_k;
+		const TYPE scale2 = (TYPE) m_scale2;
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			pD[nAt] = k / sqrt(pR2[nAt] + scale2);
+		}
+	}
+};
+
+//////////////////////////////////////////////////////////////////////
+// class CRadialBasis
+//
+// the radial basis: by default the polyharmonic k * r^r_exp * log(r),
+//		or one of the kernels with a length scale c.  the kernel is 
+//		selected once, when it is set, so that loops can be dispatched
+//		to the specialized kernel instead of paying for sqrt and pow,
+//		or a switch on the kernel, on every landmark-pixel pair
+//////////////////////////////////////////////////////////////////////
+class CRadialBasis
+{
+public:
+	// the specialized kernels
+	enum KernelType
+	{
+		THIN_PLATE,				// r_exp == 2
+		EVEN_POWER,				// even integer r_exp
+		ODD_POWER,				// odd integer r_exp
+		GENERAL_POWER,			// anything else
+		WENDLAND_C2,			// compact support, twice differentiable
+		WENDLAND_C4,			// compact support, four times differentiable
+		GAUSSIAN,				// exp(-r^2 / c^2)
+		MULTIQUADRIC,			// sqrt(r^2 + c^2)
+		INVERSE_MULTIQUADRIC	// 1 / sqrt(r^2 + c^2)
+	};
+
+	// construction
+	CRadialBasis(REAL k = 1.0, REAL r_exp = 2.0);
+
+	// the basis parameters
+	REAL GetK() const { return m_k; }
+	void SetK(REAL k);
+
+	REAL GetRExponent() const { return m_r_exp; }
+	void SetRExponent(REAL r_exp);
+
+	// selects the kernel and its length scale.  any of the polyharmonic
+	//		types selects the polyharmonic kernel, specialized for the
+	//		exponent.  for the Wendland kernels the scale is the support
+	//		radius.  a scale of 0 also selects the polyharmonic kernel
+	void SetKernel(KernelType type, REAL scale);
+	REAL GetScale() const { return m_scale; }
+
+	// sets a support radius (0, the default, for the global r^r_exp 
+	//		* log(r)), and the continuity (2 or 4) of the Wendland 
+	//		function used within it
+	void SetSupportRadius(REAL radius, int nContinuity = 2);
+	REAL GetSupportRadius() const { return IsCompact() ? m_scale : 0.0; }
+	int GetContinuity() const { return (m_type == WENDLAND_C4) ? 4 : 2; }
+
+	// TRUE if the basis is zero beyond the support radius
+	BOOL IsCompact() const { return m_type == WENDLAND_C2 || m_type == WENDLAND_C4; }
+
+	// TRUE if the kernel is r^r_exp * log(r)
+	BOOL IsPolyharmonic() const { return m_type <= GENERAL_POWER; }
+
+	// the kernel selected
+	KernelType GetKernelType() const { return m_type; }
+
+	// evaluates the basis from the squared distance
+	REAL operator()(REAL r2) const;
+
+	// TRUE if both evaluate the same basis
+	bool operator==(const CRadialBasis& other) const;
+	bool operator!=(const CRadialBasis& other) const { return !(*this == other); }
+
+	// calls func with the specialized kernel, so that a generic func
+	//		is instantiated (and inlined) once per kernel type
+	template<class FUNC>
+	void Dispatch(FUNC func) const;
+
+private:
+	// classifies the exponent
+	void SelectKernel();
+
+	// the parameters
+	REAL m_k;
+	REAL m_r_exp;
+	REAL m_scale;
+
+	// the kernel family, as set; any polyharmonic type for r^r_exp
+	KernelType m_family;
+
+	// the selected kernel, and its integer power
+	KernelType m_type;
+	int m_nPower;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CRadialBasis::CRadialBasis
+//
+// constructs the basis for the given parameters
+//////////////////////////////////////////////////////////////////////
+inline CRadialBasis::CRadialBasis(REAL k, REAL r_exp)
+	: m_k(k)
+	, m_r_exp(r_exp)
+	, m_scale(0.0)
+	, m_family(THIN_PLATE)
+{
+	SelectKernel();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CRadialBasis::SetK
+//
+// sets the scale factor
+//////////////////////////////////////////////////////////////////////
+inline void CRadialBasis::SetK(REAL k)
+{
+	m_k = k;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CRadialBasis::SetRExponent
+//
+// sets the exponent and selects the matching kernel
+//////////////////////////////////////////////////////////////////////
+inline void CRadialBasis::SetRExponent(REAL r_exp)
+{
+	m_r_exp = r_exp;
+	SelectKernel();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CRadialBasis::SetKernel
+//
+// sets the family and scale, and selects the kernel
+//////////////////////////////////////////////////////////////////////
+inline void CRadialBasis::SetKernel(KernelType type, REAL scale)
+{
+	m_scale = (scale > 0.0) ? scale : 0.0;
+	m_family = (m_scale > 0.0) ? type : THIN_PLATE;
+	SelectKernel();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CRadialBasis::SetSupportRadius
+//
+// selects the Wendland kernel of the continuity, or with no radius,
+//		the polyharmonic one
+//////////////////////////////////////////////////////////////////////
+inline void CRadialBasis::SetSupportRadius(REAL radius, int nContinuity)
+{
+	SetKernel((nContinuity >= 4) ? WENDLAND_C4 : WENDLAND_C2, radius);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CRadialBasis::SelectKernel
+//
+// a kernel with a scale is used as is.  otherwise, small non-negative
+//		integer exponents use repeated multiplication; the rest fall
+//		back to pow
+//////////////////////////////////////////////////////////////////////
+inline void CRadialBasis::SelectKernel()
+{
+	const int MAX_INTEGER_EXPONENT = 16;
+
+	m_type = GENERAL_POWER;
+	m_nPower = 0;
+	if (m_family > GENERAL_POWER)
+	{
+		m_type = m_family;
+		return;
+	}
+	if (m_r_exp >= 0.0 && m_r_exp <= MAX_INTEGER_EXPONENT
+		&& m_r_exp == floor(m_r_exp))
+	{
+		int nExp = (int) m_r_exp;
+		m_nPower = nExp / 2;
+		if (nExp == 2)
+		{
+			m_type = THIN_PLATE;
+		}
+		else
+		{
+			m_type = (nExp % 2 == 0) ? EVEN_POWER : ODD_POWER;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CRadialBasis::operator()
+//
+// evaluates the basis from the squared distance
+//////////////////////////////////////////////////////////////////////
+inline REAL CRadialBasis::operator()(REAL r2) const
+{
+	REAL d = 0.0;
+	Dispatch([&](const auto& kernel) { d = kernel(r2); });
+	return d;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CRadialBasis::operator==
+//
+// compares the selected kernel and the parameters it uses
+//////////////////////////////////////////////////////////////////////
+inline bool CRadialBasis::operator==(const CRadialBasis& other) const
+{
+	if (m_type != other.m_type || m_k != other.m_k)
+	{
+		return false;
+	}
+	return IsPolyharmonic() ? (m_r_exp == other.m_r_exp) : (m_scale == other.m_scale);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CRadialBasis::Dispatch
+//
+// calls func with the kernel selected
+//////////////////////////////////////////////////////////////////////
+template<class FUNC>
+inline void CRadialBasis::Dispatch(FUNC func) const
+{
+	switch (m_type)
+	{
+	case THIN_PLATE:
+		func(CThinPlateKernel{ 0.5 * m_k });
+		break;
+
+	case EVEN_POWER:
+		func(CEvenPowerKernel{ 0.5 * m_k, m_nPower });
+		break;
+
+	case ODD_POWER:
+		func(COddPowerKernel{ m_k, m_nPower });
+		break;
+
+	case WENDLAND_C2:
+		func(CWendlandC2Kernel{ m_k, 1.0 / (m_scale * m_scale) });
+		break;
+
+	case WENDLAND_C4:
+		func(CWendlandC4Kernel{ m_k, 1.0 / (m_scale * m_scale) });
+		break;
+
+	case GAUSSIAN:
+		func(CGaussianKernel{ m_k, 1.0 / (m_scale * m_scale) });
+		break;
+
+	case MULTIQUADRIC:
+		func(CMultiquadricKernel{ m_k, m_scale * m_scale });
+		break;
+
+	case INVERSE_MULTIQUADRIC:
+		func(CInverseMultiquadricKernel{ m_k, m_scale * m_scale });
+		break;
+
+	default:
+		func(CGeneralPowerKernel{ m_k, m_r_exp });
+		break;
+	}
+}
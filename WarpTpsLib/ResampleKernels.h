@@ -0,0 +1,179 @@
+//////////////////////////////////////////////////////////////////////
+// ResampleKernels.h: nearest-neighbor row kernels for the resamplers
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string.h>
+#include <vector>
+
+// math utilities
+#include "MathUtil.h"
+
+// presampled fields
+#include "DisplacementField.h"
+
+//////////////////////////////////////////////////////////////////////
+// pixel copies
+//
+// CPixelCopy<N> copies or clears one pixel of N bytes, with the size
+//		known at compile time.  N == 0 is the general case, with the
+//		size given at run time
+//////////////////////////////////////////////////////////////////////
+template<int BYTES_PER_PIXEL>
+struct CPixelCopy
+{
+	static void Copy(LPBYTE pDst, const BYTE *pSrc, UINT /* bytesPerPixel */)
+	{
+		memcpy(pDst, pSrc, BYTES_PER_PIXEL);
+	}
+
+	static void Clear(LPBYTE pDst, UINT /* bytesPerPixel */)
+	{
+		memset(pDst, 0, BYTES_PER_PIXEL);
+	}
+};
+
+template<>
+struct CPixelCopy<0>
+{
+	static void Copy(LPBYTE pDst, const BYTE *pSrc, UINT bytesPerPixel)
+	{
+		memcpy(pDst, pSrc, bytesPerPixel);
+	}
+
+	static void Clear(LPBYTE pDst, UINT bytesPerPixel)
+	{
+		memset(pDst, 0, bytesPerPixel);
+	}
+};
+
+//////////////////////////////////////////////////////////////////////
+// ResampleRowNearest
+//
+// fills destination row dstAtY with the source pixels nearest to
+//		(pSrcX[x], pSrcY[x]), or zero where that is outside the source.
+//		rows are stored bottom-up, as in a DIB.  the coordinates are
+//		range checked before they are rounded, so the rounding is an
+//		integer truncation rather than a floor
+//////////////////////////////////////////////////////////////////////
+template<int BYTES_PER_PIXEL>
+inline void ResampleRowNearest(LPBYTE pSrcPixels, LPBYTE pDstPixels,
+	UINT bytesPerPixel, UINT width, UINT height, UINT stride,
+	int dstAtY, const REAL *pSrcX, const REAL *pSrcY)
+{
+	const UINT pixelBytes = BYTES_PER_PIXEL ? BYTES_PER_PIXEL : bytesPerPixel;
+	LPBYTE pDst = &pDstPixels[(height - dstAtY - 1) * stride];
+	const REAL maxX = (REAL) width;
+	const REAL maxY = (REAL) height;
+	for (UINT dstAtX = 0; dstAtX < width; dstAtX++, pDst += pixelBytes)
+	{
+		// round to nearest: x + 0.5 in [0, width) rounds into the row
+		const REAL srcX = pSrcX[dstAtX] + 0.5;
+		const REAL srcY = pSrcY[dstAtX] + 0.5;
+		if (srcX >= 0.0 && srcX < maxX
+			&& srcY >= 0.0 && srcY < maxY)
+		{
+			const int nSrcX = (int) srcX;
+			const int nSrcY = height - (int) srcY - 1;
+			CPixelCopy<BYTES_PER_PIXEL>::Copy(pDst,
+				&pSrcPixels[nSrcY * stride + nSrcX * pixelBytes], bytesPerPixel);
+		}
+		else
+		{
+			CPixelCopy<BYTES_PER_PIXEL>::Clear(pDst, bytesPerPixel);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// ResampleRowNearest
+//
+// picks the kernel for the pixel size: 1 (grayscale), 3 (BGR) and 4
+//		(BGRA) bytes are specialized, others copy with a run time size
+//////////////////////////////////////////////////////////////////////
+inline void ResampleRowNearest(LPBYTE pSrcPixels, LPBYTE pDstPixels,
+	UINT bytesPerPixel, UINT width, UINT height, UINT stride,
+	int dstAtY, const REAL *pSrcX, const REAL *pSrcY)
+{
+	switch (bytesPerPixel)
+	{
+	case 1:
+		ResampleRowNearest<1>(pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride, dstAtY, pSrcX, pSrcY);
+		break;
+	case 3:
+		ResampleRowNearest<3>(pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride, dstAtY, pSrcX, pSrcY);
+		break;
+	case 4:
+		ResampleRowNearest<4>(pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride, dstAtY, pSrcX, pSrcY);
+		break;
+	default:
+		ResampleRowNearest<0>(pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride, dstAtY, pSrcX, pSrcY);
+		break;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// ResampleRowsWithField
+//
+// resamples destination rows [nStartY, nEndY) using a presampled
+//		field of the destination's size, stored as OFFSET_TYPE.  only
+//		writes pixels of those rows
+//////////////////////////////////////////////////////////////////////
+template<class OFFSET_TYPE>
+inline void ResampleRowsWithField(const CDisplacementField& field, 
+	LPBYTE pSrcPixels, LPBYTE pDstPixels,
+	UINT bytesPerPixel, UINT width, UINT height, UINT stride, float percent,
+	int nStartY, int nEndY)
+{
+	const OFFSET_TYPE *pDx;
+	const OFFSET_TYPE *pDy;
+	field.GetPlanes(pDx, pDy);
+
+	// scales the stored offsets to pixels, and by the percent
+	const double scale = ((double)percent) * field.GetScale();
+
+	// source positions for a row
+	std::vector<REAL> arrSrcX(width), arrSrcY(width);
+
+	for (int dstAtY = nStartY; dstAtY < nEndY; dstAtY++) {
+		const OFFSET_TYPE *pRowDx = &pDx[dstAtY * field.GetWidth()];
+		const OFFSET_TYPE *pRowDy = &pDy[dstAtY * field.GetWidth()];
+		for (UINT dstAtX = 0; dstAtX < width; dstAtX++) {
+			arrSrcX[dstAtX] = dstAtX + scale * pRowDx[dstAtX];
+			arrSrcY[dstAtX] = dstAtY + scale * pRowDy[dstAtX];
+		}
+
+		ResampleRowNearest(pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride,
+			dstAtY, arrSrcX.data(), arrSrcY.data());
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// ResampleRowsWithField
+//
+// picks the loop compiled for the field's storage
+//////////////////////////////////////////////////////////////////////
+inline void ResampleRowsWithField(const CDisplacementField& field, 
+	LPBYTE pSrcPixels, LPBYTE pDstPixels,
+	UINT bytesPerPixel, UINT width, UINT height, UINT stride, float percent,
+	int nStartY, int nEndY)
+{
+	switch (field.GetFormat())
+	{
+	case CDisplacementField::FORMAT_DOUBLE:
+		ResampleRowsWithField<REAL>(field, pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride, percent,
+			nStartY, nEndY);
+		break;
+	case CDisplacementField::FORMAT_FLOAT:
+		ResampleRowsWithField<float>(field, pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride, percent,
+			nStartY, nEndY);
+		break;
+	case CDisplacementField::FORMAT_FIXED16:
+		ResampleRowsWithField<short>(field, pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride, percent,
+			nStartY, nEndY);
+		break;
+	}
+}
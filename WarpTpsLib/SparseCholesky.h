@@ -0,0 +1,308 @@
+//////////////////////////////////////////////////////////////////////
+// SparseCholesky.h: interface for the CSparseCholesky class.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+// math utilities
+#include "MathUtil.h"
+
+//////////////////////////////////////////////////////////////////////
+// class CSparseCholesky
+//
+// factors a sparse symmetric positive definite matrix as L L'.  the
+//		rows are first put in reverse Cuthill-McKee order, which keeps
+//		the nonzeros of a matrix that only couples nearby points close
+//		to the diagonal.  L is then stored by its envelope, each row
+//		from its first nonzero to the diagonal, which holds all of the
+//		fill of the factorization
+//////////////////////////////////////////////////////////////////////
+class CSparseCholesky
+{
+public:
+	// construction
+	CSparseCholesky();
+
+	// factors the n x n matrix given by rows: the entries of row i are
+	//		arrValue[arrStart[i]..arrStart[i + 1]), in the columns at the
+	//		same places in arrIndex, with both triangles present.
+	//		returns FALSE if it is not positive definite
+	BOOL Factorize(int n, const std::vector<int>& arrStart,
+		const std::vector<int>& arrIndex, const std::vector<REAL>& arrValue);
+
+	// the size of the factored matrix, or 0 if there is none
+	int GetSize() const { return (int) m_arrOrder.size(); }
+
+	// the number of entries held for L
+	size_t GetFactorSize() const { return m_arrL.size(); }
+
+	// solves A x = b, overwriting b with x
+	void Solve(REAL *pB) const;
+
+	// removes the factors
+	void Clear();
+
+protected:
+	// finds the reverse Cuthill-McKee order of the graph of the matrix
+	void CalcOrder(int n, const std::vector<int>& arrStart, const std::vector<int>& arrIndex);
+
+	// the entry of L at row nRow, column nCol, for nCol in the envelope
+	REAL& L(int nRow, int nCol) { return m_arrL[m_arrRowStart[nRow] + nCol - m_arrRowFirst[nRow]]; }
+	REAL L(int nRow, int nCol) const { return m_arrL[m_arrRowStart[nRow] + nCol - m_arrRowFirst[nRow]]; }
+
+private:
+	// the original row of each factored row, and the reverse
+	std::vector<int> m_arrOrder;
+	std::vector<int> m_arrOrderOf;
+
+	// the first column of each row of L, and where the row starts in
+	//		m_arrL
+	std::vector<int> m_arrRowFirst;
+	std::vector<size_t> m_arrRowStart;
+
+	// the rows of L, from the first column through the diagonal
+	std::vector<REAL> m_arrL;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CSparseCholesky::CSparseCholesky
+//
+// constructs an empty factorization
+//////////////////////////////////////////////////////////////////////
+inline CSparseCholesky::CSparseCholesky()
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// CSparseCholesky::Clear
+//
+// removes the factors
+//////////////////////////////////////////////////////////////////////
+inline void CSparseCholesky::Clear()
+{
+	m_arrOrder.clear();
+	m_arrOrderOf.clear();
+	m_arrRowFirst.clear();
+	m_arrRowStart.clear();
+	m_arrL.clear();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CSparseCholesky::Factorize
+//
+// orders the rows, sizes the envelope from the ordered matrix, and
+//		factors it row by row.  each entry of L is a dot product of the
+//		overlap of two rows, so the work is the sum over rows of the
+//		square of the envelope width
+//////////////////////////////////////////////////////////////////////
+inline BOOL CSparseCholesky::Factorize(int n, const std::vector<int>& arrStart,
+	const std::vector<int>& arrIndex, const std::vector<REAL>& arrValue)
+{
+	Clear();
+	CalcOrder(n, arrStart, arrIndex);
+
+	// the envelope: each row starts at its first nonzero
+	m_arrRowFirst.resize(n);
+	m_arrRowStart.resize(n + 1);
+	m_arrRowStart[0] = 0;
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		int nFirst = nRow;
+		const int nOriginal = m_arrOrder[nRow];
+		for (int nAt = arrStart[nOriginal]; nAt < arrStart[nOriginal + 1]; nAt++)
+		{
+			nFirst = __min(nFirst, m_arrOrderOf[arrIndex[nAt]]);
+		}
+		m_arrRowFirst[nRow] = nFirst;
+		m_arrRowStart[nRow + 1] = m_arrRowStart[nRow] + (nRow - nFirst + 1);
+	}
+
+	// the lower triangle of the ordered matrix
+	m_arrL.assign(m_arrRowStart[n], 0.0);
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		const int nOriginal = m_arrOrder[nRow];
+		for (int nAt = arrStart[nOriginal]; nAt < arrStart[nOriginal + 1]; nAt++)
+		{
+			const int nCol = m_arrOrderOf[arrIndex[nAt]];
+			if (nCol <= nRow)
+			{
+				L(nRow, nCol) += arrValue[nAt];
+			}
+		}
+	}
+
+	// factor, a row at a time
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		const int nFirst = m_arrRowFirst[nRow];
+		REAL *pRow = &m_arrL[m_arrRowStart[nRow]] - nFirst;
+		for (int nCol = nFirst; nCol < nRow; nCol++)
+		{
+			const int nFirstBoth = __max(nFirst, m_arrRowFirst[nCol]);
+			const REAL *pColRow = &m_arrL[m_arrRowStart[nCol]] - m_arrRowFirst[nCol];
+			REAL sum = pRow[nCol];
+			for (int nAt = nFirstBoth; nAt < nCol; nAt++)
+			{
+				sum -= pRow[nAt] * pColRow[nAt];
+			}
+			pRow[nCol] = sum / pColRow[nCol];
+		}
+
+		REAL diag = pRow[nRow];
+		for (int nAt = nFirst; nAt < nRow; nAt++)
+		{
+			diag -= pRow[nAt] * pRow[nAt];
+		}
+		if (diag <= 0.0)
+		{
+			Clear();
+			return FALSE;
+		}
+		pRow[nRow] = sqrt(diag);
+	}
+
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CSparseCholesky::Solve
+//
+// solves L y = b and then L' x = y, both in the factored order
+//////////////////////////////////////////////////////////////////////
+inline void CSparseCholesky::Solve(REAL *pB) const
+{
+	const int n = GetSize();
+	std::vector<REAL> arrY(n);
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		arrY[nRow] = pB[m_arrOrder[nRow]];
+	}
+
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		REAL sum = arrY[nRow];
+		for (int nCol = m_arrRowFirst[nRow]; nCol < nRow; nCol++)
+		{
+			sum -= L(nRow, nCol) * arrY[nCol];
+		}
+		arrY[nRow] = sum / L(nRow, nRow);
+	}
+
+	// L' by columns of L', which are the rows of L
+	for (int nRow = n - 1; nRow >= 0; nRow--)
+	{
+		arrY[nRow] /= L(nRow, nRow);
+		const REAL y = arrY[nRow];
+		for (int nCol = m_arrRowFirst[nRow]; nCol < nRow; nCol++)
+		{
+			arrY[nCol] -= L(nRow, nCol) * y;
+		}
+	}
+
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		pB[m_arrOrder[nRow]] = arrY[nRow];
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CSparseCholesky::CalcOrder
+//
+// breadth first search from a low degree row far from the rest of its
+//		component, visiting the neighbors of each row by increasing
+//		degree, then reversed
+//////////////////////////////////////////////////////////////////////
+inline void CSparseCholesky::CalcOrder(int n, const std::vector<int>& arrStart,
+	const std::vector<int>& arrIndex)
+{
+	std::vector<int> arrDegree(n);
+	for (int nAt = 0; nAt < n; nAt++)
+	{
+		arrDegree[nAt] = arrStart[nAt + 1] - arrStart[nAt];
+	}
+
+	// breadth first search from nRoot, appending to arrLevel; returns the
+	//		lowest degree row of the last level
+	std::vector<int> arrLevel;
+	std::vector<int> arrMark(n, -1);
+	auto search = [&](int nRoot, int nMark, BOOL bSorted) {
+		const size_t nBegin = arrLevel.size();
+		arrLevel.push_back(nRoot);
+		arrMark[nRoot] = nMark;
+		size_t nLastLevel = nBegin;
+		for (size_t nAt = nBegin; nAt < arrLevel.size(); )
+		{
+			const size_t nLevelEnd = arrLevel.size();
+			nLastLevel = nAt;
+			for (; nAt < nLevelEnd; nAt++)
+			{
+				const int nRow = arrLevel[nAt];
+				const size_t nAdded = arrLevel.size();
+				for (int nEntry = arrStart[nRow]; nEntry < arrStart[nRow + 1]; nEntry++)
+				{
+					const int nNeighbor = arrIndex[nEntry];
+					if (arrMark[nNeighbor] != nMark)
+					{
+						arrMark[nNeighbor] = nMark;
+						arrLevel.push_back(nNeighbor);
+					}
+				}
+				if (bSorted)
+				{
+					std::sort(arrLevel.begin() + nAdded, arrLevel.end(),
+						[&](int nA, int nB) { return arrDegree[nA] < arrDegree[nB]; });
+				}
+			}
+		}
+		int nFarthest = arrLevel[nLastLevel];
+		for (size_t nAt = nLastLevel; nAt < arrLevel.size(); nAt++)
+		{
+			if (arrDegree[arrLevel[nAt]] < arrDegree[nFarthest])
+			{
+				nFarthest = arrLevel[nAt];
+			}
+		}
+		return nFarthest;
+	};
+
+	m_arrOrder.clear();
+	std::vector<BOOL> arrOrdered(n, FALSE);
+	int nMark = 0;
+	for (int nStart = 0; nStart < n; nStart++)
+	{
+		if (arrOrdered[nStart])
+		{
+			continue;
+		}
+
+		// two searches to find a row at the edge of the component
+		int nRoot = nStart;
+		for (int nPass = 0; nPass < 2; nPass++)
+		{
+			arrLevel.clear();
+			nRoot = search(nRoot, nMark++, FALSE);
+		}
+
+		arrLevel.clear();
+		search(nRoot, nMark++, TRUE);
+		for (int nRow : arrLevel)
+		{
+			arrOrdered[nRow] = TRUE;
+		}
+		m_arrOrder.insert(m_arrOrder.end(), arrLevel.begin(), arrLevel.end());
+	}
+	std::reverse(m_arrOrder.begin(), m_arrOrder.end());
+
+	m_arrOrderOf.resize(n);
+	for (int nRow = 0; nRow < n; nRow++)
+	{
+		m_arrOrderOf[m_arrOrder[nRow]] = nRow;
+	}
+}
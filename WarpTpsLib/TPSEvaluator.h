@@ -0,0 +1,732 @@
+//////////////////////////////////////////////////////////////////////
+// TPSEvaluator.h: interface for the CTPSEvaluator class.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <limits>
+
+// math utilities
+#include "MathUtil.h"
+
+// radial basis kernels
+#include "RadialBasis.h"
+
+// grid of the centers, for compactly supported kernels
+#include "PointGrid.h"
+
+//////////////////////////////////////////////////////////////////////
+// class CTPSEvaluator<TYPE>
+//
+// evaluates a TPS field from a packed copy of its centers and
+//		weights.  the centers and weights are held as separate
+//		contiguous arrays (structure-of-arrays), so that the row
+//		kernel is a straight loop over pixels that the compiler can
+//		vectorize.  with a compactly supported basis, the centers are
+//		also sorted into a grid, and each pixel or point only sums the 
+//		centers within the support radius.  all evaluation is const, 
+//		so one evaluator can be shared by several threads
+//
+// TYPE is the scalar the field is evaluated and returned in; the 
+//		weights are always solved for in REAL.  a float evaluator
+//		holds the centers relative to their centroid (see SetBasis), 
+//		so distances keep their precision, and runs at twice the 
+//		vector width.  the terms of the sum are as large as |w_i| * 
+//		max U(r), and each is rounded to TYPE a few times, which bounds
+//		the difference from the REAL offsets.  for a smooth warp of an
+//		image a few thousand pixels across that is about 1e-3 pixel;
+//		CalcErrorBound gives it for a box
+//////////////////////////////////////////////////////////////////////
+template<class TYPE = REAL>
+class CTPSEvaluator
+{
+public:
+	// construction
+	CTPSEvaluator();
+
+	// loads the centers and weights.  pWx/pWy hold the nCenters radial
+	//		weights followed by the three affine weights
+	void SetBasis(int nCenters, const REAL *pCenterX, const REAL *pCenterY,
+		const REAL *pWx, const REAL *pWy, const CRadialBasis& basis);
+
+	// removes all centers, so that the field evaluates to zero
+	void Clear();
+
+	// number of radial centers
+	int GetCenterCount() const;
+
+	// evaluates the offset at a single point
+	void EvalPoint(REAL x, REAL y, TYPE& dx, TYPE& dy) const;
+
+	// evaluates the offsets of nCount pixels along row y, starting at x0
+	void EvalRow(REAL y, REAL x0, int nCount, TYPE *pDx, TYPE *pDy) const;
+
+	// evaluates the offsets of nCount points given as separate x and y
+	//		arrays.  as in CTPSTransform::Eval, percent scales the radial
+	//		part of the offset only
+	void EvalPoints(int nCount, const TYPE *pX, const TYPE *pY,
+		TYPE *pDx, TYPE *pDy, REAL percent = 1.0) const;
+
+	// evaluates the offsets of nCount interleaved x,y points into
+	//		interleaved dx,dy offsets
+	void EvalPoints(int nCount, const TYPE *pXY, TYPE *pOffsetXY,
+		REAL percent = 1.0) const;
+
+	// bounds the difference between these offsets and ones summed in
+	//		REAL, over the box [x0, x1] x [y0, y1]
+	REAL CalcErrorBound(REAL x0, REAL y0, REAL x1, REAL y1) const;
+
+	// number of points evaluated together by EvalPoints; the block's
+	//		accumulators stay in L1 while the centers stream past
+	enum { POINT_BLOCK = 256 };
+
+	// number of pixels of a row whose basis values are evaluated
+	//		together by the kernel's block form; also the tile of
+	//		points that the centers are summed into
+	enum { KERNEL_BLOCK = 64 };
+
+	// number of centers summed over each tile of points before the next
+	//		centers are loaded, so that a block of centers and weights
+	//		stays in L1 while the tiles of a row or block stream past
+	enum { CENTER_BLOCK = 512 };
+
+	// number of centers the micro-kernel adds to a tile together, so
+	//		that each point's sums are loaded and stored once for them
+	enum { CENTER_UNROLL = 4 };
+
+private:
+	// evaluates one block of at most POINT_BLOCK points, relative to
+	//		the origin
+	void EvalPointBlock(int nCount, const TYPE *pX, const TYPE *pY,
+		TYPE *pDx, TYPE *pDy, TYPE percent) const;
+
+	// the loops, instantiated for each specialized kernel
+	template<class KERNEL>
+	void EvalRowT(const KERNEL& kernel, TYPE y, TYPE x0, int nCount,
+		TYPE *pDx, TYPE *pDy) const;
+
+	template<class KERNEL>
+	void EvalPointBlockT(const KERNEL& kernel, int nCount, const TYPE *pX, const TYPE *pY,
+		TYPE *pDx, TYPE *pDy, TYPE percent) const;
+
+	// adds the radial terms of every center to at most POINT_BLOCK 
+	//		points, a block of centers and a tile of points at a time.
+	//		calcR2(nCenter, nStart, nTile, pR2) gives the squared 
+	//		distances from a center to the points of a tile
+	template<class KERNEL, class CALC_R2>
+	void AddRadialT(const KERNEL& kernel, const CALC_R2& calcR2, int nCount,
+		TYPE *pDx, TYPE *pDy, TYPE percent) const;
+
+	// the micro-kernel: adds the terms of centers [nCenter, nCenterEnd)
+	//		to the tile of at most KERNEL_BLOCK points from nStart
+	template<class KERNEL, class CALC_R2>
+	void AddRadialTileT(const KERNEL& kernel, const CALC_R2& calcR2, int nCenter, int nCenterEnd, 
+		int nStart, int nCount, TYPE *pDx, TYPE *pDy, TYPE percent) const;
+
+	// the radial sums for a compactly supported kernel, over only the
+	//		centers near each pixel or point
+	template<class KERNEL>
+	void EvalRowCompactT(const KERNEL& kernel, TYPE y, TYPE x0, int nCount,
+		TYPE *pDx, TYPE *pDy) const;
+
+	template<class KERNEL>
+	void EvalPointBlockCompactT(const KERNEL& kernel, int nCount, const TYPE *pX, const TYPE *pY,
+		TYPE *pDx, TYPE *pDy, TYPE percent) const;
+
+
+	// the origin the centers are held relative to, the unit of 
+	//		distance, and the step of one pixel in it
+	REAL m_originX;
+	REAL m_originY;
+	REAL m_unit;
+	TYPE m_step;
+
+	// the radial centers
+	std::vector<TYPE> m_arrCenterX;
+	std::vector<TYPE> m_arrCenterY;
+
+	// the radial weights
+	std::vector<TYPE> m_arrWeightX;
+	std::vector<TYPE> m_arrWeightY;
+
+	// the affine weights, relative to the origin: constant, x and y
+	//		terms
+	TYPE m_affineX[3];
+	TYPE m_affineY[3];
+
+	// the radial basis
+	CRadialBasis m_basis;
+
+	// the centers by cell, when the basis is compact
+	CPointGrid m_grid;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::CTPSEvaluator<TYPE>
+//
+// constructs an empty evaluator
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+inline CTPSEvaluator<TYPE>::CTPSEvaluator()
+{
+	Clear();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::SetBasis
+//
+// packs the centers and weights.  a TYPE narrower than REAL moves the
+//		origin to the centroid of the centers.  for the thin plate 
+//		kernel it also measures distances in a unit L, twice the 
+//		distance to the farthest center, so that log(r) is small over 
+//		the image: with r = L p, sum w_i U(r_i) is the sum of L^2 w_i
+//		U(p_i) plus k log(L) sum w_i r_i^2, and by the constraints on 
+//		the weights the last sum is affine in the point.  REAL keeps the
+//		centers as they are, so that the sums match CTPSTransform::Eval
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+inline void CTPSEvaluator<TYPE>::SetBasis(int nCenters, const REAL *pCenterX, const REAL *pCenterY,
+	const REAL *pWx, const REAL *pWy, const CRadialBasis& basis)
+{
+	m_originX = 0.0;
+	m_originY = 0.0;
+	m_unit = 1.0;
+	if (sizeof(TYPE) < sizeof(REAL) && nCenters > 0)
+	{
+		for (int nAt = 0; nAt < nCenters; nAt++)
+		{
+			m_originX += pCenterX[nAt];
+			m_originY += pCenterY[nAt];
+		}
+		m_originX /= (REAL) nCenters;
+		m_originY /= (REAL) nCenters;
+
+		REAL maxR2 = 0.0;
+		for (int nAt = 0; nAt < nCenters; nAt++)
+		{
+			const REAL diffX = pCenterX[nAt] - m_originX;
+			const REAL diffY = pCenterY[nAt] - m_originY;
+			maxR2 = __max(maxR2, diffX * diffX + diffY * diffY);
+		}
+		if (basis.GetKernelType() == CRadialBasis::THIN_PLATE && maxR2 > 0.0)
+		{
+			m_unit = 2.0 * sqrt(maxR2);
+		}
+	}
+	m_step = (TYPE) (1.0 / m_unit);
+
+	// the centers, and the affine terms, in the unit from the origin
+	const REAL unit2 = m_unit * m_unit;
+	const REAL logTerm = 0.5 * basis.GetK() * log(unit2);
+	std::vector<REAL> arrCenterX(nCenters), arrCenterY(nCenters);
+	REAL momentX[3] = { 0.0, 0.0, 0.0 };
+	REAL momentY[3] = { 0.0, 0.0, 0.0 };
+	m_arrWeightX.resize(nCenters);
+	m_arrWeightY.resize(nCenters);
+	for (int nAt = 0; nAt < nCenters; nAt++)
+	{
+		const REAL diffX = pCenterX[nAt] - m_originX;
+		const REAL diffY = pCenterY[nAt] - m_originY;
+		arrCenterX[nAt] = diffX / m_unit;
+		arrCenterY[nAt] = diffY / m_unit;
+		m_arrWeightX[nAt] = (TYPE) (pWx[nAt] * unit2);
+		m_arrWeightY[nAt] = (TYPE) (pWy[nAt] * unit2);
+
+		// sum w_i r_i^2 = sum w_i |c_i|^2 - 2 p . sum w_i c_i
+		if (logTerm != 0.0)
+		{
+			const REAL centerR2 = diffX * diffX + diffY * diffY;
+			momentX[0] += pWx[nAt] * centerR2;
+			momentX[1] -= 2.0 * pWx[nAt] * diffX;
+			momentX[2] -= 2.0 * pWx[nAt] * diffY;
+			momentY[0] += pWy[nAt] * centerR2;
+			momentY[1] -= 2.0 * pWy[nAt] * diffX;
+			momentY[2] -= 2.0 * pWy[nAt] * diffY;
+		}
+	}
+	m_arrCenterX.assign(arrCenterX.begin(), arrCenterX.end());
+	m_arrCenterY.assign(arrCenterY.begin(), arrCenterY.end());
+
+	m_affineX[0] = (TYPE) (pWx[nCenters] + pWx[nCenters + 1] * m_originX + pWx[nCenters + 2] * m_originY
+		+ logTerm * momentX[0]);
+	m_affineY[0] = (TYPE) (pWy[nCenters] + pWy[nCenters + 1] * m_originX + pWy[nCenters + 2] * m_originY
+		+ logTerm * momentY[0]);
+	for (int nAt = 1; nAt < 3; nAt++)
+	{
+		m_affineX[nAt] = (TYPE) ((pWx[nCenters + nAt] + logTerm * momentX[nAt]) * m_unit);
+		m_affineY[nAt] = (TYPE) ((pWy[nCenters + nAt] + logTerm * momentY[nAt]) * m_unit);
+	}
+
+	m_basis = basis;
+	if (m_basis.IsCompact() && nCenters > 0)
+	{
+		m_grid.SetPoints(nCenters, &arrCenterX[0], &arrCenterY[0], m_basis.GetSupportRadius());
+	}
+	else
+	{
+		m_grid.Clear();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::Clear
+//
+// removes all centers and zeros the affine part
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+inline void CTPSEvaluator<TYPE>::Clear()
+{
+	m_originX = 0.0;
+	m_originY = 0.0;
+	m_unit = 1.0;
+	m_step = 1.0;
+	m_arrCenterX.clear();
+	m_arrCenterY.clear();
+	m_arrWeightX.clear();
+	m_arrWeightY.clear();
+	m_grid.Clear();
+
+	for (int nAt = 0; nAt < 3; nAt++)
+	{
+		m_affineX[nAt] = 0.0;
+		m_affineY[nAt] = 0.0;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::GetCenterCount
+//
+// returns the number of radial centers
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+inline int CTPSEvaluator<TYPE>::GetCenterCount() const
+{
+	return (int) m_arrCenterX.size();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::CalcErrorBound
+//
+// each term w_i * U(r) is rounded a few times (the distance, the 
+//		kernel, the product and the sum), each by at most epsilon of its
+//		size.  U is largest at the support's center or at the farthest
+//		corner of the box, for every kernel
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+inline REAL CTPSEvaluator<TYPE>::CalcErrorBound(REAL x0, REAL y0, REAL x1, REAL y1) const
+{
+	x0 = (x0 - m_originX) / m_unit;
+	x1 = (x1 - m_originX) / m_unit;
+	y0 = (y0 - m_originY) / m_unit;
+	y1 = (y1 - m_originY) / m_unit;
+
+	const REAL maxX = __max(fabs(x0), fabs(x1));
+	const REAL maxY = __max(fabs(y0), fabs(y1));
+	REAL sumX = fabs(m_affineX[0]) + fabs(m_affineX[1]) * maxX + fabs(m_affineX[2]) * maxY;
+	REAL sumY = fabs(m_affineY[0]) + fabs(m_affineY[1]) * maxX + fabs(m_affineY[2]) * maxY;
+
+	const REAL centerU = fabs(m_basis(0.0));
+	const int nCenters = GetCenterCount();
+	for (int nCenter = 0; nCenter < nCenters; nCenter++)
+	{
+		const REAL farX = __max(fabs(x0 - m_arrCenterX[nCenter]), fabs(x1 - m_arrCenterX[nCenter]));
+		const REAL farY = __max(fabs(y0 - m_arrCenterY[nCenter]), fabs(y1 - m_arrCenterY[nCenter]));
+		const REAL maxU = __max(centerU, fabs(m_basis(farX * farX + farY * farY)));
+		sumX += fabs((REAL) m_arrWeightX[nCenter]) * maxU;
+		sumY += fabs((REAL) m_arrWeightY[nCenter]) * maxU;
+	}
+
+	return 8.0 * (REAL) std::numeric_limits<TYPE>::epsilon() * __max(sumX, sumY);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::EvalPoint
+//
+// evaluates the offset at a single point
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+inline void CTPSEvaluator<TYPE>::EvalPoint(REAL x, REAL y, TYPE& dx, TYPE& dy) const
+{
+	EvalRow(y, x, 1, &dx, &dy);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::EvalRow
+//
+// evaluates the offsets of nCount pixels along a row, using the
+//		kernel specialized for the basis exponent.  the row is moved
+//		to the origin in REAL, before it is narrowed to TYPE
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+inline void CTPSEvaluator<TYPE>::EvalRow(REAL y, REAL x0, int nCount, TYPE *pDx, TYPE *pDy) const
+{
+	const TYPE yOrigin = (TYPE) ((y - m_originY) / m_unit);
+	const TYPE x0Origin = (TYPE) ((x0 - m_originX) / m_unit);
+	m_basis.Dispatch([&](const auto& kernel) {
+		EvalRowT(kernel, yOrigin, x0Origin, nCount, pDx, pDy);
+	});
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::EvalRowT
+//
+// the row loop.  the row is cut into blocks of POINT_BLOCK pixels, and
+//		each is summed over the centers by AddRadialT.  along the row
+//		only x changes, so each center's (y - cy)^2 is taken once per
+//		tile, and a squared distance is one subtract and one multiply-
+//		add.  each pixel still sums its center contributions in order,
+//		followed by the affine terms, so the REAL result matches 
+//		CTPSTransform::Eval exactly
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+template<class KERNEL>
+inline void CTPSEvaluator<TYPE>::EvalRowT(const KERNEL& kernel, TYPE y, TYPE x0, int nCount,
+	TYPE *pDx, TYPE *pDy) const
+{
+	for (int nAt = 0; nAt < nCount; nAt++)
+	{
+		pDx[nAt] = 0.0;
+		pDy[nAt] = 0.0;
+	}
+
+	if (m_basis.IsCompact())
+	{
+		// only the centers near the row
+		EvalRowCompactT(kernel, y, x0, nCount, pDx, pDy);
+	}
+	else
+	{
+		TYPE arrX[POINT_BLOCK];
+		auto calcR2 = [&](int nCenter, int nStart, int nTile, TYPE *pR2) {
+			const TYPE cx = m_arrCenterX[nCenter];
+			const TYPE cy = y - m_arrCenterY[nCenter];
+			const TYPE cy2 = cy * cy;
+			const TYPE *pTileX = &arrX[nStart];
+			for (int nAt = 0; nAt < nTile; nAt++)
+			{
+				const TYPE diffX = pTileX[nAt] - cx;
+				pR2[nAt] = diffX * diffX + cy2;
+			}
+		};
+		for (int nStart = 0; nStart < nCount; nStart += POINT_BLOCK)
+		{
+			const int nBlock = (nCount - nStart < POINT_BLOCK) ? nCount - nStart : POINT_BLOCK;
+			for (int nAt = 0; nAt < nBlock; nAt++)
+			{
+				arrX[nAt] = x0 + (TYPE) (nStart + nAt) * m_step;
+			}
+			AddRadialT(kernel, calcR2, nBlock, &pDx[nStart], &pDy[nStart], (TYPE) 1.0);
+		}
+	}
+
+	// add the affine terms
+	for (int nAt = 0; nAt < nCount; nAt++)
+	{
+		const TYPE x = x0 + (TYPE) nAt * m_step;
+		pDx[nAt] += m_affineX[0];
+		pDy[nAt] += m_affineY[0];
+		pDx[nAt] += m_affineX[1] * x;
+		pDy[nAt] += m_affineY[1] * x;
+		pDx[nAt] += m_affineX[2] * y;
+		pDy[nAt] += m_affineY[2] * y;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::EvalPoints
+//
+// evaluates the offsets of arbitrary points, in blocks of POINT_BLOCK.
+//		each block is moved to the origin first
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+inline void CTPSEvaluator<TYPE>::EvalPoints(int nCount, const TYPE *pX, const TYPE *pY,
+	TYPE *pDx, TYPE *pDy, REAL percent) const
+{
+	TYPE arrX[POINT_BLOCK], arrY[POINT_BLOCK];
+	for (int nStart = 0; nStart < nCount; nStart += POINT_BLOCK)
+	{
+		int nBlock = (nCount - nStart < POINT_BLOCK) ? nCount - nStart : POINT_BLOCK;
+		for (int nAt = 0; nAt < nBlock; nAt++)
+		{
+			arrX[nAt] = (TYPE) ((pX[nStart + nAt] - m_originX) / m_unit);
+			arrY[nAt] = (TYPE) ((pY[nStart + nAt] - m_originY) / m_unit);
+		}
+
+		EvalPointBlock(nBlock, arrX, arrY,
+			&pDx[nStart], &pDy[nStart], (TYPE) percent);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::EvalPoints
+//
+// evaluates the offsets of interleaved points.  each block is split
+//		into x and y arrays, evaluated, then interleaved again
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+inline void CTPSEvaluator<TYPE>::EvalPoints(int nCount, const TYPE *pXY, TYPE *pOffsetXY,
+	REAL percent) const
+{
+	TYPE arrX[POINT_BLOCK], arrY[POINT_BLOCK];
+	TYPE arrDx[POINT_BLOCK], arrDy[POINT_BLOCK];
+	for (int nStart = 0; nStart < nCount; nStart += POINT_BLOCK)
+	{
+		int nBlock = (nCount - nStart < POINT_BLOCK) ? nCount - nStart : POINT_BLOCK;
+		const TYPE *pBlockXY = &pXY[2 * nStart];
+		for (int nAt = 0; nAt < nBlock; nAt++)
+		{
+			arrX[nAt] = (TYPE) ((pBlockXY[2 * nAt + 0] - m_originX) / m_unit);
+			arrY[nAt] = (TYPE) ((pBlockXY[2 * nAt + 1] - m_originY) / m_unit);
+		}
+
+		EvalPointBlock(nBlock, arrX, arrY, arrDx, arrDy, (TYPE) percent);
+
+		TYPE *pBlockOffsetXY = &pOffsetXY[2 * nStart];
+		for (int nAt = 0; nAt < nBlock; nAt++)
+		{
+			pBlockOffsetXY[2 * nAt + 0] = arrDx[nAt];
+			pBlockOffsetXY[2 * nAt + 1] = arrDy[nAt];
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::EvalPointBlock
+//
+// evaluates a block of points, using the kernel specialized for the
+//		basis exponent
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+inline void CTPSEvaluator<TYPE>::EvalPointBlock(int nCount, const TYPE *pX, const TYPE *pY,
+	TYPE *pDx, TYPE *pDy, TYPE percent) const
+{
+	m_basis.Dispatch([&](const auto& kernel) {
+		EvalPointBlockT(kernel, nCount, pX, pY, pDx, pDy, percent);
+	});
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::EvalPointBlockT
+//
+// the point loop.  like EvalRowT, the radial terms are summed by
+//		AddRadialT, and each point sums its terms in the same order as
+//		CTPSTransform::Eval
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+template<class KERNEL>
+inline void CTPSEvaluator<TYPE>::EvalPointBlockT(const KERNEL& kernel, int nCount,
+	const TYPE *pX, const TYPE *pY, TYPE *pDx, TYPE *pDy, TYPE percent) const
+{
+	for (int nAt = 0; nAt < nCount; nAt++)
+	{
+		pDx[nAt] = 0.0;
+		pDy[nAt] = 0.0;
+	}
+
+	if (m_basis.IsCompact())
+	{
+		// only the centers near each point
+		EvalPointBlockCompactT(kernel, nCount, pX, pY, pDx, pDy, percent);
+	}
+	else
+	{
+		auto calcR2 = [&](int nCenter, int nStart, int nTile, TYPE *pR2) {
+			const TYPE cx = m_arrCenterX[nCenter];
+			const TYPE cy = m_arrCenterY[nCenter];
+			for (int nAt = nStart; nAt < nStart + nTile; nAt++)
+			{
+				const TYPE diffX = pX[nAt] - cx;
+				const TYPE diffY = pY[nAt] - cy;
+				pR2[nAt - nStart] = diffX * diffX + diffY * diffY;
+			}
+		};
+		AddRadialT(kernel, calcR2, nCount, pDx, pDy, percent);
+	}
+
+	// add the affine terms
+	for (int nAt = 0; nAt < nCount; nAt++)
+	{
+		pDx[nAt] += m_affineX[0];
+		pDy[nAt] += m_affineY[0];
+		pDx[nAt] += m_affineX[1] * pX[nAt];
+		pDy[nAt] += m_affineY[1] * pX[nAt];
+		pDx[nAt] += m_affineX[2] * pY[nAt];
+		pDy[nAt] += m_affineY[2] * pY[nAt];
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::AddRadialT
+//
+// the sum over the centers is a product of the points-by-centers
+//		kernel matrix with the centers-by-2 weights, so it is blocked 
+//		like one: the outer loop is over blocks of CENTER_BLOCK 
+//		centers, and each block is summed into every tile of 
+//		KERNEL_BLOCK points before the next is loaded.  a block's 
+//		centers and weights stay in L1 while the tiles stream past, 
+//		however many centers there are in all.  blocks of centers are 
+//		taken in order, so each point still sums its terms in center 
+//		order
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+template<class KERNEL, class CALC_R2>
+inline void CTPSEvaluator<TYPE>::AddRadialT(const KERNEL& kernel, const CALC_R2& calcR2, int nCount,
+	TYPE *pDx, TYPE *pDy, TYPE percent) const
+{
+	ASSERT(nCount <= POINT_BLOCK);
+
+	const int nCenters = GetCenterCount();
+	for (int nCenter = 0; nCenter < nCenters; nCenter += CENTER_BLOCK)
+	{
+		const int nCenterEnd = (nCenters - nCenter < CENTER_BLOCK) ? nCenters : nCenter + CENTER_BLOCK;
+		for (int nStart = 0; nStart < nCount; nStart += KERNEL_BLOCK)
+		{
+			const int nTile = (nCount - nStart < KERNEL_BLOCK) ? nCount - nStart : KERNEL_BLOCK;
+			AddRadialTileT(kernel, calcR2, nCenter, nCenterEnd, nStart, nTile,
+				&pDx[nStart], &pDy[nStart], percent);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::AddRadialTileT
+//
+// the squared distances from CENTER_UNROLL centers to the tile go 
+//		through the kernel's block form together, then each point adds
+//		the four terms in a register, in center order, and stores its
+//		sums once.  a last partial group of centers is added one at a
+//		time
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+template<class KERNEL, class CALC_R2>
+inline void CTPSEvaluator<TYPE>::AddRadialTileT(const KERNEL& kernel, const CALC_R2& calcR2, 
+	int nCenter, int nCenterEnd, int nStart, int nCount, TYPE *pDx, TYPE *pDy, TYPE percent) const
+{
+	TYPE arrR2[CENTER_UNROLL * KERNEL_BLOCK], arrD[CENTER_UNROLL * KERNEL_BLOCK];
+	for (; nCenter < nCenterEnd; nCenter += CENTER_UNROLL)
+	{
+		const int nUnroll = (nCenterEnd - nCenter < CENTER_UNROLL) ? nCenterEnd - nCenter : CENTER_UNROLL;
+		for (int nAtCenter = 0; nAtCenter < nUnroll; nAtCenter++)
+		{
+			calcR2(nCenter + nAtCenter, nStart, nCount, &arrR2[nAtCenter * nCount]);
+		}
+		kernel.Eval(nUnroll * nCount, arrR2, arrD);
+
+		if (nUnroll == CENTER_UNROLL)
+		{
+			const TYPE *pD0 = &arrD[0 * nCount];
+			const TYPE *pD1 = &arrD[1 * nCount];
+			const TYPE *pD2 = &arrD[2 * nCount];
+			const TYPE *pD3 = &arrD[3 * nCount];
+			const TYPE wx0 = m_arrWeightX[nCenter + 0], wy0 = m_arrWeightY[nCenter + 0];
+			const TYPE wx1 = m_arrWeightX[nCenter + 1], wy1 = m_arrWeightY[nCenter + 1];
+			const TYPE wx2 = m_arrWeightX[nCenter + 2], wy2 = m_arrWeightY[nCenter + 2];
+			const TYPE wx3 = m_arrWeightX[nCenter + 3], wy3 = m_arrWeightY[nCenter + 3];
+			for (int nAt = 0; nAt < nCount; nAt++)
+			{
+				const TYPE dp0 = pD0[nAt] * percent;
+				const TYPE dp1 = pD1[nAt] * percent;
+				const TYPE dp2 = pD2[nAt] * percent;
+				const TYPE dp3 = pD3[nAt] * percent;
+				TYPE dx = pDx[nAt], dy = pDy[nAt];
+				dx += wx0 * dp0;
+				dy += wy0 * dp0;
+				dx += wx1 * dp1;
+				dy += wy1 * dp1;
+				dx += wx2 * dp2;
+				dy += wy2 * dp2;
+				dx += wx3 * dp3;
+				dy += wy3 * dp3;
+				pDx[nAt] = dx;
+				pDy[nAt] = dy;
+			}
+		}
+		else
+		{
+			for (int nAtCenter = 0; nAtCenter < nUnroll; nAtCenter++)
+			{
+				const TYPE *pD = &arrD[nAtCenter * nCount];
+				const TYPE wx = m_arrWeightX[nCenter + nAtCenter];
+				const TYPE wy = m_arrWeightY[nCenter + nAtCenter];
+				for (int nAt = 0; nAt < nCount; nAt++)
+				{
+					const TYPE dp = pD[nAt] * percent;
+					pDx[nAt] += wx * dp;
+					pDy[nAt] += wy * dp;
+				}
+			}
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::EvalRowCompactT
+//
+// adds the radial terms of the centers within the support radius of
+//		the row.  each center only touches the run of pixels under its
+//		support, so the inner loop is still along the row.  the
+//		kernel's scalar form is in REAL
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+template<class KERNEL>
+inline void CTPSEvaluator<TYPE>::EvalRowCompactT(const KERNEL& kernel, TYPE y, TYPE x0, int nCount,
+	TYPE *pDx, TYPE *pDy) const
+{
+	const REAL radius = m_basis.GetSupportRadius();
+	const REAL radius2 = radius * radius;
+	m_grid.ForEachInBox(x0 - radius, y - radius, x0 + (REAL) (nCount - 1) + radius, y + radius,
+		[&](int nCenter) {
+			const REAL cx = m_arrCenterX[nCenter];
+			const REAL cy = y - m_arrCenterY[nCenter];
+			const REAL cy2 = cy * cy;
+			if (cy2 >= radius2)
+			{
+				return;
+			}
+
+			// the pixels under the support, which the kernel is zero past
+			const REAL halfChord = sqrt(radius2 - cy2);
+			const REAL first = ceil(cx - halfChord - x0);
+			const REAL last = floor(cx + halfChord - x0);
+			const int nFirst = (first > 0.0) ? (int) first : 0;
+			const int nEnd = (last < (REAL) (nCount - 1)) ? (int) last + 1 : nCount;
+			const REAL wx = m_arrWeightX[nCenter];
+			const REAL wy = m_arrWeightY[nCenter];
+			for (int nAt = nFirst; nAt < nEnd; nAt++)
+			{
+				const REAL diffX = (x0 + (REAL) nAt) - cx;
+				const REAL d = kernel(diffX * diffX + cy2);
+				pDx[nAt] += (TYPE) (wx * d);
+				pDy[nAt] += (TYPE) (wy * d);
+			}
+		});
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSEvaluator<TYPE>::EvalPointBlockCompactT
+//
+// adds the radial terms of the centers within the support radius of
+//		each point
+//////////////////////////////////////////////////////////////////////
+template<class TYPE>
+template<class KERNEL>
+inline void CTPSEvaluator<TYPE>::EvalPointBlockCompactT(const KERNEL& kernel, int nCount,
+	const TYPE *pX, const TYPE *pY, TYPE *pDx, TYPE *pDy, TYPE percent) const
+{
+	const REAL radius = m_basis.GetSupportRadius();
+	for (int nAt = 0; nAt < nCount; nAt++)
+	{
+		REAL dx = 0.0, dy = 0.0;
+		m_grid.ForEachNear(pX[nAt], pY[nAt], radius,
+			[&](int nCenter, REAL r2) {
+				const REAL dp = kernel(r2) * percent;
+				dx += m_arrWeightX[nCenter] * dp;
+				dy += m_arrWeightY[nCenter] * dp;
+			});
+		pDx[nAt] = (TYPE) dx;
+		pDy[nAt] = (TYPE) dy;
+	}
+}
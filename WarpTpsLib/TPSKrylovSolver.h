@@ -0,0 +1,813 @@
+//////////////////////////////////////////////////////////////////////
+// TPSKrylovSolver.h: interface for the CTPSKrylovSolver class.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+// math utilities
+#include "MathUtil.h"
+
+// radial basis kernels
+#include "RadialBasis.h"
+
+// default relative residual to stop at
+const REAL KRYLOV_DEFAULT_TOLERANCE = 1e-8;
+
+// default most iterations before the solve gives up
+const int KRYLOV_DEFAULT_MAX_ITERATIONS = 300;
+
+// iterations between restarts of GMRES
+const int KRYLOV_RESTART = 40;
+
+// centers in the local system of each cardinal function
+const int KRYLOV_CARDINAL_SIZE = 50;
+
+// centers per coarse center, and the most coarse centers on a side of
+//		the grid they are picked from
+const int KRYLOV_COARSE_RATIO = 64;
+const int KRYLOV_COARSE_GRID = 32;
+
+//////////////////////////////////////////////////////////////////////
+// class CTPSKrylovSolver
+//
+// solves the TPS system
+//		[ K  P ] [ w ]   [ h ]
+//		[ P' 0 ] [ a ] = [ 0 ]
+//		for the x- and y-weights using only products with K, so that
+//		nothing of size n^2 is formed.  P holds the affine terms
+//		(1, x, y) of each center.  with N the projection onto the null
+//		space of P', restarted GMRES solves
+//			N K C z = N h,  w = N C z
+//		and then a fits the rest, P a = h - K w.
+//
+//		K itself is badly conditioned, so C is a preconditioner of
+//		approximate cardinal functions (Beatson, Cherrie and Mouat):
+//		column i holds the weights of the TPS through the nearest
+//		centers to center i that is 1 there and 0 at the others.  K C
+//		is then close to the identity (less an affine part that N
+//		removes) near each center.  but the field of a local TPS does
+//		not decay far away, so C also has a coarse level: a TPS through
+//		a few hundred centers spread over the whole set, solved 
+//		exactly, that cancels the far fields of the cardinal functions
+//		at those centers.  GMRES then converges in a few tens of 
+//		iterations, up to some 60,000 centers; past that the coarse 
+//		level is capped, and the iterations grow.
+//
+//		the caller supplies the product with K, so it can be a direct
+//		O(n^2) sum or a tree's O(n log n) one.  the weights passed in
+//		are the starting guess, so a solve for slightly moved landmarks
+//		starts from the last weights
+//////////////////////////////////////////////////////////////////////
+class CTPSKrylovSolver
+{
+public:
+	// construction
+	CTPSKrylovSolver();
+
+	// the relative residual |N (h - K w)| / |N h| to stop at
+	REAL GetTolerance() const { return m_tolerance; }
+	void SetTolerance(REAL tolerance) { m_tolerance = tolerance; }
+
+	// the most iterations (products with K) before giving up
+	int GetMaxIterations() const { return m_nMaxIterations; }
+	void SetMaxIterations(int nMaxIterations) { m_nMaxIterations = nMaxIterations; }
+
+	// loads the centers: orthonormalizes the affine terms for the
+	//		projection, and solves the local systems of the
+	//		preconditioner.  returns FALSE if the centers are collinear
+	BOOL SetCenters(int nCenters, const REAL *pCenterX, const REAL *pCenterY,
+		const CRadialBasis& basis);
+
+	// the number of centers loaded
+	int GetCenterCount() const { return (int) m_arrQ[0].size(); }
+
+	// solves for the nCenters radial weights and the three affine
+	//		weights (1, x, y) of both directions, starting from the
+	//		weights passed in.  multiplyKernel(pWx, pWy, pKWx, pKWy)
+	//		returns the products of K with the radial weights.  returns
+	//		FALSE if the residual did not reach the tolerance
+	template<class MULTIPLY_KERNEL>
+	BOOL Solve(MULTIPLY_KERNEL multiplyKernel, const REAL *pHx, const REAL *pHy,
+		REAL *pWx, REAL *pWy);
+
+	// the iterations and final relative residual of the last solve
+	int GetIterationCount() const { return m_nIterations; }
+	REAL GetResidual() const { return m_residual; }
+
+protected:
+	// fills the local system of each center: itself, then its nearest
+	//		others
+	void FindNeighbors(int nCenters, const REAL *pCenterX, const REAL *pCenterY);
+
+	// solves the local system for the cardinal function of a center
+	void CalcCardinal(int nCenter, const REAL *pCenterX, const REAL *pCenterY,
+		const CRadialBasis& basis);
+
+	// picks the coarse centers, and factorizes their TPS system
+	void CalcCoarse(int nCenters, const REAL *pCenterX, const REAL *pCenterY,
+		const CRadialBasis& basis);
+
+	// v = N C z
+	void ApplyPreconditioner(const REAL *pZ, REAL *pV) const;
+
+	// projects v onto the null space of P', in place
+	void Project(REAL *pV) const;
+
+	// fits the affine weights to the residual h - K w
+	void FitAffine(const REAL *pResidual, REAL *pAffine) const;
+
+private:
+	// the orthonormal basis of the affine terms, as three columns, and
+	//		the upper triangle R with P = Q R
+	std::vector<REAL> m_arrQ[3];
+	REAL m_mR[3][3];
+
+	// the centers, and the basis
+	std::vector<REAL> m_arrCenterX;
+	std::vector<REAL> m_arrCenterY;
+	CRadialBasis m_basis;
+
+	// the cardinal functions: for each center, where its local centers
+	//		start, and the local centers and their weights
+	std::vector<int> m_arrCardinalStart;
+	std::vector<int> m_arrCardinalIndex;
+	std::vector<REAL> m_arrCardinalWeight;
+
+	// the coarse centers, and the LU factors of their TPS system
+	std::vector<int> m_arrCoarse;
+	ublas::matrix<REAL> m_mCoarseLU;
+	ublas::permutation_matrix<size_t> m_vCoarsePivot;
+
+	// the stopping criteria
+	REAL m_tolerance;
+	int m_nMaxIterations;
+
+	// the statistics of the last solve
+	int m_nIterations;
+	REAL m_residual;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CTPSKrylovSolver::CTPSKrylovSolver
+//
+// constructs a solver with no centers
+//////////////////////////////////////////////////////////////////////
+inline CTPSKrylovSolver::CTPSKrylovSolver()
+	: m_vCoarsePivot(0)
+	, m_tolerance(KRYLOV_DEFAULT_TOLERANCE)
+	, m_nMaxIterations(KRYLOV_DEFAULT_MAX_ITERATIONS)
+	, m_nIterations(0)
+	, m_residual(0.0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSKrylovSolver::SetCenters
+//
+// modified Gram-Schmidt on the columns 1, x and y, then the cardinal
+//		functions
+//////////////////////////////////////////////////////////////////////
+inline BOOL CTPSKrylovSolver::SetCenters(int nCenters, const REAL *pCenterX, const REAL *pCenterY,
+	const CRadialBasis& basis)
+{
+	m_arrQ[0].assign(nCenters, 1.0);
+	m_arrQ[1].assign(pCenterX, pCenterX + nCenters);
+	m_arrQ[2].assign(pCenterY, pCenterY + nCenters);
+
+	for (int nCol = 0; nCol < 3; nCol++)
+	{
+		std::vector<REAL>& arrCol = m_arrQ[nCol];
+
+		// the size of the column, to judge what is left of it
+		REAL norm = 0.0;
+		for (int nAt = 0; nAt < nCenters; nAt++)
+		{
+			norm += arrCol[nAt] * arrCol[nAt];
+		}
+		norm = sqrt(norm);
+
+		for (int nPrev = 0; nPrev < 3; nPrev++)
+		{
+			m_mR[nPrev][nCol] = 0.0;
+		}
+		for (int nPrev = 0; nPrev < nCol; nPrev++)
+		{
+			REAL dot = 0.0;
+			for (int nAt = 0; nAt < nCenters; nAt++)
+			{
+				dot += m_arrQ[nPrev][nAt] * arrCol[nAt];
+			}
+			for (int nAt = 0; nAt < nCenters; nAt++)
+			{
+				arrCol[nAt] -= dot * m_arrQ[nPrev][nAt];
+			}
+			m_mR[nPrev][nCol] = dot;
+		}
+
+		REAL length = 0.0;
+		for (int nAt = 0; nAt < nCenters; nAt++)
+		{
+			length += arrCol[nAt] * arrCol[nAt];
+		}
+		length = sqrt(length);
+
+		// nothing left means the centers are collinear
+		if (length == 0.0 || length <= 1e-10 * norm)
+		{
+			m_arrQ[0].clear();
+			return FALSE;
+		}
+
+		for (int nAt = 0; nAt < nCenters; nAt++)
+		{
+			arrCol[nAt] /= length;
+		}
+		m_mR[nCol][nCol] = length;
+	}
+
+	m_arrCenterX.assign(pCenterX, pCenterX + nCenters);
+	m_arrCenterY.assign(pCenterY, pCenterY + nCenters);
+	m_basis = basis;
+
+	// the cardinal functions, and the coarse level
+	FindNeighbors(nCenters, pCenterX, pCenterY);
+	m_arrCardinalWeight.resize(m_arrCardinalIndex.size());
+	for (int nAt = 0; nAt < nCenters; nAt++)
+	{
+		CalcCardinal(nAt, pCenterX, pCenterY, basis);
+	}
+	CalcCoarse(nCenters, pCenterX, pCenterY, basis);
+
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSKrylovSolver::FindNeighbors
+//
+// buckets the centers in a grid of about four centers per cell.  for
+//		each center, rings of cells around it are searched until the
+//		nearest found are all closer than any unsearched cell
+//////////////////////////////////////////////////////////////////////
+inline void CTPSKrylovSolver::FindNeighbors(int nCenters, const REAL *pCenterX, const REAL *pCenterY)
+{
+	const int nNear = __min(KRYLOV_CARDINAL_SIZE, nCenters);
+	const REAL minX = *std::min_element(pCenterX, pCenterX + nCenters);
+	const REAL maxX = *std::max_element(pCenterX, pCenterX + nCenters);
+	const REAL minY = *std::min_element(pCenterY, pCenterY + nCenters);
+	const REAL maxY = *std::max_element(pCenterY, pCenterY + nCenters);
+	const REAL area = __max(maxX - minX, 1.0) * __max(maxY - minY, 1.0);
+	const REAL cellSize = sqrt(4.0 * area / nCenters);
+	const int nCellsX = (int) ((maxX - minX) / cellSize) + 1;
+	const int nCellsY = (int) ((maxY - minY) / cellSize) + 1;
+
+	// the centers sorted by cell, and where each cell starts
+	std::vector<int> arrCellStart(nCellsX * nCellsY + 1, 0);
+	std::vector<int> arrCell(nCenters);
+	for (int nAt = 0; nAt < nCenters; nAt++)
+	{
+		int nCellX = (int) ((pCenterX[nAt] - minX) / cellSize);
+		int nCellY = (int) ((pCenterY[nAt] - minY) / cellSize);
+		arrCell[nAt] = nCellY * nCellsX + nCellX;
+		arrCellStart[arrCell[nAt] + 1]++;
+	}
+	for (int nAtCell = 0; nAtCell < nCellsX * nCellsY; nAtCell++)
+	{
+		arrCellStart[nAtCell + 1] += arrCellStart[nAtCell];
+	}
+	std::vector<int> arrSorted(nCenters);
+	std::vector<int> arrFill(arrCellStart.begin(), arrCellStart.end() - 1);
+	for (int nAt = 0; nAt < nCenters; nAt++)
+	{
+		arrSorted[arrFill[arrCell[nAt]]++] = nAt;
+	}
+
+	m_arrCardinalStart.assign(1, 0);
+	m_arrCardinalIndex.clear();
+	std::vector<std::pair<REAL, int> > arrFound;
+	for (int nAt = 0; nAt < nCenters; nAt++)
+	{
+		const int nCount = nNear;
+		const int nCellX = arrCell[nAt] % nCellsX;
+		const int nCellY = arrCell[nAt] / nCellsX;
+		arrFound.clear();
+		for (int nRing = 0; ; nRing++)
+		{
+			for (int nAtY = nCellY - nRing; nAtY <= nCellY + nRing; nAtY++)
+			{
+				for (int nAtX = nCellX - nRing; nAtX <= nCellX + nRing; nAtX++)
+				{
+					// only the cells on the ring itself
+					if ((abs(nAtY - nCellY) != nRing && abs(nAtX - nCellX) != nRing)
+						|| nAtX < 0 || nAtX >= nCellsX || nAtY < 0 || nAtY >= nCellsY)
+					{
+						continue;
+					}
+
+					const int nAtCell = nAtY * nCellsX + nAtX;
+					for (int nAtSorted = arrCellStart[nAtCell]; nAtSorted < arrCellStart[nAtCell + 1]; nAtSorted++)
+					{
+						const int nOther = arrSorted[nAtSorted];
+						if (nOther == nAt)
+						{
+							continue;
+						}
+						const REAL dx = pCenterX[nOther] - pCenterX[nAt];
+						const REAL dy = pCenterY[nOther] - pCenterY[nAt];
+						arrFound.push_back(std::make_pair(dx * dx + dy * dy, nOther));
+					}
+				}
+			}
+
+			// every other center within nRing cells has been found
+			const REAL searched = nRing * cellSize;
+			if ((int) arrFound.size() >= nCount - 1)
+			{
+				if (nCount <= 1)
+				{
+					break;
+				}
+				std::nth_element(arrFound.begin(), arrFound.begin() + (nCount - 2), arrFound.end());
+				if (arrFound[nCount - 2].first <= searched * searched)
+				{
+					break;
+				}
+			}
+			if (nRing > nCellsX && nRing > nCellsY)
+			{
+				break;
+			}
+		}
+
+		// the center first, then its nearest others
+		m_arrCardinalIndex.push_back(nAt);
+		for (int nFound = 0; nFound < nCount - 1; nFound++)
+		{
+			m_arrCardinalIndex.push_back(arrFound[nFound].second);
+		}
+		m_arrCardinalStart.push_back((int) m_arrCardinalIndex.size());
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSKrylovSolver::CalcCardinal
+//
+// solves the TPS system of the local centers for heights (1, 0, ... 0).
+//		if they are too few, or collinear, the column is just the center
+//////////////////////////////////////////////////////////////////////
+inline void CTPSKrylovSolver::CalcCardinal(int nCenter, const REAL *pCenterX, const REAL *pCenterY,
+	const CRadialBasis& basis)
+{
+	const int nStart = m_arrCardinalStart[nCenter];
+	const int nCount = m_arrCardinalStart[nCenter + 1] - nStart;
+	const int *pIndex = &m_arrCardinalIndex[nStart];
+	REAL *pWeight = &m_arrCardinalWeight[nStart];
+
+	// relative to the center, to keep the affine terms small
+	const REAL x0 = pCenterX[pIndex[0]];
+	const REAL y0 = pCenterY[pIndex[0]];
+	ublas::matrix<REAL> mL(nCount + 3, nCount + 3);
+	mL.clear();
+	for (int nRow = 0; nRow < nCount; nRow++)
+	{
+		const REAL x = pCenterX[pIndex[nRow]];
+		const REAL y = pCenterY[pIndex[nRow]];
+		for (int nCol = 0; nCol < nRow; nCol++)
+		{
+			const REAL dx = x - pCenterX[pIndex[nCol]];
+			const REAL dy = y - pCenterY[pIndex[nCol]];
+			mL(nRow, nCol) = mL(nCol, nRow) = basis(dx * dx + dy * dy);
+		}
+		mL(nRow, nRow) = basis(0.0);
+		mL(nRow, nCount) = mL(nCount, nRow) = 1.0;
+		mL(nRow, nCount + 1) = mL(nCount + 1, nRow) = x - x0;
+		mL(nRow, nCount + 2) = mL(nCount + 2, nRow) = y - y0;
+	}
+
+	ublas::vector<REAL> vW(nCount + 3);
+	vW.clear();
+	vW(0) = 1.0;
+	ublas::permutation_matrix<size_t> vPivot(nCount + 3);
+	if (nCount <= 3 || ublas::lu_factorize(mL, vPivot) != 0)
+	{
+		std::fill(pWeight, pWeight + nCount, 0.0);
+		pWeight[0] = 1.0;
+		return;
+	}
+	ublas::lu_substitute(mL, vPivot, vW);
+	for (int nAt = 0; nAt < nCount; nAt++)
+	{
+		pWeight[nAt] = vW(nAt);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSKrylovSolver::CalcCoarse
+//
+// the center nearest the middle of each cell of a grid over the centers.
+//		with few centers, the cardinal functions cover them all, and
+//		there is no coarse level
+//////////////////////////////////////////////////////////////////////
+inline void CTPSKrylovSolver::CalcCoarse(int nCenters, const REAL *pCenterX, const REAL *pCenterY,
+	const CRadialBasis& basis)
+{
+	m_arrCoarse.clear();
+	if (nCenters <= 4 * KRYLOV_CARDINAL_SIZE)
+	{
+		return;
+	}
+
+	const int nGrid = __max(2, __min(KRYLOV_COARSE_GRID, 
+		(int) sqrt((REAL) nCenters / KRYLOV_COARSE_RATIO)));
+	const REAL minX = *std::min_element(pCenterX, pCenterX + nCenters);
+	const REAL maxX = *std::max_element(pCenterX, pCenterX + nCenters);
+	const REAL minY = *std::min_element(pCenterY, pCenterY + nCenters);
+	const REAL maxY = *std::max_element(pCenterY, pCenterY + nCenters);
+	std::vector<int> arrNearest(nGrid * nGrid, -1);
+	std::vector<REAL> arrNearest2(nGrid * nGrid, 0.0);
+	for (int nAt = 0; nAt < nCenters; nAt++)
+	{
+		// the cell of the center, and its distance from the middle
+		const REAL cellX = (pCenterX[nAt] - minX) / __max(maxX - minX, 1e-9) * nGrid;
+		const REAL cellY = (pCenterY[nAt] - minY) / __max(maxY - minY, 1e-9) * nGrid;
+		const int nCellX = __min((int) cellX, nGrid - 1);
+		const int nCellY = __min((int) cellY, nGrid - 1);
+		const REAL dx = cellX - (nCellX + 0.5);
+		const REAL dy = cellY - (nCellY + 0.5);
+		const int nCell = nCellY * nGrid + nCellX;
+		if (arrNearest[nCell] < 0 || dx * dx + dy * dy < arrNearest2[nCell])
+		{
+			arrNearest[nCell] = nAt;
+			arrNearest2[nCell] = dx * dx + dy * dy;
+		}
+	}
+	for (int nCell = 0; nCell < nGrid * nGrid; nCell++)
+	{
+		if (arrNearest[nCell] >= 0)
+		{
+			m_arrCoarse.push_back(arrNearest[nCell]);
+		}
+	}
+
+	// the coarse TPS system, relative to the first coarse center
+	const int nCoarse = (int) m_arrCoarse.size();
+	const REAL x0 = pCenterX[m_arrCoarse[0]];
+	const REAL y0 = pCenterY[m_arrCoarse[0]];
+	m_mCoarseLU.resize(nCoarse + 3, nCoarse + 3, false);
+	m_mCoarseLU.clear();
+	for (int nRow = 0; nRow < nCoarse; nRow++)
+	{
+		const REAL x = pCenterX[m_arrCoarse[nRow]];
+		const REAL y = pCenterY[m_arrCoarse[nRow]];
+		for (int nCol = 0; nCol < nRow; nCol++)
+		{
+			const REAL dx = x - pCenterX[m_arrCoarse[nCol]];
+			const REAL dy = y - pCenterY[m_arrCoarse[nCol]];
+			m_mCoarseLU(nRow, nCol) = m_mCoarseLU(nCol, nRow) = basis(dx * dx + dy * dy);
+		}
+		m_mCoarseLU(nRow, nRow) = basis(0.0);
+		m_mCoarseLU(nRow, nCoarse) = m_mCoarseLU(nCoarse, nRow) = 1.0;
+		m_mCoarseLU(nRow, nCoarse + 1) = m_mCoarseLU(nCoarse + 1, nRow) = x - x0;
+		m_mCoarseLU(nRow, nCoarse + 2) = m_mCoarseLU(nCoarse + 2, nRow) = y - y0;
+	}
+	m_vCoarsePivot = ublas::permutation_matrix<size_t>(nCoarse + 3);
+	if (ublas::lu_factorize(m_mCoarseLU, m_vCoarsePivot) != 0)
+	{
+		m_arrCoarse.clear();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSKrylovSolver::Solve
+//
+// restarted GMRES for both directions side by side, sharing each
+//		product with K.  a direction that has converged stops adding
+//		to its Krylov space
+//////////////////////////////////////////////////////////////////////
+template<class MULTIPLY_KERNEL>
+inline BOOL CTPSKrylovSolver::Solve(MULTIPLY_KERNEL multiplyKernel,
+	const REAL *pHx, const REAL *pHy, REAL *pWx, REAL *pWy)
+{
+	const int nCenters = GetCenterCount();
+	const int nRestart = KRYLOV_RESTART;
+	const REAL *arrH[2] = { pHx, pHy };
+	REAL *arrW[2] = { pWx, pWy };
+
+	// the start, moved into the null space
+	Project(pWx);
+	Project(pWy);
+
+	// the Krylov bases, the Hessenberg matrices reduced by Givens
+	//		rotations, and the rotated residuals
+	std::vector<REAL> arrV[2], arrHess[2], arrCos[2], arrSin[2], arrG[2];
+	std::vector<REAL> arrKW[2], arrU[2];
+	REAL arrHH[2];
+	for (int nDim = 0; nDim < 2; nDim++)
+	{
+		arrV[nDim].resize((size_t) (nRestart + 1) * nCenters);
+		arrHess[nDim].resize((nRestart + 1) * nRestart);
+		arrCos[nDim].resize(nRestart);
+		arrSin[nDim].resize(nRestart);
+		arrG[nDim].resize(nRestart + 1);
+		arrKW[nDim].resize(nCenters);
+		arrU[nDim].resize(nCenters);
+
+		std::vector<REAL> arrNH(arrH[nDim], arrH[nDim] + nCenters);
+		Project(arrNH.data());
+		arrHH[nDim] = 0.0;
+		for (int nAt = 0; nAt < nCenters; nAt++)
+		{
+			arrHH[nDim] += arrNH[nAt] * arrNH[nAt];
+		}
+	}
+
+	m_nIterations = 0;
+	BOOL arrDone[2] = { FALSE, FALSE };
+	REAL lastResidual = 0.0;
+	while (TRUE)
+	{
+		// the true residuals, to restart from or to finish with
+		multiplyKernel(pWx, pWy, arrKW[0].data(), arrKW[1].data());
+		m_residual = 0.0;
+		for (int nDim = 0; nDim < 2; nDim++)
+		{
+			REAL *pR = &arrV[nDim][0];
+			REAL rr = 0.0;
+			for (int nAt = 0; nAt < nCenters; nAt++)
+			{
+				pR[nAt] = arrH[nDim][nAt] - arrKW[nDim][nAt];
+			}
+			Project(pR);
+			for (int nAt = 0; nAt < nCenters; nAt++)
+			{
+				rr += pR[nAt] * pR[nAt];
+			}
+
+			const REAL residual = (arrHH[nDim] > 0.0) ? sqrt(rr / arrHH[nDim]) : sqrt(rr);
+			m_residual = __max(m_residual, residual);
+			arrDone[nDim] = (residual <= m_tolerance);
+
+			const REAL beta = sqrt(rr);
+			std::fill(arrG[nDim].begin(), arrG[nDim].end(), 0.0);
+			arrG[nDim][0] = beta;
+			for (int nAt = 0; nAt < nCenters && beta > 0.0; nAt++)
+			{
+				pR[nAt] /= beta;
+			}
+		}
+
+		// stop when done, out of iterations, or if a cycle made no
+		//		progress, as when the products with K are only accurate
+		//		to more than the tolerance
+		if ((arrDone[0] && arrDone[1]) || m_nIterations >= m_nMaxIterations
+			|| (m_nIterations > 0 && m_residual >= 0.5 * lastResidual))
+		{
+			break;
+		}
+		lastResidual = m_residual;
+
+		// one cycle of Arnoldi steps
+		int arrSteps[2] = { 0, 0 };
+		BOOL arrCycleDone[2] = { arrDone[0], arrDone[1] };
+		for (int nStep = 0; nStep < nRestart && !(arrCycleDone[0] && arrCycleDone[1])
+			&& m_nIterations < m_nMaxIterations; nStep++, m_nIterations++)
+		{
+			for (int nDim = 0; nDim < 2; nDim++)
+			{
+				if (arrCycleDone[nDim])
+				{
+					std::fill(arrU[nDim].begin(), arrU[nDim].end(), 0.0);
+				}
+				else
+				{
+					ApplyPreconditioner(&arrV[nDim][(size_t) nStep * nCenters], arrU[nDim].data());
+				}
+			}
+			multiplyKernel(arrU[0].data(), arrU[1].data(), arrKW[0].data(), arrKW[1].data());
+
+			for (int nDim = 0; nDim < 2; nDim++)
+			{
+				if (arrCycleDone[nDim])
+				{
+					continue;
+				}
+
+				// orthogonalize the projected product against the basis
+				REAL *pNext = &arrV[nDim][(size_t) (nStep + 1) * nCenters];
+				std::copy(arrKW[nDim].begin(), arrKW[nDim].end(), pNext);
+				Project(pNext);
+				REAL *pHess = &arrHess[nDim][nStep * (nRestart + 1)];
+				for (int nPrev = 0; nPrev <= nStep; nPrev++)
+				{
+					const REAL *pPrev = &arrV[nDim][(size_t) nPrev * nCenters];
+					REAL dot = 0.0;
+					for (int nAt = 0; nAt < nCenters; nAt++)
+					{
+						dot += pPrev[nAt] * pNext[nAt];
+					}
+					for (int nAt = 0; nAt < nCenters; nAt++)
+					{
+						pNext[nAt] -= dot * pPrev[nAt];
+					}
+					pHess[nPrev] = dot;
+				}
+				REAL length = 0.0;
+				for (int nAt = 0; nAt < nCenters; nAt++)
+				{
+					length += pNext[nAt] * pNext[nAt];
+				}
+				length = sqrt(length);
+				pHess[nStep + 1] = length;
+				for (int nAt = 0; nAt < nCenters && length > 0.0; nAt++)
+				{
+					pNext[nAt] /= length;
+				}
+
+				// apply the earlier rotations, then zero the subdiagonal
+				for (int nPrev = 0; nPrev < nStep; nPrev++)
+				{
+					const REAL a = pHess[nPrev], b = pHess[nPrev + 1];
+					pHess[nPrev] = arrCos[nDim][nPrev] * a + arrSin[nDim][nPrev] * b;
+					pHess[nPrev + 1] = -arrSin[nDim][nPrev] * a + arrCos[nDim][nPrev] * b;
+				}
+				const REAL diag = sqrt(pHess[nStep] * pHess[nStep] + length * length);
+				arrCos[nDim][nStep] = (diag > 0.0) ? pHess[nStep] / diag : 1.0;
+				arrSin[nDim][nStep] = (diag > 0.0) ? length / diag : 0.0;
+				pHess[nStep] = diag;
+				pHess[nStep + 1] = 0.0;
+				arrG[nDim][nStep + 1] = -arrSin[nDim][nStep] * arrG[nDim][nStep];
+				arrG[nDim][nStep] *= arrCos[nDim][nStep];
+
+				arrSteps[nDim] = nStep + 1;
+				const REAL residual = fabs(arrG[nDim][nStep + 1]);
+				if (residual * residual <= m_tolerance * m_tolerance * arrHH[nDim]
+					|| length == 0.0)
+				{
+					arrCycleDone[nDim] = TRUE;
+				}
+			}
+		}
+
+		// back substitute for the combination of the basis, and add its
+		//		preconditioned image to the weights
+		for (int nDim = 0; nDim < 2; nDim++)
+		{
+			const int nSteps = arrSteps[nDim];
+			if (nSteps == 0)
+			{
+				continue;
+			}
+
+			std::vector<REAL> arrY(nSteps);
+			for (int nRow = nSteps - 1; nRow >= 0; nRow--)
+			{
+				REAL sum = arrG[nDim][nRow];
+				for (int nCol = nRow + 1; nCol < nSteps; nCol++)
+				{
+					sum -= arrHess[nDim][nCol * (nRestart + 1) + nRow] * arrY[nCol];
+				}
+				arrY[nRow] = sum / arrHess[nDim][nRow * (nRestart + 1) + nRow];
+			}
+
+			std::vector<REAL> arrZ(nCenters, 0.0);
+			for (int nCol = 0; nCol < nSteps; nCol++)
+			{
+				const REAL *pV = &arrV[nDim][(size_t) nCol * nCenters];
+				for (int nAt = 0; nAt < nCenters; nAt++)
+				{
+					arrZ[nAt] += arrY[nCol] * pV[nAt];
+				}
+			}
+			ApplyPreconditioner(arrZ.data(), arrU[nDim].data());
+			for (int nAt = 0; nAt < nCenters; nAt++)
+			{
+				arrW[nDim][nAt] += arrU[nDim][nAt];
+			}
+		}
+	}
+
+	// the affine weights take up the part of the residual in the span of
+	//		P.  arrKW holds K w from the last residual
+	for (int nDim = 0; nDim < 2; nDim++)
+	{
+		std::vector<REAL> arrR(nCenters);
+		for (int nAt = 0; nAt < nCenters; nAt++)
+		{
+			arrR[nAt] = arrH[nDim][nAt] - arrKW[nDim][nAt];
+		}
+		FitAffine(arrR.data(), &arrW[nDim][nCenters]);
+	}
+
+	return (arrDone[0] && arrDone[1]) ? TRUE : FALSE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSKrylovSolver::ApplyPreconditioner
+//
+// scatters each cardinal function, scaled by z.  the field of the sum
+//		should be z at each coarse center, so the coarse TPS through
+//		what is left over there is added, and the result projected
+//////////////////////////////////////////////////////////////////////
+inline void CTPSKrylovSolver::ApplyPreconditioner(const REAL *pZ, REAL *pV) const
+{
+	const int nCenters = GetCenterCount();
+	std::fill(pV, pV + nCenters, 0.0);
+	for (int nAt = 0; nAt < nCenters; nAt++)
+	{
+		for (int nAtCardinal = m_arrCardinalStart[nAt]; nAtCardinal < m_arrCardinalStart[nAt + 1]; nAtCardinal++)
+		{
+			pV[m_arrCardinalIndex[nAtCardinal]] += pZ[nAt] * m_arrCardinalWeight[nAtCardinal];
+		}
+	}
+
+	const int nCoarse = (int) m_arrCoarse.size();
+	if (nCoarse == 0)
+	{
+		Project(pV);
+		return;
+	}
+
+	ublas::vector<REAL> vCoarse(nCoarse + 3);
+	vCoarse.clear();
+	m_basis.Dispatch([&](const auto& kernel) {
+		for (int nAtCoarse = 0; nAtCoarse < nCoarse; nAtCoarse++)
+		{
+			const int nCenter = m_arrCoarse[nAtCoarse];
+			const REAL x = m_arrCenterX[nCenter];
+			const REAL y = m_arrCenterY[nCenter];
+			REAL field = 0.0;
+			for (int nAt = 0; nAt < nCenters; nAt++)
+			{
+				const REAL dx = x - m_arrCenterX[nAt];
+				const REAL dy = y - m_arrCenterY[nAt];
+				field += pV[nAt] * kernel(dx * dx + dy * dy);
+			}
+			vCoarse(nAtCoarse) = pZ[nCenter] - field;
+		}
+	});
+	ublas::lu_substitute(m_mCoarseLU, m_vCoarsePivot, vCoarse);
+	for (int nAtCoarse = 0; nAtCoarse < nCoarse; nAtCoarse++)
+	{
+		pV[m_arrCoarse[nAtCoarse]] += vCoarse(nAtCoarse);
+	}
+
+	Project(pV);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSKrylovSolver::Project
+//
+// v - Q Q' v
+//////////////////////////////////////////////////////////////////////
+inline void CTPSKrylovSolver::Project(REAL *pV) const
+{
+	const int nCenters = GetCenterCount();
+	for (int nCol = 0; nCol < 3; nCol++)
+	{
+		const REAL *pQ = m_arrQ[nCol].data();
+		REAL dot = 0.0;
+		for (int nAt = 0; nAt < nCenters; nAt++)
+		{
+			dot += pQ[nAt] * pV[nAt];
+		}
+		for (int nAt = 0; nAt < nCenters; nAt++)
+		{
+			pV[nAt] -= dot * pQ[nAt];
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSKrylovSolver::FitAffine
+//
+// the least squares a for P a = r is R^-1 Q' r
+//////////////////////////////////////////////////////////////////////
+inline void CTPSKrylovSolver::FitAffine(const REAL *pResidual, REAL *pAffine) const
+{
+	const int nCenters = GetCenterCount();
+	REAL arrQR[3];
+	for (int nCol = 0; nCol < 3; nCol++)
+	{
+		arrQR[nCol] = 0.0;
+		for (int nAt = 0; nAt < nCenters; nAt++)
+		{
+			arrQR[nCol] += m_arrQ[nCol][nAt] * pResidual[nAt];
+		}
+	}
+
+	// back substitute
+	for (int nRow = 2; nRow >= 0; nRow--)
+	{
+		REAL sum = arrQR[nRow];
+		for (int nCol = nRow + 1; nCol < 3; nCol++)
+		{
+			sum -= m_mR[nRow][nCol] * pAffine[nCol];
+		}
+		pAffine[nRow] = sum / m_mR[nRow][nRow];
+	}
+}
@@ -0,0 +1,221 @@
+//////////////////////////////////////////////////////////////////////
+// TPSSnapshot.h: interface for the CTPSSnapshot class.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+
+// math utilities
+#include "MathUtil.h"
+
+// vectors
+#include "VectorD.h"
+
+// threads for the resample loops
+#include "ThreadUtil.h"
+
+// packed field evaluation
+#include "TPSEvaluator.h"
+
+// far field evaluation for many landmarks
+#include "TPSTreeEvaluator.h"
+
+// presampled fields
+#include "DisplacementField.h"
+
+// the nearest-neighbor row kernels
+#include "ResampleKernels.h"
+
+class CTPSTransform;
+
+//////////////////////////////////////////////////////////////////////
+// class CTPSSnapshot
+//
+// a compiled, immutable copy of a CTPSTransform: the landmarks (as
+//		separate x and y arrays), the packed weights, the far field
+//		tree if it was on, and optionally the presampled field for one
+//		image size.  nothing is computed lazily, so every member is
+//		const and one snapshot can be evaluated and resampled from by
+//		any number of threads, while the transform it came from keeps
+//		being edited.  made by CTPSTransform::Compile
+//////////////////////////////////////////////////////////////////////
+class CTPSSnapshot
+{
+public:
+	// construction: an empty snapshot evaluates to zero
+	CTPSSnapshot();
+
+	// the landmarks, as they were when compiled
+	int GetLandmarkCount() const { return (int) m_arrSourceX.size(); }
+	const REAL *GetSourceX() const { return m_arrSourceX.data(); }
+	const REAL *GetSourceY() const { return m_arrSourceY.data(); }
+	const REAL *GetDestinationX() const { return m_arrDestinationX.data(); }
+	const REAL *GetDestinationY() const { return m_arrDestinationY.data(); }
+
+	// the presampled field, which is empty if none was compiled
+	const CDisplacementField& GetPresampledField() const { return m_presampledField; }
+
+	// TRUE if the presampled field is for the size
+	BOOL HasPresampledField(int width, int height) const
+	{
+		return m_presampledField.GetWidth() == width && m_presampledField.GetHeight() == height;
+	}
+
+	// the threads the resample loops spread over
+	int GetThreadCount() const { return m_nThreadCount; }
+
+	// evaluates the field at a point, as CTPSTransform::EvalPoints does
+	void Eval(const CVectorD<3>::Point_t& vPos, CVectorD<3>::Point_t& vOffset, float percent) const;
+
+	// evaluates the field at many points, from separate x and y arrays or
+	//		from interleaved x,y pairs
+	void EvalPoints(int nCount, const REAL *pX, const REAL *pY, REAL *pOffsetX, REAL *pOffsetY, float percent) const;
+	void EvalPoints(int nCount, const REAL *pXY, REAL *pOffsetXY, float percent) const;
+
+	// resample pixels, evaluating the field a row at a time
+	void ResampleRaw(LPBYTE pSrcPixels, LPBYTE pDstPixels, UINT bytesPerPixel, UINT width, UINT height, UINT stride, float percent) const;
+
+	// resample pixels with the presampled field; without a field for the
+	//		size, this is ResampleRaw
+	void ResampleRawWithField(LPBYTE pSrcPixels, LPBYTE pDstPixels, UINT bytesPerPixel, UINT width, UINT height, UINT stride, float percent) const;
+
+private:
+	// filled in by CTPSTransform::Compile
+	friend class CTPSTransform;
+
+	// the landmarks
+	std::vector<REAL> m_arrSourceX;
+	std::vector<REAL> m_arrSourceY;
+	std::vector<REAL> m_arrDestinationX;
+	std::vector<REAL> m_arrDestinationY;
+
+	// the packed weights, and the far field tree when it is used
+	CTPSEvaluator<> m_evaluator;
+	CTPSTreeEvaluator m_treeEvaluator;
+	BOOL m_bUseFarField;
+
+	// the presampled field
+	CDisplacementField m_presampledField;
+
+	// number of threads used to resample
+	int m_nThreadCount;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CTPSSnapshot::CTPSSnapshot
+//
+// constructs an empty snapshot
+//////////////////////////////////////////////////////////////////////
+inline CTPSSnapshot::CTPSSnapshot()
+	: m_bUseFarField(FALSE)
+	, m_nThreadCount(1)
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSSnapshot::Eval
+//
+// evaluates the vector field at a point
+//////////////////////////////////////////////////////////////////////
+inline void CTPSSnapshot::Eval(const CVectorD<3>::Point_t& vPos, CVectorD<3>::Point_t& vOffset, float percent) const
+{
+	bg::assign_zero(vOffset);
+
+	REAL x = vPos.get<X>(), y = vPos.get<Y>(), dx, dy;
+	EvalPoints(1, &x, &y, &dx, &dy, percent);
+	vOffset.set<X>(dx);
+	vOffset.set<Y>(dy);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSSnapshot::EvalPoints
+//
+// evaluates the vector field at an array of points, with the tree or
+//		the packed evaluator.  these run on the caller's thread, which
+//		is typically one of several sharing the snapshot
+//////////////////////////////////////////////////////////////////////
+inline void CTPSSnapshot::EvalPoints(int nCount, const REAL *pX, const REAL *pY,
+	REAL *pOffsetX, REAL *pOffsetY, float percent) const
+{
+	if (m_bUseFarField) {
+		m_treeEvaluator.EvalPoints(nCount, pX, pY, pOffsetX, pOffsetY, percent);
+	} else {
+		m_evaluator.EvalPoints(nCount, pX, pY, pOffsetX, pOffsetY, percent);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSSnapshot::EvalPoints
+//
+// evaluates the vector field at an array of interleaved points
+//////////////////////////////////////////////////////////////////////
+inline void CTPSSnapshot::EvalPoints(int nCount, const REAL *pXY, REAL *pOffsetXY, float percent) const
+{
+	if (m_bUseFarField) {
+		m_treeEvaluator.EvalPoints(nCount, pXY, pOffsetXY, percent);
+	} else {
+		m_evaluator.EvalPoints(nCount, pXY, pOffsetXY, percent);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSSnapshot::ResampleRaw
+//
+// resamples raw pixels, evaluating the field along each row.  rows are
+//		spread over the snapshot's number of threads
+//////////////////////////////////////////////////////////////////////
+inline void CTPSSnapshot::ResampleRaw(LPBYTE pSrcPixels, LPBYTE pDstPixels,
+	UINT bytesPerPixel,
+	UINT width,
+	UINT height,
+	UINT stride,
+	float percent) const
+{
+	ParallelForRows((int)height, m_nThreadCount,
+		[&](int nStartY, int nEndY) {
+			std::vector<REAL> arrX(width), arrY(width);
+			std::vector<REAL> arrSrcX(width), arrSrcY(width);
+			for (UINT dstAtX = 0; dstAtX < width; dstAtX++) {
+				arrX[dstAtX] = (REAL) dstAtX;
+			}
+
+			for (int dstAtY = nStartY; dstAtY < nEndY; dstAtY++) {
+				std::fill(arrY.begin(), arrY.end(), (REAL) dstAtY);
+				EvalPoints((int) width, arrX.data(), arrY.data(), arrSrcX.data(), arrSrcY.data(), percent);
+				for (UINT dstAtX = 0; dstAtX < width; dstAtX++) {
+					arrSrcX[dstAtX] += arrX[dstAtX];
+					arrSrcY[dstAtX] += arrY[dstAtX];
+				}
+
+				ResampleRowNearest(pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride,
+					dstAtY, arrSrcX.data(), arrSrcY.data());
+			}
+		});
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSSnapshot::ResampleRawWithField
+//
+// resamples raw pixels using the presampled vector field
+//////////////////////////////////////////////////////////////////////
+inline void CTPSSnapshot::ResampleRawWithField(LPBYTE pSrcPixels, LPBYTE pDstPixels,
+	UINT bytesPerPixel,
+	UINT width,
+	UINT height,
+	UINT stride,
+	float percent) const
+{
+	if (!HasPresampledField((int) width, (int) height)) {
+		ResampleRaw(pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride, percent);
+		return;
+	}
+
+	ParallelForRows((int)height, m_nThreadCount,
+		[&](int nStartY, int nEndY) {
+			ResampleRowsWithField(m_presampledField, pSrcPixels, pDstPixels, bytesPerPixel,
+				width, height, stride, percent, nStartY, nEndY);
+		});
+}
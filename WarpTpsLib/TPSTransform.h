@@ -7,12 +7,65 @@
 
 #pragma once
 
+#include <memory>
+
 // vector includes
 #include "VectorD.h"
 
 // model object base class
 #include "ModelObject.h"
 
+// worker thread helpers
+#include "ThreadUtil.h"
+
+// radial basis kernels
+#include "RadialBasis.h"
+
+// packed field evaluation
+#include "TPSEvaluator.h"
+
+// far field evaluation for many landmarks
+#include "TPSTreeEvaluator.h"
+
+// iterative solve for many landmarks
+#include "TPSKrylovSolver.h"
+
+// updatable LU factors
+#include "LUFactorization.h"
+
+// float LU factors with refinement in REAL
+#include "MixedPrecisionLU.h"
+
+// sparse factors, for compactly supported kernels
+#include "SparseCholesky.h"
+
+// grid of landmarks, to find those within a support radius
+#include "PointGrid.h"
+
+// cached per-landmark fields
+#include "BasisFieldCache.h"
+
+// presampled field storage
+#include "DisplacementField.h"
+
+// row kernels specialized by pixel size
+#include "ResampleKernels.h"
+
+// immutable compiled copies, for concurrent evaluation
+#include "TPSSnapshot.h"
+
+// size, in pixels, of the coarsest cells of the presample lattice
+const int PRESAMPLE_LATTICE_CELL = 32;
+
+// largest error bound, in pixels, at which a single precision presample
+//		is kept in float; half the default step of FORMAT_FIXED16
+const REAL SINGLE_PRECISION_MAX_ERROR = 1.0 / 64.0;
+
+// fewest entries of L in each band of rows that AssembleL hands to a
+//		thread, so that small matrices are assembled on the caller's
+//		thread
+const int ASSEMBLE_L_BAND_ENTRIES = 32768;
+
 //////////////////////////////////////////////////////////////////////
 // class CTPSTransform
 // 
@@ -29,8 +82,9 @@ public:
 	// landmark accessors
 	int GetLandmarkCount();
 
+	// returns a copy of a landmark
 	template<int DATASET>
-	const CVectorD<3>& GetLandmark(int nIndex);
+	CVectorD<3> GetLandmark(int nIndex);
 
 	typedef std::tuple<CVectorD<3>::Point_t, CVectorD<3>::Point_t> LandmarkTuple_t;
 	const LandmarkTuple_t CTPSTransform::GetLandmarkTuple(int nIndex);
@@ -45,28 +99,231 @@ public:
 	int AddLandmark(const CVectorD<3>& vLandmark1, 
 		const CVectorD<3>& vLandmark2);
 
+	// adds nCount landmarks from interleaved x,y source and destination
+	//		pairs, as one update; returns the index of the first
+	int AddLandmarks(int nCount, const REAL *pSourceXY, const REAL *pDestXY);
+
+	// brackets a batch of landmark (and basis) edits.  the edits only 
+	// record what changed, as they always do; in between, nothing is
+	// recalculated, and Eval, EvalPoints and the Resample functions keep
+	// evaluating the weights and field from before the batch, so a half
+	// edited set of landmarks is never solved or seen.  after EndUpdate,
+	// the next evaluation solves once for the whole batch, by the
+	// cheapest of a weights-only solve (only destinations moved), updates
+	// of the factors, or a refactor.  updates nest
+	void BeginUpdate() { m_nUpdateDepth++; }
+	void EndUpdate();
+	BOOL IsUpdating() const { return m_nUpdateDepth > 0; }
+
+	// removes one landmark; the indices of later landmarks shift down
+	void RemoveLandmark(int nIndex);
+
 	// removes all landmarks from the transform
 	void RemoveAllLandmarks();
 
-	// sets the r-param
+	// sets the r-param.  the basis selects a specialized kernel for
+	// integer exponents, with the fastest one for the default of 2
 	void SetRExponent(float r_exp) 
 	{ 
-		m_r_exp = r_exp; 
+		m_basis.SetRExponent(r_exp);
+		m_bRecalcMatrix = TRUE;
 		m_bRecalc = TRUE;
 		m_bRecalcPresample = TRUE;
 	}
 
 	void SetK(float k)
 	{
-		m_k = k;
+		m_basis.SetK(k);
+		m_bRecalcMatrix = TRUE;
+		m_bRecalc = TRUE;
+		m_bRecalcPresample = TRUE;
+	}
+
+	// sets a support radius (0, the default, for the global r^r_exp basis)
+	// and continuity (2 or 4) for a compactly supported Wendland basis.  a
+	// landmark then only moves the pixels within the radius of it, L is
+	// sparse and is solved by a sparse factorization, and evaluation only
+	// visits the nearby landmarks, so the cost follows the local density
+	// of the landmarks rather than their number.  the far field tree and
+	// the iterative solve are not used with it
+	void SetSupportRadius(REAL radius, int nContinuity = 2)
+	{
+		m_basis.SetSupportRadius(radius, nContinuity);
+		m_bRecalcMatrix = TRUE;
+		m_bRecalc = TRUE;
+		m_bRecalcPresample = TRUE;
+	}
+	REAL GetSupportRadius() const { return m_basis.GetSupportRadius(); }
+
+	// selects the kernel: the polyharmonic r^r_exp * log(r) of SetRExponent
+	// (the default), or with a length scale c, CRadialBasis::GAUSSIAN,
+	// MULTIQUADRIC or INVERSE_MULTIQUADRIC, or a Wendland kernel with c as
+	// its support radius.  each kernel is a small policy type with a scalar
+	// and a block form, and the evaluation loops are instantiated for each
+	void SetKernel(CRadialBasis::KernelType type, REAL scale)
+	{
+		m_basis.SetKernel(type, scale);
+		m_bRecalcMatrix = TRUE;
+		m_bRecalc = TRUE;
+		m_bRecalcPresample = TRUE;
+	}
+	CRadialBasis::KernelType GetKernelType() const { return m_basis.GetKernelType(); }
+	REAL GetKernelScale() const { return m_basis.GetScale(); }
+
+	// sets the number of threads used to resample (1 = serial, 0 = all cores).
+	// the resampled pixels are identical for any thread count
+	void SetThreadCount(int nThreads) { m_nThreadCount = nThreads; }
+	int GetThreadCount() const { return m_nThreadCount; }
+
+	// sets the memory budget (in bytes, 0 = off) for caching the field of
+	// each landmark whose destination moves.  with the field cached, moving
+	// that destination again updates the presampled field by a scaled add
+	// instead of a full presample
+	void SetBasisFieldCacheSize(size_t nBytes) { m_basisFields.SetBudget(nBytes); }
+	size_t GetBasisFieldCacheSize() const { return m_basisFields.GetBudget(); }
+
+	// sets how ResampleRawWithField stores the presampled field: doubles
+	// (the default), floats, or 16-bit fixed point in steps of 1/subpixels.
+	// floats take a third, and fixed point a sixth, of the memory of the
+	// three doubles per pixel a field used to take
+	void SetFieldFormat(CDisplacementField::Format format, REAL subpixels = 32.0)
+	{
+		m_presampledField.SetFormat(format, subpixels);
+		m_bPresampledForL = FALSE;
+		m_bRecalcPresample = TRUE;
+	}
+	CDisplacementField::Format GetFieldFormat() const { return m_presampledField.GetFormat(); }
+
+	// sets whether the presample sums the field in float rather than double.
+	// the weights are still solved in double, and the landmarks are moved to
+	// their centroid (and, for thin plates, to a unit near the image size)
+	// before narrowing.  for a smooth warp of an image a few thousand pixels
+	// across the field then stays within about 1e-3 pixel of the double one.
+	// if the bound on the error for the image is over 1/64 pixel (when the
+	// weights are large, for a rough warp) the presample stays in double.
+	// the far field tree, Eval and EvalPoints are always in double
+	void SetSinglePrecision(BOOL bSingle)
+	{
+		m_bSinglePrecision = bSingle;
+		m_bRecalc = TRUE;
+		m_bPresampledForL = FALSE;
+		m_bRecalcPresample = TRUE;
+	}
+	BOOL GetSinglePrecision() const { return m_bSinglePrecision; }
+
+	// sets the tolerance (in pixels) for presampling on an adaptive lattice.
+	// with a tolerance, the field is evaluated exactly only at the corners
+	// of cells that are refined until bilinear interpolation is within it.
+	// 0, the default, evaluates the field at every pixel
+	void SetPresampleTolerance(REAL tolerance)
+	{
+		m_presampleTolerance = tolerance;
+		m_bPresampledForL = FALSE;
+		m_bRecalcPresample = TRUE;
+	}
+	REAL GetPresampleTolerance() const { return m_presampleTolerance; }
+
+	// sets the opening ratio (0 = off, the default) for evaluating the field
+	// with a tree of far field expansions.  with thousands of landmarks, the
+	// presample, EvalPoints and ResampleRaw then cost O(log n) per point
+	// rather than O(n).  the error goes as theta^17; with 0.5, the field is
+	// within 1e-4 pixels of the exact one in the tests
+	void SetFarFieldTheta(REAL theta)
+	{
+		m_farFieldTheta = theta;
+		m_bRecalc = TRUE;
+		m_bPresampledForL = FALSE;
+		m_bRecalcPresample = TRUE;
+	}
+	REAL GetFarFieldTheta() const { return m_farFieldTheta; }
+
+	// sets the landmark count (0 = never, the default) from which the
+	// weights are solved by preconditioned GMRES, with products of K from
+	// the packed evaluator (or the far field tree, when it is on), instead
+	// of factoring the dense L.  each solve starts from the last weights.
+	// if GMRES does not converge, L is factored as before
+	void SetIterativeSolveThreshold(int nLandmarks)
+	{
+		m_nIterativeSolveThreshold = nLandmarks;
+		m_bRecalc = TRUE;
+		m_bPresampledForL = FALSE;
+		m_bRecalcPresample = TRUE;
+	}
+	int GetIterativeSolveThreshold() const { return m_nIterativeSolveThreshold; }
+
+	// the GMRES iterations of the last iterative solve
+	int GetIterativeSolveIterations() const { return m_krylovSolver.GetIterationCount(); }
+
+	// sets the landmark count (0 = never, the default) from which L is
+	// equilibrated and factored in float, and each solve is refined in
+	// REAL to full accuracy.  the factors are only redone when the source
+	// landmarks change.  if the refinement does not converge, L is
+	// factored in REAL as before
+	void SetMixedPrecisionThreshold(int nLandmarks)
+	{
+		m_nMixedPrecisionThreshold = nLandmarks;
+		m_bRecalc = TRUE;
+		m_bPresampledForL = FALSE;
+		m_bRecalcPresample = TRUE;
+	}
+	int GetMixedPrecisionThreshold() const { return m_nMixedPrecisionThreshold; }
+
+	// the backward error reached by the last mixed precision solve, and
+	// the estimated condition number of the equilibrated L
+	REAL GetMixedPrecisionResidual() const { return m_mixedLU.GetResidual(); }
+	REAL GetConditionEstimate() const { return m_mixedLU.GetConditionEstimate(); }
+
+	// sets the number of kernel centers (0 = off, the default) for an
+	// approximate TPS.  with more landmarks than that, the centers are 
+	// picked from the source landmarks by farthest point sampling, and
+	// the weights fit all of the landmarks in the least squares sense,
+	// plus lambda times the bending energy.  the fit costs O(n m^2) and
+	// evaluating it O(m) per point, so dense correspondences are cheap;
+	// the landmarks are then only approximately matched
+	void SetApproximateCenterCount(int nCenters)
+	{
+		m_nApproximateCenters = nCenters;
+		m_bRecalc = TRUE;
+		m_bPresampledForL = FALSE;
+		m_bRecalcPresample = TRUE;
+	}
+	int GetApproximateCenterCount() const { return m_nApproximateCenters; }
+
+	void SetApproximateRegularization(REAL lambda)
+	{
+		m_approximateLambda = lambda;
 		m_bRecalc = TRUE;
+		m_bPresampledForL = FALSE;
 		m_bRecalcPresample = TRUE;
 	}
+	REAL GetApproximateRegularization() const { return m_approximateLambda; }
+
+	// presamples the field for the size, if it is not current, and returns it
+	const CDisplacementField& GetPresampledField(int width, int height)
+	{
+		Presample(width, height);
+		return m_presampledField;
+	}
+
+	// compiles the current weights, and with a size the presampled field
+	// for it, into an immutable snapshot.  during an update the weights are
+	// still those from before it, while the landmarks are not, so nothing
+	// is compiled and the result is null.  Eval and the Resample functions
+	// here update the weights and field lazily, so a transform can only be
+	// used by one thread at a time; a snapshot is const throughout, so
+	// many threads can render from it while this transform keeps changing
+	std::shared_ptr<const CTPSSnapshot> Compile(int width = 0, int height = 0);
 
 	// evaluates the field at a point
 	// returns the offset vector, so the mapped point can be derived by adding the position and offset
 	void Eval(const CVectorD<3>::Point_t& vPos, CVectorD<3>::Point_t& vOffset, float percent);
 
+	// evaluates the field at many points at once, from separate x and y
+	// arrays or from interleaved x,y pairs.  each offset is exactly the one
+	// Eval returns for that point
+	void EvalPoints(int nCount, const REAL *pX, const REAL *pY, REAL *pOffsetX, REAL *pOffsetY, float percent);
+	void EvalPoints(int nCount, const REAL *pXY, REAL *pOffsetXY, float percent);
+
 	// resample pixels
 	void ResampleRaw(LPBYTE pSrcPixels, LPBYTE pDstPixels, UINT bytesPerPixel, UINT width, UINT height, UINT stride, float percent);
 
@@ -77,33 +334,214 @@ protected:
 	// recalculates the TPS from the landmarks
 	void RecalcWeights();
 
+	// assembles and factorizes L from scratch, one slot per landmark
+	void RefactorL();
+
+	// assembles L for n landmarks in consecutive slots after the affine
+	//		rows
+	void AssembleL(int n, const REAL *pX, const REAL *pY, ublas::matrix<REAL>& mL) const;
+
+	// brings the factors up to date with added and removed landmarks;
+	//		returns FALSE if a full refactor is needed instead
+	BOOL UpdateL();
+
+	// solves for the weights by GMRES; returns FALSE if it did not
+	//		converge
+	BOOL SolveIterative(const std::vector<REAL>& arrLandmarkX, const std::vector<REAL>& arrLandmarkY);
+
+	// solves for the weights with float factors of L and refinement in
+	//		REAL; returns FALSE if the refinement did not converge
+	BOOL SolveMixedPrecision(const std::vector<REAL>& arrLandmarkX, const std::vector<REAL>& arrLandmarkY);
+
+	// solves for the weights of a compactly supported basis by a sparse
+	//		factorization of K; returns FALSE if K is not positive definite
+	//		or the landmarks are collinear
+	BOOL SolveSparse(const std::vector<REAL>& arrLandmarkX, const std::vector<REAL>& arrLandmarkY);
+
+	// picks the approximate centers, and fits their weights to the
+	//		landmarks; returns FALSE if the fit is singular
+	BOOL SolveApproximate(const std::vector<REAL>& arrLandmarkX, const std::vector<REAL>& arrLandmarkY);
+
+	// picks nCenters of the landmarks, each the farthest from those
+	//		already picked
+	void SelectApproximateCenters(const std::vector<REAL>& arrLandmarkX, 
+		const std::vector<REAL>& arrLandmarkY, int nCenters);
+
+	// computes the x- and y-direction heights in slot order
+	void CalcHeights(ublas::matrix<REAL>& mH);
+
+	// solves L W = H in slot order; returns FALSE if updated factors no
+	//		longer solve L accurately
+	BOOL SolveL(const ublas::matrix<REAL>& mH, ublas::matrix<REAL>& mW);
+
+	// replaces the row and column of a slot in m_mL
+	void SetSlotColumn(int nSlot, const ublas::vector<REAL>& vCol);
+
+	// computes the column of L for a source landmark at (x, y) held in
+	//		nSlot, against the first nSize slots of the factors
+	void CalcSlotColumn(REAL x, REAL y, int nSlot, int nSize, ublas::vector<REAL>& vCol);
+
 	// used to construct the presampled vector field
 	void Presample(int width, int height);
 
+	// TRUE if the field is evaluated with the far field tree, which is 
+	//		only for global kernels
+	BOOL UseFarField() const { return m_farFieldTheta > 0.0 && !m_basis.IsCompact(); }
+
+	// evaluates the field with the far field tree, when it is on, or else
+	//		the packed evaluator, in float for a single precision presample
+	//		within its error bound
+	void EvalFieldRow(REAL y, REAL x0, int nCount, REAL *pDx, REAL *pDy) const;
+	void EvalFieldPoint(REAL x, REAL y, REAL& dx, REAL& dy) const { EvalFieldRow(y, x, 1, &dx, &dy); }
+
+	// presamples on a lattice of cells refined to the tolerance
+	void PresampleLattice(int width, int height);
+
+	// fills the pixels [x0, x1) x [y0, y1) of a cell from the offsets at its
+	//		corners (00, 10, 01, 11), refining while the estimated error of 
+	//		bilinear interpolation is over the tolerance
+	void PresampleCell(int x0, int y0, int x1, int y1, const REAL arrCornerDx[4], const REAL arrCornerDy[4]);
+
+	// brings the presampled field up to date by adding the cached fields
+	//		of the landmarks whose destinations moved; returns FALSE if a
+	//		full presample is needed instead
+	BOOL UpdatePresampleFromBasisFields();
+
+	// evaluates the field of a landmark with a unit height (the field 
+	//		that moving its destination adds) at every presampled pixel
+	BOOL CalcBasisField(int nLandmark, float *pField);
+
+	// resamples the destination rows [nStartY, nEndY) for ResampleRaw
+	void ResampleRawRows(LPBYTE pSrcPixels, LPBYTE pDstPixels, UINT bytesPerPixel, UINT width, UINT height, UINT stride, float percent,
+		int nStartY, int nEndY);
+
 private:
-	// the array of landmarks
-	vector<tuple<CVectorD<3>, CVectorD<3>>> m_arrLandmarkTuples;
+	// a landmark, in place, for the internal math
+	template<int DATASET>
+	const CFixedVector<3>& GetFixedLandmark(int nIndex) const;
 
-	// represents the pre-sampled array
-	vector<CVectorD<3>::Point_t> m_presampledOffsets;
-	int m_presampledWidth;
-	int m_presampledHeight;
+	// the array of landmarks, as trivially copyable vectors
+	vector<tuple<CFixedVector<3>, CFixedVector<3>>> m_arrLandmarkTuples;
 
-	// stores the inverse of the distance matrix
-	ublas::matrix<REAL> m_mL_inv;
+	// the source landmarks as separate x and y arrays, kept in step with
+	//		m_arrLandmarkTuples by every edit, for the solvers and the
+	//		packed evaluators
+	vector<REAL> m_arrSourceX;
+	vector<REAL> m_arrSourceY;
+
+	// represents the pre-sampled array
+	CDisplacementField m_presampledField;
+
+	// the heights the presampled field was last brought up to date with,
+	// and whether it is still for the current L
+	vector<REAL> m_arrPresampledHeightX;
+	vector<REAL> m_arrPresampledHeightY;
+	BOOL m_bPresampledForL;
+
+	// the number of cached-field updates since the last full presample
+	int m_nBasisFieldUpdates;
+
+	// the interpolation tolerance for presampling, or 0 for every pixel
+	REAL m_presampleTolerance;
+
+	// the far field tree, and its opening ratio (0 when it is off)
+	CTPSTreeEvaluator m_treeEvaluator;
+	REAL m_farFieldTheta;
+
+	// the iterative solver, the landmark count from which it is used (0
+	//		for never), and whether the current weights came from it.  
+	//		its centers and basis are kept to tell when its
+	//		preconditioner has to be rebuilt
+	CTPSKrylovSolver m_krylovSolver;
+	int m_nIterativeSolveThreshold;
+	BOOL m_bSolvedIteratively;
+	std::vector<REAL> m_arrKrylovCenterX;
+	std::vector<REAL> m_arrKrylovCenterY;
+	CRadialBasis m_krylovBasis;
+
+	// the mixed precision factors of L, the landmark count from which
+	//		they are used (0 for never), whether the current weights came
+	//		from them, and the landmarks and basis they were factored for
+	CMixedPrecisionLU m_mixedLU;
+	int m_nMixedPrecisionThreshold;
+	BOOL m_bSolvedMixed;
+	std::vector<REAL> m_arrMixedX;
+	std::vector<REAL> m_arrMixedY;
+	CRadialBasis m_mixedBasis;
+
+	// the sparse factors of K for a compactly supported basis, whether
+	//		the current weights came from them, the landmarks and basis
+	//		they were factored for, and K^-1 times the affine columns
+	//		(1, x - x0, y - y0) about the centroid
+	CSparseCholesky m_sparseCholesky;
+	BOOL m_bSolvedSparse;
+	std::vector<REAL> m_arrSparseX;
+	std::vector<REAL> m_arrSparseY;
+	CRadialBasis m_sparseBasis;
+	std::vector<REAL> m_arrSparseAffine;
+
+	// the approximate center count (0 for off) and regularization, and
+	//		whether the current weights are for the approximate centers
+	int m_nApproximateCenters;
+	REAL m_approximateLambda;
+	BOOL m_bApproximated;
+	std::vector<REAL> m_arrApproximateCenterX;
+	std::vector<REAL> m_arrApproximateCenterY;
+
+	// the per-landmark fields, valid while L is unchanged
+	CBasisFieldCache m_basisFields;
+
+	// stores the LU factorization of L in slot order: the three affine
+	// rows first, then one slot per landmark.  the factors are updated in
+	// place as landmarks are added and removed; a removed landmark's slot
+	// becomes an identity row until a new landmark takes it over
+	CLUFactorization m_factorization;
+
+	// the assembled L in slot order, kept (and edited along with the
+	// factors) to check and refine the solutions of updated factors
+	ublas::matrix<REAL> m_mL;
+
+	// the slot of each landmark, or -1 if it is not yet in the factors
+	vector<int> m_arrLandmarkSlot;
+
+	// the source position each slot was factored with, and whether the
+	// slot holds a landmark
+	vector<REAL> m_arrSlotX;
+	vector<REAL> m_arrSlotY;
+	vector<BOOL> m_arrSlotUsed;
+
+	// slots given up by removed (or moved) landmarks, which still hold
+	// their old columns, and identity slots ready for reuse
+	vector<int> m_arrRemovedSlots;
+	vector<int> m_arrFreeSlots;
 
 	// the final weight vectors
 	ublas::vector<REAL> m_vWx;
 	ublas::vector<REAL> m_vWy;
 
-	// the radial basis exponent
-	float m_r_exp;
-	float m_k;
+	// packed copy of the source landmarks and weights, used by Presample
+	// and EvalPoints
+	CTPSEvaluator<> m_evaluator;
+
+	// and in float, for a single precision presample, with whether the
+	//		last presample was within its error bound
+	BOOL m_bSinglePrecision;
+	CTPSEvaluator<float> m_evaluatorSingle;
+	BOOL m_bPresampleSingle;
+
+	// the radial basis (exponent and scale)
+	CRadialBasis m_basis;
 
 	// flag to indicate that recalculation of the TPS is needed
 	BOOL m_bRecalcMatrix;
 	BOOL m_bRecalc;
 	BOOL m_bRecalcPresample;
+
+	// the nesting depth of BeginUpdate
+	int m_nUpdateDepth;
+
+	// number of threads used to resample
+	int m_nThreadCount;
 };
 
 
@@ -111,21 +549,22 @@ private:
 //////////////////////////////////////////////////////////////////////
 // distance_function
 // 
-// returns the log-distance squared betweeen two landmarks
+// returns the radial basis of the distance betweeen two landmarks
 //////////////////////////////////////////////////////////////////////
-inline double distance_function(const CVectorD<3>::Point_t& vL1, const CVectorD<3>::Point_t& vL2, const REAL k = 1.0, REAL r_exp = 2.0)
+inline double distance_function(const CVectorD<3>::Point_t& vL1, const CVectorD<3>::Point_t& vL2, const CRadialBasis& basis)
 {
-	// compute the euclidean distance
+	// compute the squared euclidean distance
 	auto diff = vL1;
 	bg::subtract_point(diff, vL2);
-	double r = sqrt(diff.get<X>()*diff.get<X>() + diff.get<Y>()*diff.get<Y>());
+	double r2 = diff.get<X>()*diff.get<X>() + diff.get<Y>()*diff.get<Y>();
+
+	// the basis selects its kernel from the exponent
+	return basis(r2);
+}
 
-#ifdef SQUARE_ONLY
-	// pass through the log-squared
-	return (r > 0.0) ? (k * r * r * log(r)) : 0.0;
-#else
-	return (r > 0.0) ? (k * pow(r, r_exp) * log(r)) : 0.0;
-#endif
+inline double distance_function(const CVectorD<3>::Point_t& vL1, const CVectorD<3>::Point_t& vL2, const REAL k = 1.0, REAL r_exp = 2.0)
+{
+	return distance_function(vL1, vL2, CRadialBasis(k, r_exp));
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -138,13 +577,25 @@ inline double distance_function(const CVectorD<3>::Point_t& vL1, const CVectorD<
 // constructs a CTPSTransform object with the given name
 //////////////////////////////////////////////////////////////////////
 inline CTPSTransform::CTPSTransform()
-	: m_bRecalcMatrix(TRUE)
+	: m_bPresampledForL(FALSE)
+	, m_nBasisFieldUpdates(0)
+	, m_presampleTolerance(0.0)
+	, m_farFieldTheta(0.0)
+	, m_nIterativeSolveThreshold(0)
+	, m_bSolvedIteratively(FALSE)
+	, m_nMixedPrecisionThreshold(0)
+	, m_bSolvedMixed(FALSE)
+	, m_bSolvedSparse(FALSE)
+	, m_nApproximateCenters(0)
+	, m_approximateLambda(0.0)
+	, m_bApproximated(FALSE)
+	, m_bSinglePrecision(FALSE)
+	, m_bPresampleSingle(FALSE)
+	, m_bRecalcMatrix(TRUE)
 	, m_bRecalc(TRUE)
 	, m_bRecalcPresample(TRUE)
-	, m_presampledWidth(0)
-	, m_presampledHeight(0)
-	, m_k(1.0)
-	, m_r_exp(2.0)
+	, m_nUpdateDepth(0)
+	, m_nThreadCount(1)
 {
 }
 
@@ -170,10 +621,21 @@ inline int CTPSTransform::GetLandmarkCount()
 //////////////////////////////////////////////////////////////////////
 // CTPSTransform::GetLandmark
 // 
-// returns a landmark
+// returns a copy of a landmark
+//////////////////////////////////////////////////////////////////////
+template<int DATASET>
+inline CVectorD<3> CTPSTransform::GetLandmark(int nIndex)
+{
+	return CVectorD<3>(GetFixedLandmark<DATASET>(nIndex));
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::GetFixedLandmark
+// 
+// returns a landmark as it is stored
 //////////////////////////////////////////////////////////////////////
 template<int DATASET>
-inline const CVectorD<3>& CTPSTransform::GetLandmark(int nIndex)
+inline const CFixedVector<3>& CTPSTransform::GetFixedLandmark(int nIndex) const
 {
 	return std::get<DATASET>(m_arrLandmarkTuples[nIndex]);
 }
@@ -186,9 +648,9 @@ inline const CVectorD<3>& CTPSTransform::GetLandmark(int nIndex)
 inline const CTPSTransform::LandmarkTuple_t
 	CTPSTransform::GetLandmarkTuple(int nIndex)
 {
-	CVectorD<3, REAL> vL0, vL1;
-	std::tie(vL0, vL1) = m_arrLandmarkTuples[nIndex];
-	return std::make_tuple(vL0.point(), vL1.point());
+	const CFixedVector<3>& vL0 = GetFixedLandmark<0>(nIndex);
+	const CFixedVector<3>& vL1 = GetFixedLandmark<1>(nIndex);
+	return std::make_tuple(Point_t(vL0[X], vL0[Y], vL0[Z]), Point_t(vL1[X], vL1[Y], vL1[Z]));
 }
 
 
@@ -200,12 +662,23 @@ inline const CTPSTransform::LandmarkTuple_t
 template<int DATASET>
 inline void CTPSTransform::SetLandmark(int nIndex, const CVectorD<3>& vLandmark)
 {
-	std::get<DATASET>(m_arrLandmarkTuples[nIndex]) = vLandmark;
-
-	// only recalc matrix if it is dataset 0
+	CFixedVector<3>& vOldLandmark = std::get<DATASET>(m_arrLandmarkTuples[nIndex]);
+	BOOL bSourceMoved = (DATASET == 0)
+		&& (vOldLandmark[0] != vLandmark[0] || vOldLandmark[1] != vLandmark[1]);
+	vOldLandmark = vLandmark.GetFixed();
 	if (DATASET == 0)
 	{
-		m_bRecalcMatrix = TRUE;
+		m_arrSourceX[nIndex] = vLandmark[0];
+		m_arrSourceY[nIndex] = vLandmark[1];
+	}
+
+	// only the matrix changes if it is dataset 0, and then only in one row
+	//		and column: the landmark gives up its slot, and takes one again
+	//		at the next recalc with a rank-2 update of the factors
+	if (bSourceMoved && m_arrLandmarkSlot[nIndex] >= 0)
+	{
+		m_arrRemovedSlots.push_back(m_arrLandmarkSlot[nIndex]);
+		m_arrLandmarkSlot[nIndex] = -1;
 	}
 
 	// set the flag to indicate recalculation is needed
@@ -218,10 +691,12 @@ inline void CTPSTransform::SetLandmarkTuple(int nIndex, CTPSTransform::LandmarkT
 {
 	Point_t pt0, pt1;
 	std::tie(pt0, pt1) = toTuple;
+	BeginUpdate();
 	CVectorD<3, REAL> v0(pt0.get<X>(), pt0.get<Y>(), pt0.get<Z>());
 	SetLandmark<0>(nIndex, v0);
 	CVectorD<3, REAL> v1(pt1.get<X>(), pt1.get<Y>(), pt1.get<Z>());
 	SetLandmark<1>(nIndex, v1);
+	EndUpdate();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -244,10 +719,14 @@ inline int CTPSTransform::AddLandmark(const CVectorD<3>& vLandmark1,
 	const CVectorD<3>& vLandmark2)
 {
 	// add the landmark as a tuple
-	m_arrLandmarkTuples.push_back(std::make_tuple(vLandmark1, vLandmark2));
+	m_arrLandmarkTuples.push_back(std::make_tuple(vLandmark1.GetFixed(), vLandmark2.GetFixed()));
+	m_arrSourceX.push_back(vLandmark1[0]);
+	m_arrSourceY.push_back(vLandmark1[1]);
+
+	// the landmark gets its slot in the factors at the next recalc
+	m_arrLandmarkSlot.push_back(-1);
 
 	// set the flag to indicate recalculation is needed
-	m_bRecalcMatrix = TRUE;
 	m_bRecalc = TRUE;
 	m_bRecalcPresample = TRUE;
 
@@ -255,6 +734,72 @@ inline int CTPSTransform::AddLandmark(const CVectorD<3>& vLandmark1,
 	return GetLandmarkCount() - 1;
 }
 
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::AddLandmarks
+// 
+// adds the landmarks in one batch, each waiting for its slot in the
+//		factors at the next recalc
+//////////////////////////////////////////////////////////////////////
+inline int CTPSTransform::AddLandmarks(int nCount, const REAL *pSourceXY, const REAL *pDestXY)
+{
+	const int nFirst = GetLandmarkCount();
+
+	BeginUpdate();
+	m_arrLandmarkTuples.reserve(nFirst + nCount);
+	m_arrSourceX.reserve(nFirst + nCount);
+	m_arrSourceY.reserve(nFirst + nCount);
+	m_arrLandmarkSlot.reserve(nFirst + nCount);
+	for (int nAt = 0; nAt < nCount; nAt++) {
+		AddLandmark(CVectorD<3>(pSourceXY[2 * nAt + 0], pSourceXY[2 * nAt + 1]),
+			CVectorD<3>(pDestXY[2 * nAt + 0], pDestXY[2 * nAt + 1]));
+	}
+	EndUpdate();
+
+	return nFirst;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::EndUpdate
+// 
+// closes a batch of edits.  a field presampled during the batch (for
+//		a new size) was for the weights from before it, so if anything
+//		changed it is presampled again.  an EndUpdate with no batch 
+//		open does nothing
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::EndUpdate()
+{
+	if (m_nUpdateDepth == 0) {
+		return;
+	}
+	m_nUpdateDepth--;
+	if (m_nUpdateDepth == 0 && m_bRecalc) {
+		m_bRecalcPresample = TRUE;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::RemoveLandmark
+// 
+// removes a landmark from the TPS.  its slot is cleared from the
+//		factors at the next recalc
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::RemoveLandmark(int nIndex)
+{
+	m_arrLandmarkTuples.erase(m_arrLandmarkTuples.begin() + nIndex);
+	m_arrSourceX.erase(m_arrSourceX.begin() + nIndex);
+	m_arrSourceY.erase(m_arrSourceY.begin() + nIndex);
+
+	if (m_arrLandmarkSlot[nIndex] >= 0)
+	{
+		m_arrRemovedSlots.push_back(m_arrLandmarkSlot[nIndex]);
+	}
+	m_arrLandmarkSlot.erase(m_arrLandmarkSlot.begin() + nIndex);
+
+	// set the flag to indicate recalculation is needed
+	m_bRecalc = TRUE;
+	m_bRecalcPresample = TRUE;
+}
+
 //////////////////////////////////////////////////////////////////////
 // CTPSTransform::RemoveAllLandmarks
 // 
@@ -263,6 +808,9 @@ inline int CTPSTransform::AddLandmark(const CVectorD<3>& vLandmark1,
 inline void CTPSTransform::RemoveAllLandmarks()
 {
 	m_arrLandmarkTuples.clear();
+	m_arrSourceX.clear();
+	m_arrSourceY.clear();
+	m_arrLandmarkSlot.clear();
 
 	m_bRecalcMatrix = TRUE;
 	m_bRecalc = TRUE;
@@ -279,16 +827,6 @@ inline void CTPSTransform::Eval(const CVectorD<3>::Point_t& vPos, CVectorD<3>::P
 	// ensure vOffset is initialized to zero
 	bg::assign_zero(vOffset);
 
-	// start with transformed equal to input
-	// vPosTrans = vPos;
-
-	// don't compute without at least three landmarks
-	auto n = GetLandmarkCount();
-	if (n < 3)
-	{
-		return;
-	}
-
 	// see if a recalc is needed
 	if (m_bRecalc)
 	{
@@ -296,257 +834,1464 @@ inline void CTPSTransform::Eval(const CVectorD<3>::Point_t& vPos, CVectorD<3>::P
 		RecalcWeights();
 	}
 
-	// add the weight vector displacements
-	for (int nAt = 0; nAt < n; nAt++)
-	{
-		CVectorD<3, REAL>::Point_t vL0;
-		std::tie(vL0, ignore) = GetLandmarkTuple(nAt);
-
-		// distance to the first landmark
-		double d = distance_function(vPos, vL0, m_k, m_r_exp);
-
-		// add weight vector displacements
-		CVectorD<3,REAL>::Point_t displacement(m_vWx(nAt), m_vWy(nAt));
-		bg::multiply_value(displacement, d * percent);
-		bg::add_point(vOffset, displacement);
-	}
-
-	// add the affine displacements
-	bg::add_point(vOffset, CVectorD<3, REAL>::Point_t(m_vWx(n + 0), m_vWy(n + 0)));
-
-	CVectorD<3, REAL>::Point_t weightx(m_vWx(n + 1), m_vWy(n + 1));
-	bg::multiply_value(weightx, vPos.get<X>());
-	bg::add_point(vOffset, weightx);
-
-	CVectorD<3, REAL>::Point_t weighty(m_vWx(n + 2), m_vWy(n + 2));
-	bg::multiply_value(weighty, vPos.get<Y>());
-	bg::add_point(vOffset, weighty);
+	// the packed evaluator holds the centers and weights as flat arrays,
+	//		so nothing is built per landmark.  it also knows the 
+	//		approximate centers, sums only the nearby landmarks of a
+	//		compact kernel, and during an update still has the landmarks
+	//		the weights are for.  with fewer than three landmarks it is
+	//		empty, and the offset is zero
+	REAL x = vPos.get<X>(), y = vPos.get<Y>(), dx, dy;
+	m_evaluator.EvalPoints(1, &x, &y, &dx, &dy, percent);
+	vOffset.set<X>(dx);
+	vOffset.set<Y>(dy);
 }
 
 
 //////////////////////////////////////////////////////////////////////
-// CTPSTransform::Resample
+// CTPSTransform::EvalPoints
 // 
-// resamples a source image through the transform
+// evaluates the vector field at an array of points, spreading blocks
+//		of points over the configured number of threads
 //////////////////////////////////////////////////////////////////////
-inline void CTPSTransform::Presample(int width, int height)
+inline void CTPSTransform::EvalPoints(int nCount, const REAL *pX, const REAL *pY, 
+	REAL *pOffsetX, REAL *pOffsetY, float percent)
 {
-	if (width != m_presampledWidth
-		|| height != m_presampledHeight) {
-		m_presampledWidth = width;
-		m_presampledHeight = height;
-		m_presampledOffsets.resize(width * height);
-		m_bRecalcPresample = TRUE;
+	// see if a recalc is needed
+	if (m_bRecalc)
+	{
+		RecalcWeights();
 	}
 
-	if (m_bRecalcPresample) {
-		// position of the destination
-		CVectorD<3>::Point_t vDstPos(0.0, 0.0, 0.0);
-
-		// for each pixel in the image
-		for (int dstAtY = 0; vDstPos.get<Y>() < height; dstAtY++) {
-			bg::set<X>(vDstPos, 0.0);
-			for (int dstAtX = 0; vDstPos.get<X>() < width; dstAtX++) {
-				Eval(vDstPos, m_presampledOffsets[dstAtY * m_presampledWidth + dstAtX], 1.0);
-				bg::set<X>(vDstPos, vDstPos.get<X>() + 1.0);
+	// each block of points is one "row" for the workers
+	const int nBlocks = (nCount + CTPSEvaluator<>::POINT_BLOCK - 1) / CTPSEvaluator<>::POINT_BLOCK;
+	ParallelForRows(nBlocks, m_nThreadCount,
+		[&](int nStartBlock, int nEndBlock) {
+			int nStart = nStartBlock * CTPSEvaluator<>::POINT_BLOCK;
+			int nEnd = (nEndBlock * CTPSEvaluator<>::POINT_BLOCK < nCount) 
+				? nEndBlock * CTPSEvaluator<>::POINT_BLOCK : nCount;
+			if (UseFarField()) {
+				m_treeEvaluator.EvalPoints(nEnd - nStart, &pX[nStart], &pY[nStart],
+					&pOffsetX[nStart], &pOffsetY[nStart], percent);
+			} else {
+				m_evaluator.EvalPoints(nEnd - nStart, &pX[nStart], &pY[nStart],
+					&pOffsetX[nStart], &pOffsetY[nStart], percent);
 			}
-			bg::set<Y>(vDstPos, vDstPos.get<Y>() + 1.0);
-		}
-
-		m_bRecalcPresample = FALSE;
-	}
+		});
 }
 
-//
-inline void CTPSTransform::ResampleRaw(LPBYTE pSrcPixels, LPBYTE pDstPixels,
-	UINT bytesPerPixel,
-	UINT width,
-	UINT height,
-	UINT stride,
-	float percent)
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::EvalPoints
+// 
+// evaluates the vector field at an array of interleaved points
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::EvalPoints(int nCount, const REAL *pXY, REAL *pOffsetXY, float percent)
 {
 	// see if a recalc is needed
-	if (m_bRecalc) {
-
-		// recalculate the weight vectors
+	if (m_bRecalc)
+	{
 		RecalcWeights();
 	}
 
-	// position of the destination
-	CVectorD<3> vDstPos;
-
-	// position of the source
-	CVectorD<3> vOffset;
-
-	// for each pixel in the image
-	for (vDstPos[1] = 0.0; vDstPos[1] < height; vDstPos[1] += 1.0)
-	{
-		for (vDstPos[0] = 0.0; vDstPos[0] < width; vDstPos[0] += 1.0)
-		{
-			Eval(vDstPos.point(), vOffset.point(), percent);
-			CVectorD<3>::Point_t vSrcPos(vDstPos.point());
-			bg::add_point(vSrcPos, vOffset.point());
-
-			// compute the destination position
-			int nDstY = height - (int)vDstPos[1] - 1;
-			int nDstIndex = bytesPerPixel * (int)vDstPos[0]
-				+ nDstY * stride;
-
-			// bounds check source position
-			int nSrcY = height - (int)floor(vSrcPos.get<Y>() + 0.5) - 1;
-			if (vSrcPos.get<X>() >= 0.0 && vSrcPos.get<X>() < width
-				&& nSrcY >= 0 && nSrcY < (int) height)
-			{
-				// compute the positions
-				int nSrcIndex = bytesPerPixel * (int)floor(vSrcPos.get<X>() + 0.5)
-					+ nSrcY * stride;
-
-				// and resample
-				memcpy(&pDstPixels[nDstIndex], &pSrcPixels[nSrcIndex],
-					bytesPerPixel);
-			}
-			else
-			{
-				// set to zero
-				memset(&pDstPixels[nDstIndex], 0, bytesPerPixel);
+	const int nBlocks = (nCount + CTPSEvaluator<>::POINT_BLOCK - 1) / CTPSEvaluator<>::POINT_BLOCK;
+	ParallelForRows(nBlocks, m_nThreadCount,
+		[&](int nStartBlock, int nEndBlock) {
+			int nStart = nStartBlock * CTPSEvaluator<>::POINT_BLOCK;
+			int nEnd = (nEndBlock * CTPSEvaluator<>::POINT_BLOCK < nCount) 
+				? nEndBlock * CTPSEvaluator<>::POINT_BLOCK : nCount;
+			if (UseFarField()) {
+				m_treeEvaluator.EvalPoints(nEnd - nStart, &pXY[2 * nStart],
+					&pOffsetXY[2 * nStart], percent);
+			} else {
+				m_evaluator.EvalPoints(nEnd - nStart, &pXY[2 * nStart],
+					&pOffsetXY[2 * nStart], percent);
 			}
-		}
-	}
+		});
 }
 
 //////////////////////////////////////////////////////////////////////
-// CTPSTransform::ResampleRawWithField
-//
-// resamples raw pixels using the presampled vector field
+// CTPSTransform::Compile
+// 
+// brings the weights (and field) up to date, then copies them with the
+//		landmarks into a new snapshot.  returns null during an update, 
+//		when the weights do not match the landmarks
 //////////////////////////////////////////////////////////////////////
-inline void CTPSTransform::ResampleRawWithField(LPBYTE pSrcPixels, LPBYTE pDstPixels,
-	UINT bytesPerPixel,
-	UINT width,
-	UINT height,
-	UINT stride,
-	float percent)
+inline std::shared_ptr<const CTPSSnapshot> CTPSTransform::Compile(int width, int height)
 {
-	// see if a recalc is needed
+	if (IsUpdating()) {
+		return nullptr;
+	}
 	if (m_bRecalc) {
-
-		// recalculate the weight vectors
 		RecalcWeights();
 	}
 
-	// if there are no landmarks, then no presampled vector field
-	if (m_bRecalcPresample
-		|| m_presampledWidth != width
-		|| m_presampledHeight != height) {
+	std::shared_ptr<CTPSSnapshot> pSnapshot = std::make_shared<CTPSSnapshot>();
+	auto n = GetLandmarkCount();
+	pSnapshot->m_arrDestinationX.resize(n);
+	pSnapshot->m_arrDestinationY.resize(n);
+	pSnapshot->m_arrSourceX = m_arrSourceX;
+	pSnapshot->m_arrSourceY = m_arrSourceY;
+	for (int nAtLandmark = 0; nAtLandmark < n; nAtLandmark++) {
+		pSnapshot->m_arrDestinationX[nAtLandmark] = GetFixedLandmark<1>(nAtLandmark)[0];
+		pSnapshot->m_arrDestinationY[nAtLandmark] = GetFixedLandmark<1>(nAtLandmark)[1];
+	}
 
-		Presample(width, height);
+	pSnapshot->m_evaluator = m_evaluator;
+	pSnapshot->m_bUseFarField = UseFarField();
+	if (pSnapshot->m_bUseFarField) {
+		pSnapshot->m_treeEvaluator = m_treeEvaluator;
 	}
 
-	CVectorD<3>::Point_t vSrcPos(0.0, 0.0, 0.0);
-	for (int dstAtY = 0; dstAtY < (int)height; dstAtY++) {
-		for (int dstAtX = 0; dstAtX < (int)width; dstAtX++) {
-			// compute the destination position
-			int nDstY = height - dstAtY - 1;
-			int nDstIndex = bytesPerPixel * dstAtX
-				+ nDstY * stride;
-
-			const CVectorD<3>::Point_t& offset = m_presampledOffsets[dstAtY * m_presampledWidth + dstAtX];
-			bg::set<0>(vSrcPos, dstAtX + ((double)percent) * offset.get<0>());
-			bg::set<1>(vSrcPos, dstAtY + ((double)percent) * offset.get<1>());
-
-			// bounds check source position
-			int nSrcY = height - (int)floor(vSrcPos.get<1>() + 0.5) - 1;
-			if (vSrcPos.get<0>() >= 0.0 && vSrcPos.get<0>() < width
-				&& nSrcY >= 0 && nSrcY < (int) height) {
-				// compute the positions
-				int nSrcIndex = bytesPerPixel * (int)floor(vSrcPos.get<0>() + 0.5)
-					+ nSrcY * stride;
-
-				// and resample
-				memcpy(&pDstPixels[nDstIndex], &pSrcPixels[nSrcIndex],
-					bytesPerPixel);
-			} else {
-				// set to zero
-				memset(&pDstPixels[nDstIndex], 0, bytesPerPixel);
-			}
-		}
+	if (width > 0 && height > 0) {
+		Presample(width, height);
+		pSnapshot->m_presampledField = m_presampledField;
 	}
 
+	pSnapshot->m_nThreadCount = m_nThreadCount;
+
+	return pSnapshot;
 }
 
 //////////////////////////////////////////////////////////////////////
-// CTPSTransform::RecalcWeights
+// CTPSTransform::Presample
 // 
-// recalcs the TPS weights from the landmarks
+// evaluates the vector field at every pixel (or on the lattice, with a
+//		tolerance), spreading the rows over the configured number of 
+//		threads.  if only destinations moved since the last presample,
+//		the cached basis fields are added instead
 //////////////////////////////////////////////////////////////////////
-inline void CTPSTransform::RecalcWeights()
+inline void CTPSTransform::Presample(int width, int height)
 {
-	auto n = GetLandmarkCount();
-	// don't compute without at least three landmarks
-	if (n < 3) {
-		return;
+	BOOL bResized = FALSE;
+	if (width != m_presampledField.GetWidth()
+		|| height != m_presampledField.GetHeight()) {
+		m_presampledField.Resize(width, height);
+		m_bRecalcPresample = TRUE;
+		bResized = TRUE;
+
+		// the basis fields are for the old size
+		m_bPresampledForL = FALSE;
+		m_basisFields.Clear();
 	}
 
-	if (m_bRecalcMatrix) {
-		// stores the L matrix
-		ublas::matrix<REAL> mL(n + 3, n + 3);
-
-		// iterate over the rows and columns of the L matrix
-		for (int nAtRow = 0; nAtRow < n; nAtRow++) {
-			for (int nAtCol = 0; nAtCol < n; nAtCol++) {				
-				if (nAtRow != nAtCol) {	// are we off-diagonal?
-					// populate the K part of the matrix
-					mL(nAtCol,nAtRow) =
-						distance_function(GetLandmark<0>(nAtRow).point(),
-							GetLandmark<0>(nAtCol).point(), m_k, m_r_exp);
-				} else {				// zeros on the diagonal
-					mL(nAtCol, nAtRow) = 0.0;
-				}
+	// during an update the field stays for the weights from before it,
+	//		unless it has to be presampled for a new size
+	if (m_bRecalcPresample && (!IsUpdating() || bResized)) {
+		// make sure the packed weights are current
+		if (m_bRecalc) {
+			RecalcWeights();
+		}
+		m_bPresampleSingle = m_bSinglePrecision && !UseFarField()
+			&& m_evaluatorSingle.CalcErrorBound(0.0, 0.0, (REAL) width - 1.0, (REAL) height - 1.0)
+				<= SINGLE_PRECISION_MAX_ERROR;
 
-				// populate the Q^T part of the matrix
-				mL(nAtCol, n + 0) = 1.0;
-				mL(nAtCol, n + 1) = GetLandmark<0>(nAtCol)[0];
-				mL(nAtCol, n + 2) = GetLandmark<0>(nAtCol)[1];
+		if (!UpdatePresampleFromBasisFields()) {
+			if (m_presampleTolerance > 0.0) {
+				PresampleLattice(width, height);
+			} else {
+				// each band of rows is evaluated by the row kernel into its own
+				//		scratch rows, then stored to its own part of the field
+				ParallelForRows(height, m_nThreadCount,
+					[&](int nStartY, int nEndY) {
+						std::vector<REAL> arrDx(width), arrDy(width);
+						for (int dstAtY = nStartY; dstAtY < nEndY; dstAtY++) {
+							EvalFieldRow((REAL) dstAtY, 0.0, width, arrDx.data(), arrDy.data());
+							m_presampledField.SetRow(dstAtY, arrDx.data(), arrDy.data());
+						}
+					});
 			}
 
-			// populate the Q part of the matrix
-			mL(n + 0, nAtRow) = 1.0;
-			mL(n + 1, nAtRow) = GetLandmark<0>(nAtRow)[0];
-			mL(n + 2, nAtRow) = GetLandmark<0>(nAtRow)[1];
-		}
-
-		// fill the lower-right 3x3 with zeros
-		for (int nAtRow = n; nAtRow < n + 3; nAtRow++) {
-			for (int nAtCol = n; nAtCol < n + 3; nAtCol++) {
-				mL(nAtCol, nAtRow) = 0.0;
+			// remember the heights the field is for
+			auto n = GetLandmarkCount();
+			m_arrPresampledHeightX.resize(n);
+			m_arrPresampledHeightY.resize(n);
+			for (int nAtLandmark = 0; nAtLandmark < n; nAtLandmark++) {
+				m_arrPresampledHeightX[nAtLandmark] = GetFixedLandmark<1>(nAtLandmark)[0] - m_arrSourceX[nAtLandmark];
+				m_arrPresampledHeightY[nAtLandmark] = GetFixedLandmark<1>(nAtLandmark)[1] - m_arrSourceY[nAtLandmark];
 			}
+			m_bPresampledForL = (n >= 3) && !m_bSolvedIteratively && !m_bApproximated
+				&& !m_bSolvedSparse && !m_bSolvedMixed && !IsUpdating();
+			m_nBasisFieldUpdates = 0;
 		}
 
-		// form the inverse of L
-		m_mL_inv.resize(n + 3, n + 3);
-		invert(mL, m_mL_inv);
-
-		m_bRecalcMatrix = FALSE;
+		m_bRecalcPresample = FALSE;
 	}
+}
 
-	// compute the x- and y-direction "heights"
-	ublas::vector<REAL> vHx(n + 3);
-	ublas::vector<REAL> vHy(n + 3);
-
-	int nAtLandmark = 0;
-	for (; nAtLandmark < n; nAtLandmark++) {
-		CVectorD<3, REAL>::Point_t vL0, vL1;
-		std::tie(vL0, vL1) = GetLandmarkTuple(nAtLandmark);
-		vHx(nAtLandmark) = vL1.get<X>() - vL0.get<X>();
-		vHy(nAtLandmark) = vL1.get<Y>() - vL0.get<Y>();
-	}
-	for (; nAtLandmark < n + 3; nAtLandmark++) {
-		vHx(nAtLandmark) = 0.0;
-		vHy(nAtLandmark) = 0.0;
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::EvalFieldRow
+// 
+// evaluates a row of the field for the presample
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::EvalFieldRow(REAL y, REAL x0, int nCount, REAL *pDx, REAL *pDy) const
+{
+	if (UseFarField()) {
+		m_treeEvaluator.EvalRow(y, x0, nCount, pDx, pDy);
+	} else if (m_bPresampleSingle) {
+		// in float, a block of the row at a time
+		const int nBlockSize = CTPSEvaluator<float>::POINT_BLOCK;
+		float arrDx[nBlockSize], arrDy[nBlockSize];
+		for (int nStart = 0; nStart < nCount; nStart += nBlockSize) {
+			const int nBlock = __min(nCount - nStart, nBlockSize);
+			m_evaluatorSingle.EvalRow(y, x0 + (REAL) nStart, nBlock, arrDx, arrDy);
+			std::copy(arrDx, arrDx + nBlock, &pDx[nStart]);
+			std::copy(arrDy, arrDy + nBlock, &pDy[nStart]);
+		}
+	} else {
+		m_evaluator.EvalRow(y, x0, nCount, pDx, pDy);
 	}
+}
 
-	m_vWx = ublas::prod(m_mL_inv, vHx);
-	m_vWy = ublas::prod(m_mL_inv, vHy);
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::PresampleLattice
+// 
+// the field is evaluated exactly at the corners of a lattice of cells,
+//		then each cell is filled (and refined as needed) by 
+//		PresampleCell.  the bands of cell rows are spread over the 
+//		threads, each evaluating its own rows of corners
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::PresampleLattice(int width, int height)
+{
+	const int nCellsX = (width + PRESAMPLE_LATTICE_CELL - 1) / PRESAMPLE_LATTICE_CELL;
+	const int nCellRows = (height + PRESAMPLE_LATTICE_CELL - 1) / PRESAMPLE_LATTICE_CELL;
+
+	ParallelForRows(nCellRows, m_nThreadCount,
+		[&](int nStartRow, int nEndRow) {
+			// the corners along the top and bottom of a row of cells.  the
+			//		last column and row are at width and height, so each 
+			//		cell fills the half-open range between its corners
+			std::vector<REAL> arrTopDx(nCellsX + 1), arrTopDy(nCellsX + 1);
+			std::vector<REAL> arrBottomDx(nCellsX + 1), arrBottomDy(nCellsX + 1);
+			auto evalCorners = [&](int atY, std::vector<REAL>& arrDx, std::vector<REAL>& arrDy) {
+				for (int nAtX = 0; nAtX <= nCellsX; nAtX++) {
+					EvalFieldPoint((REAL) __min(nAtX * PRESAMPLE_LATTICE_CELL, width), (REAL) atY, 
+						arrDx[nAtX], arrDy[nAtX]);
+				}
+			};
+
+			evalCorners(nStartRow * PRESAMPLE_LATTICE_CELL, arrTopDx, arrTopDy);
+			for (int nAtRow = nStartRow; nAtRow < nEndRow; nAtRow++) {
+				const int y0 = nAtRow * PRESAMPLE_LATTICE_CELL;
+				const int y1 = __min(y0 + PRESAMPLE_LATTICE_CELL, height);
+				evalCorners(y1, arrBottomDx, arrBottomDy);
+
+				for (int nAtX = 0; nAtX < nCellsX; nAtX++) {
+					const REAL arrCornerDx[4] = { arrTopDx[nAtX], arrTopDx[nAtX + 1], arrBottomDx[nAtX], arrBottomDx[nAtX + 1] };
+					const REAL arrCornerDy[4] = { arrTopDy[nAtX], arrTopDy[nAtX + 1], arrBottomDy[nAtX], arrBottomDy[nAtX + 1] };
+					PresampleCell(nAtX * PRESAMPLE_LATTICE_CELL, y0,
+						__min((nAtX + 1) * PRESAMPLE_LATTICE_CELL, width), y1,
+						arrCornerDx, arrCornerDy);
+				}
 
-	// unset flag
-	m_bRecalc = FALSE;
+				arrTopDx.swap(arrBottomDx);
+				arrTopDy.swap(arrBottomDy);
+			}
+		});
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::PresampleCell
+// 
+// the error of interpolating the cell is estimated from the exact field
+//		at the midpoints of its edges and at its center.  if it is over
+//		the tolerance, those points become the corners of four cells,
+//		so no evaluation is wasted.  cells of two pixels or less a side
+//		are evaluated at each pixel
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::PresampleCell(int x0, int y0, int x1, int y1, 
+	const REAL arrCornerDx[4], const REAL arrCornerDy[4])
+{
+	const int width = m_presampledField.GetWidth();
+	if (x1 - x0 <= 2 && y1 - y0 <= 2) {
+		for (int atY = y0; atY < y1; atY++) {
+			for (int atX = x0; atX < x1; atX++) {
+				REAL dx = arrCornerDx[0];
+				REAL dy = arrCornerDy[0];
+				if (atX != x0 || atY != y0) {
+					EvalFieldPoint((REAL) atX, (REAL) atY, dx, dy);
+				}
+				m_presampledField.SetSpan(atY * width + atX, 1, &dx, &dy);
+			}
+		}
+		return;
+	}
+
+	// a 3 x 3 grid of the corners, edge midpoints and center
+	const int arrX[3] = { x0, (x0 + x1) / 2, x1 };
+	const int arrY[3] = { y0, (y0 + y1) / 2, y1 };
+	REAL arrGridDx[9], arrGridDy[9];
+	const int arrCorner[4] = { 0, 2, 6, 8 };
+	for (int nAt = 0; nAt < 4; nAt++) {
+		arrGridDx[arrCorner[nAt]] = arrCornerDx[nAt];
+		arrGridDy[arrCorner[nAt]] = arrCornerDy[nAt];
+	}
+
+	// the largest difference of the exact field from the interpolation
+	REAL maxError = 0.0;
+	const int arrMiddle[5] = { 1, 3, 4, 5, 7 };
+	for (int nAt = 0; nAt < 5; nAt++) {
+		const int nGrid = arrMiddle[nAt];
+		const REAL atX = (REAL) arrX[nGrid % 3];
+		const REAL atY = (REAL) arrY[nGrid / 3];
+		EvalFieldPoint(atX, atY, arrGridDx[nGrid], arrGridDy[nGrid]);
+
+		const REAL u = (atX - x0) / (x1 - x0);
+		const REAL v = (atY - y0) / (y1 - y0);
+		const REAL interpDx = (1.0 - v) * ((1.0 - u) * arrCornerDx[0] + u * arrCornerDx[1])
+			+ v * ((1.0 - u) * arrCornerDx[2] + u * arrCornerDx[3]);
+		const REAL interpDy = (1.0 - v) * ((1.0 - u) * arrCornerDy[0] + u * arrCornerDy[1])
+			+ v * ((1.0 - u) * arrCornerDy[2] + u * arrCornerDy[3]);
+		maxError = __max(maxError, __max(fabs(interpDx - arrGridDx[nGrid]), fabs(interpDy - arrGridDy[nGrid])));
+	}
+
+	if (maxError > m_presampleTolerance) {
+		for (int nAtY = 0; nAtY < 2; nAtY++) {
+			for (int nAtX = 0; nAtX < 2; nAtX++) {
+				// a side of one pixel is not split
+				if (arrX[nAtX] == arrX[nAtX + 1] || arrY[nAtY] == arrY[nAtY + 1]) {
+					continue;
+				}
+
+				const int nGrid = nAtY * 3 + nAtX;
+				const REAL arrSubDx[4] = { arrGridDx[nGrid], arrGridDx[nGrid + 1], arrGridDx[nGrid + 3], arrGridDx[nGrid + 4] };
+				const REAL arrSubDy[4] = { arrGridDy[nGrid], arrGridDy[nGrid + 1], arrGridDy[nGrid + 3], arrGridDy[nGrid + 4] };
+				PresampleCell(arrX[nAtX], arrY[nAtY], arrX[nAtX + 1], arrY[nAtY + 1], arrSubDx, arrSubDy);
+			}
+		}
+		return;
+	}
+
+	// interpolate each row between the left and right edges
+	REAL arrDx[PRESAMPLE_LATTICE_CELL], arrDy[PRESAMPLE_LATTICE_CELL];
+	for (int atY = y0; atY < y1; atY++) {
+		const REAL v = (REAL) (atY - y0) / (y1 - y0);
+		const REAL leftDx = (1.0 - v) * arrCornerDx[0] + v * arrCornerDx[2];
+		const REAL leftDy = (1.0 - v) * arrCornerDy[0] + v * arrCornerDy[2];
+		const REAL rightDx = (1.0 - v) * arrCornerDx[1] + v * arrCornerDx[3];
+		const REAL rightDy = (1.0 - v) * arrCornerDy[1] + v * arrCornerDy[3];
+		for (int atX = x0; atX < x1; atX++) {
+			const REAL u = (REAL) (atX - x0) / (x1 - x0);
+			arrDx[atX - x0] = leftDx + u * (rightDx - leftDx);
+			arrDy[atX - x0] = leftDy + u * (rightDy - leftDy);
+		}
+		m_presampledField.SetSpan(atY * width + x0, x1 - x0, arrDx, arrDy);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::UpdatePresampleFromBasisFields
+// 
+// the field is linear in the heights, so while L is unchanged, a
+//		change dh of one landmark's height adds dh times that landmark's
+//		basis field.  computing a basis field costs about as much as a
+//		full presample, so at most one new one is computed per update.
+//		the float fields add a little rounding with each update, so a
+//		full presample is forced after a number of them.  a fixed point
+//		field would round to a whole step each time, so it is always
+//		presampled in full
+//////////////////////////////////////////////////////////////////////
+inline BOOL CTPSTransform::UpdatePresampleFromBasisFields()
+{
+	const int MAX_BASIS_FIELD_UPDATES = 64;
+
+	auto n = GetLandmarkCount();
+	if (m_basisFields.GetBudget() == 0
+		|| !m_bPresampledForL
+		|| (int) m_arrPresampledHeightX.size() != n
+		|| m_nBasisFieldUpdates >= MAX_BASIS_FIELD_UPDATES
+		|| m_presampledField.GetFormat() == CDisplacementField::FORMAT_FIXED16) {
+		return FALSE;
+	}
+
+	// find the landmarks whose heights changed
+	vector<int> arrChanged;
+	vector<REAL> arrDeltaX, arrDeltaY;
+	int nUncached = -1;
+	for (int nAtLandmark = 0; nAtLandmark < n; nAtLandmark++) {
+		REAL heightX = GetFixedLandmark<1>(nAtLandmark)[0] - m_arrSourceX[nAtLandmark];
+		REAL heightY = GetFixedLandmark<1>(nAtLandmark)[1] - m_arrSourceY[nAtLandmark];
+		if (heightX != m_arrPresampledHeightX[nAtLandmark]
+			|| heightY != m_arrPresampledHeightY[nAtLandmark]) {
+			arrChanged.push_back(nAtLandmark);
+			arrDeltaX.push_back(heightX - m_arrPresampledHeightX[nAtLandmark]);
+			arrDeltaY.push_back(heightY - m_arrPresampledHeightY[nAtLandmark]);
+
+			if (m_basisFields.Find(nAtLandmark) == NULL) {
+				if (nUncached >= 0) {
+					return FALSE;
+				}
+				nUncached = nAtLandmark;
+			}
+		}
+	}
+
+	// compute the missing field
+	const int nPixels = m_presampledField.GetWidth() * m_presampledField.GetHeight();
+	if (nUncached >= 0) {
+		float *pField = m_basisFields.Insert(nUncached, nPixels);
+		if (pField == NULL) {
+			return FALSE;
+		}
+		if (!CalcBasisField(nUncached, pField)) {
+			m_basisFields.Remove(nUncached);
+			return FALSE;
+		}
+	}
+
+	// the fields to add (the new one may have pushed out another)
+	vector<const float *> arrFields;
+	for (int nAtChanged = 0; nAtChanged < (int) arrChanged.size(); nAtChanged++) {
+		arrFields.push_back(m_basisFields.Find(arrChanged[nAtChanged]));
+		if (arrFields.back() == NULL) {
+			return FALSE;
+		}
+	}
+
+	const int width = m_presampledField.GetWidth();
+	ParallelForRows(m_presampledField.GetHeight(), m_nThreadCount,
+		[&](int nStartY, int nEndY) {
+			for (int nAtChanged = 0; nAtChanged < (int) arrChanged.size(); nAtChanged++) {
+				m_presampledField.AddScaled(nStartY * width, nEndY * width, 
+					arrFields[nAtChanged], arrDeltaX[nAtChanged], arrDeltaY[nAtChanged]);
+			}
+		});
+
+	for (int nAtChanged = 0; nAtChanged < (int) arrChanged.size(); nAtChanged++) {
+		m_arrPresampledHeightX[arrChanged[nAtChanged]] += arrDeltaX[nAtChanged];
+		m_arrPresampledHeightY[arrChanged[nAtChanged]] += arrDeltaY[nAtChanged];
+	}
+	m_nBasisFieldUpdates++;
+
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::CalcBasisField
+// 
+// the basis field of a landmark is the field for a unit height at that
+//		landmark and zero elsewhere: it is 1 at the landmark, 0 at the
+//		others, and is evaluated like the field, from the weights
+//		L^-1 e_slot
+//////////////////////////////////////////////////////////////////////
+inline BOOL CTPSTransform::CalcBasisField(int nLandmark, float *pField)
+{
+	if (!m_factorization.IsValid()) {
+		return FALSE;
+	}
+
+	ublas::matrix<REAL> mE(m_factorization.GetSize(), 1), mG;
+	mE.clear();
+	mE(m_arrLandmarkSlot[nLandmark], 0) = 1.0;
+	if (!SolveL(mE, mG)) {
+		return FALSE;
+	}
+
+	// pack the weights, as for the field
+	auto n = GetLandmarkCount();
+	std::vector<REAL> arrWeight(n + 3);
+	for (int nAtLandmark = 0; nAtLandmark < n; nAtLandmark++) {
+		arrWeight[nAtLandmark] = mG(m_arrLandmarkSlot[nAtLandmark], 0);
+	}
+	for (int nAtAffine = 0; nAtAffine < 3; nAtAffine++) {
+		arrWeight[n + nAtAffine] = mG(nAtAffine, 0);
+	}
+
+	CTPSEvaluator<> evaluator;
+	evaluator.SetBasis(n, &m_arrSourceX[0], &m_arrSourceY[0],
+		&arrWeight[0], &arrWeight[0], m_basis);
+
+	const int width = m_presampledField.GetWidth();
+	ParallelForRows(m_presampledField.GetHeight(), m_nThreadCount,
+		[&](int nStartY, int nEndY) {
+			std::vector<REAL> arrDx(width), arrDy(width);
+			for (int atY = nStartY; atY < nEndY; atY++) {
+				evaluator.EvalRow((REAL) atY, 0.0, width, arrDx.data(), arrDy.data());
+
+				float *pRow = &pField[atY * width];
+				for (int atX = 0; atX < width; atX++) {
+					pRow[atX] = (float) arrDx[atX];
+				}
+			}
+		});
+
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::ResampleRaw
+//
+// resamples raw pixels, evaluating the field at each pixel.  rows are
+//		spread over the configured number of threads
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::ResampleRaw(LPBYTE pSrcPixels, LPBYTE pDstPixels,
+	UINT bytesPerPixel,
+	UINT width,
+	UINT height,
+	UINT stride,
+	float percent)
+{
+	// see if a recalc is needed
+	if (m_bRecalc) {
+
+		// recalculate the weight vectors
+		RecalcWeights();
+	}
+
+	// the weights are now fixed, so the rows can be resampled independently
+	ParallelForRows((int)height, m_nThreadCount,
+		[&](int nStartY, int nEndY) {
+			ResampleRawRows(pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride, percent,
+				nStartY, nEndY);
+		});
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::ResampleRawRows
+//
+// resamples destination rows [nStartY, nEndY), evaluating the field
+//		at each pixel, with the far field tree when it is on.  only 
+//		writes pixels of those rows
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::ResampleRawRows(LPBYTE pSrcPixels, LPBYTE pDstPixels,
+	UINT bytesPerPixel,
+	UINT width,
+	UINT height,
+	UINT stride,
+	float percent,
+	int nStartY, int nEndY)
+{
+	// destination and source positions for a row
+	std::vector<REAL> arrX(width), arrY(width);
+	std::vector<REAL> arrSrcX(width), arrSrcY(width);
+	for (UINT dstAtX = 0; dstAtX < width; dstAtX++)
+	{
+		arrX[dstAtX] = (REAL) dstAtX;
+	}
+
+	// for each row in the band, the offsets of the whole row at once
+	for (int dstAtY = nStartY; dstAtY < nEndY; dstAtY++)
+	{
+		std::fill(arrY.begin(), arrY.end(), (REAL) dstAtY);
+		if (UseFarField())
+		{
+			m_treeEvaluator.EvalPoints((int) width, arrX.data(), arrY.data(), arrSrcX.data(), arrSrcY.data(), percent);
+		}
+		else
+		{
+			m_evaluator.EvalPoints((int) width, arrX.data(), arrY.data(), arrSrcX.data(), arrSrcY.data(), percent);
+		}
+		for (UINT dstAtX = 0; dstAtX < width; dstAtX++)
+		{
+			arrSrcX[dstAtX] += arrX[dstAtX];
+			arrSrcY[dstAtX] += arrY[dstAtX];
+		}
+
+		ResampleRowNearest(pSrcPixels, pDstPixels, bytesPerPixel, width, height, stride,
+			dstAtY, arrSrcX.data(), arrSrcY.data());
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::ResampleRawWithField
+//
+// resamples raw pixels using the presampled vector field
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::ResampleRawWithField(LPBYTE pSrcPixels, LPBYTE pDstPixels,
+	UINT bytesPerPixel,
+	UINT width,
+	UINT height,
+	UINT stride,
+	float percent)
+{
+	// see if a recalc is needed
+	if (m_bRecalc) {
+
+		// recalculate the weight vectors
+		RecalcWeights();
+	}
+
+	// if there are no landmarks, then no presampled vector field
+	if (m_bRecalcPresample
+		|| m_presampledField.GetWidth() != (int) width
+		|| m_presampledField.GetHeight() != (int) height) {
+
+		Presample(width, height);
+	}
+
+	// the field is now fixed, so the rows can be resampled independently,
+	//		with the loop compiled for the field's storage
+	ParallelForRows((int)height, m_nThreadCount,
+		[&](int nStartY, int nEndY) {
+			ResampleRowsWithField(m_presampledField, pSrcPixels, pDstPixels, bytesPerPixel, 
+				width, height, stride, percent, nStartY, nEndY);
+		});
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::RecalcWeights
+// 
+// recalcs the TPS weights from the landmarks
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::RecalcWeights()
+{
+	// the batch is solved once it is complete
+	if (IsUpdating()) {
+		return;
+	}
+
+	auto n = GetLandmarkCount();
+	// don't compute without at least three landmarks
+	if (n < 3) {
+		m_evaluator.Clear();
+		m_evaluatorSingle.Clear();
+		m_treeEvaluator.Clear();
+		return;
+	}
+
+	// the source landmarks, already packed
+	int nAtLandmark = 0;
+	const std::vector<REAL>& arrLandmarkX = m_arrSourceX;
+	const std::vector<REAL>& arrLandmarkY = m_arrSourceY;
+
+	// with many landmarks, fit fewer centers, or solve iteratively,
+	//		rather than factoring L.  a compact basis has a sparse K
+	m_bApproximated = m_nApproximateCenters >= 3 
+		&& n > m_nApproximateCenters
+		&& SolveApproximate(arrLandmarkX, arrLandmarkY);
+	m_bSolvedSparse = !m_bApproximated
+		&& m_basis.IsCompact()
+		&& SolveSparse(arrLandmarkX, arrLandmarkY);
+	m_bSolvedIteratively = !m_bApproximated
+		&& !m_basis.IsCompact()
+		&& m_nIterativeSolveThreshold > 0 
+		&& n >= m_nIterativeSolveThreshold
+		&& SolveIterative(arrLandmarkX, arrLandmarkY);
+	m_bSolvedMixed = !m_bApproximated
+		&& !m_bSolvedSparse
+		&& !m_bSolvedIteratively
+		&& m_nMixedPrecisionThreshold > 0
+		&& n >= m_nMixedPrecisionThreshold
+		&& SolveMixedPrecision(arrLandmarkX, arrLandmarkY);
+	if (!m_bApproximated && !m_bSolvedSparse && !m_bSolvedIteratively && !m_bSolvedMixed) {
+		// bring the factors up to date, incrementally if they are still
+		//		valid for the basis and the source landmarks
+		if (m_bRecalcMatrix || !UpdateL()) {
+			RefactorL();
+			m_bRecalcMatrix = FALSE;
+		}
+
+		// solve for both weight vectors.  updated factors that have drifted
+		//		too far are replaced by the factors of L itself
+		ublas::matrix<REAL> mH, mW;
+		CalcHeights(mH);
+		if (!SolveL(mH, mW)) {
+			RefactorL();
+			CalcHeights(mH);
+			SolveL(mH, mW);
+		}
+
+		// the weights are stored landmarks first, then the affine terms
+		m_vWx.resize(n + 3);
+		m_vWy.resize(n + 3);
+		for (nAtLandmark = 0; nAtLandmark < n; nAtLandmark++) {
+			int nSlot = m_arrLandmarkSlot[nAtLandmark];
+			m_vWx(nAtLandmark) = mW(nSlot, 0);
+			m_vWy(nAtLandmark) = mW(nSlot, 1);
+		}
+		for (int nAtAffine = 0; nAtAffine < 3; nAtAffine++) {
+			m_vWx(n + nAtAffine) = mW(nAtAffine, 0);
+			m_vWy(n + nAtAffine) = mW(nAtAffine, 1);
+		}
+	}
+
+	// pack the weights for the row kernel, with the approximate centers
+	//		in place of the landmarks if there are any
+	const std::vector<REAL>& arrCenterX = m_bApproximated ? m_arrApproximateCenterX : arrLandmarkX;
+	const std::vector<REAL>& arrCenterY = m_bApproximated ? m_arrApproximateCenterY : arrLandmarkY;
+	const int nCenters = (int) arrCenterX.size();
+	m_evaluator.SetBasis(nCenters, &arrCenterX[0], &arrCenterY[0],
+		&m_vWx(0), &m_vWy(0), m_basis);
+	if (m_bSinglePrecision) {
+		m_evaluatorSingle.SetBasis(nCenters, &arrCenterX[0], &arrCenterY[0],
+			&m_vWx(0), &m_vWy(0), m_basis);
+	} else {
+		m_evaluatorSingle.Clear();
+	}
+
+	// and sort them into the far field tree, if it is on
+	if (UseFarField()) {
+		m_treeEvaluator.SetTheta(m_farFieldTheta);
+		m_treeEvaluator.SetBasis(nCenters, &arrCenterX[0], &arrCenterY[0],
+			&m_vWx(0), &m_vWy(0), m_basis);
+	} else {
+		m_treeEvaluator.Clear();
+	}
+
+	// unset flag
+	m_bRecalc = FALSE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::SolveIterative
+// 
+// the preconditioner is rebuilt only when the source landmarks or the
+//		basis change, so that dragging destinations costs just the 
+//		iterations.  the last weights of each landmark are the start
+//////////////////////////////////////////////////////////////////////
+inline BOOL CTPSTransform::SolveIterative(const std::vector<REAL>& arrLandmarkX, 
+	const std::vector<REAL>& arrLandmarkY)
+{
+	auto n = GetLandmarkCount();
+	if (arrLandmarkX != m_arrKrylovCenterX || arrLandmarkY != m_arrKrylovCenterY
+		|| m_basis != m_krylovBasis
+		|| m_krylovSolver.GetCenterCount() != n) {
+		m_arrKrylovCenterX = arrLandmarkX;
+		m_arrKrylovCenterY = arrLandmarkY;
+		m_krylovBasis = m_basis;
+		if (!m_krylovSolver.SetCenters(n, &arrLandmarkX[0], &arrLandmarkY[0], m_basis)) {
+			return FALSE;
+		}
+	}
+
+	// the heights, and the starting weights
+	std::vector<REAL> arrHx(n), arrHy(n);
+	std::vector<REAL> arrWx(n + 3, 0.0), arrWy(n + 3, 0.0);
+	for (int nAtLandmark = 0; nAtLandmark < n; nAtLandmark++) {
+		arrHx[nAtLandmark] = GetFixedLandmark<1>(nAtLandmark)[0] - arrLandmarkX[nAtLandmark];
+		arrHy[nAtLandmark] = GetFixedLandmark<1>(nAtLandmark)[1] - arrLandmarkY[nAtLandmark];
+		if (nAtLandmark + 3 < (int) m_vWx.size()) {
+			arrWx[nAtLandmark] = m_vWx(nAtLandmark);
+			arrWy[nAtLandmark] = m_vWy(nAtLandmark);
+		}
+	}
+
+	// the products with K are the radial field at the landmarks, from the
+	//		tree or from the packed evaluator over the threads
+	if (m_farFieldTheta > 0.0) {
+		m_treeEvaluator.SetTheta(m_farFieldTheta);
+		m_treeEvaluator.SetBasis(n, &arrLandmarkX[0], &arrLandmarkY[0],
+			&arrWx[0], &arrWy[0], m_basis);
+	}
+	std::vector<REAL> arrKernelWx(n + 3, 0.0), arrKernelWy(n + 3, 0.0);
+	auto multiplyKernel = [&](const REAL *pWx, const REAL *pWy, REAL *pKWx, REAL *pKWy) {
+		if (m_farFieldTheta > 0.0) {
+			m_treeEvaluator.MultiplyKernel(pWx, pWy, pKWx, pKWy);
+			return;
+		}
+
+		std::copy(pWx, pWx + n, arrKernelWx.begin());
+		std::copy(pWy, pWy + n, arrKernelWy.begin());
+		m_evaluator.SetBasis(n, &arrLandmarkX[0], &arrLandmarkY[0],
+			&arrKernelWx[0], &arrKernelWy[0], m_basis);
+		const int nBlocks = (n + CTPSEvaluator<>::POINT_BLOCK - 1) / CTPSEvaluator<>::POINT_BLOCK;
+		ParallelForRows(nBlocks, m_nThreadCount,
+			[&](int nStartBlock, int nEndBlock) {
+				int nStart = nStartBlock * CTPSEvaluator<>::POINT_BLOCK;
+				int nEnd = __min(nEndBlock * CTPSEvaluator<>::POINT_BLOCK, n);
+				m_evaluator.EvalPoints(nEnd - nStart, &arrLandmarkX[nStart], &arrLandmarkY[nStart],
+					&pKWx[nStart], &pKWy[nStart], 1.0);
+			});
+	};
+
+	// the tree's products are only accurate to about 1e-7, so it stops
+	//		sooner
+	m_krylovSolver.SetTolerance((m_farFieldTheta > 0.0) ? 1e-6 : KRYLOV_DEFAULT_TOLERANCE);
+	if (!m_krylovSolver.Solve(multiplyKernel, &arrHx[0], &arrHy[0], &arrWx[0], &arrWy[0])) {
+		return FALSE;
+	}
+
+	m_vWx.resize(n + 3);
+	m_vWy.resize(n + 3);
+	std::copy(arrWx.begin(), arrWx.end(), m_vWx.begin());
+	std::copy(arrWy.begin(), arrWy.end(), m_vWy.begin());
+
+	// the presampled field and the basis fields are not for L
+	m_bPresampledForL = FALSE;
+	m_basisFields.Clear();
+
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::SolveMixedPrecision
+// 
+// L is assembled in landmark order, the affine rows first, and factored
+//		only when the source landmarks or the basis change; moving
+//		destinations costs the refinement steps, each O(n^2)
+//////////////////////////////////////////////////////////////////////
+inline BOOL CTPSTransform::SolveMixedPrecision(const std::vector<REAL>& arrLandmarkX, 
+	const std::vector<REAL>& arrLandmarkY)
+{
+	auto n = GetLandmarkCount();
+	if (arrLandmarkX != m_arrMixedX || arrLandmarkY != m_arrMixedY
+		|| m_basis != m_mixedBasis
+		|| !m_mixedLU.IsValid()) {
+		m_arrMixedX = arrLandmarkX;
+		m_arrMixedY = arrLandmarkY;
+		m_mixedBasis = m_basis;
+
+		ublas::matrix<REAL> mL;
+		AssembleL(n, arrLandmarkX.data(), arrLandmarkY.data(), mL);
+		if (!m_mixedLU.Factorize(mL)) {
+			return FALSE;
+		}
+	}
+
+	// both height vectors at once
+	ublas::matrix<REAL> mW(n + 3, 2);
+	mW.clear();
+	for (int nAt = 0; nAt < n; nAt++) {
+		mW(nAt + 3, 0) = GetFixedLandmark<1>(nAt)[0] - arrLandmarkX[nAt];
+		mW(nAt + 3, 1) = GetFixedLandmark<1>(nAt)[1] - arrLandmarkY[nAt];
+	}
+	if (!m_mixedLU.Solve(mW)) {
+		return FALSE;
+	}
+
+	// the weights are stored landmarks first, then the affine terms
+	m_vWx.resize(n + 3);
+	m_vWy.resize(n + 3);
+	for (int nAt = 0; nAt < n; nAt++) {
+		m_vWx(nAt) = mW(nAt + 3, 0);
+		m_vWy(nAt) = mW(nAt + 3, 1);
+	}
+	for (int nAtAffine = 0; nAtAffine < 3; nAtAffine++) {
+		m_vWx(n + nAtAffine) = mW(nAtAffine, 0);
+		m_vWy(n + nAtAffine) = mW(nAtAffine, 1);
+	}
+
+	// the presampled field and the basis fields are not for L
+	m_bPresampledForL = FALSE;
+	m_basisFields.Clear();
+
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::SolveSparse
+// 
+// with a compact basis, K only couples landmarks within the support
+//		radius, and is positive definite.  so rather than factoring L,
+//		K is factored sparse, and the affine weights a come from the
+//		3 x 3 system
+//			P' K^-1 P a = P' K^-1 H
+//		after which W = K^-1 (H - P a).  the factors and K^-1 P only 
+//		depend on the source landmarks, so moving destinations costs
+//		two sparse solves
+//////////////////////////////////////////////////////////////////////
+inline BOOL CTPSTransform::SolveSparse(const std::vector<REAL>& arrLandmarkX, 
+	const std::vector<REAL>& arrLandmarkY)
+{
+	auto n = GetLandmarkCount();
+	REAL x0 = 0.0, y0 = 0.0;
+	for (int nAt = 0; nAt < n; nAt++) {
+		x0 += arrLandmarkX[nAt] / n;
+		y0 += arrLandmarkY[nAt] / n;
+	}
+
+	if (arrLandmarkX != m_arrSparseX || arrLandmarkY != m_arrSparseY
+		|| m_basis != m_sparseBasis
+		|| m_sparseCholesky.GetSize() != n) {
+		m_arrSparseX.clear();
+		m_arrSparseY.clear();
+
+		// K by rows, from the landmarks within the radius of each
+		const REAL radius = m_basis.GetSupportRadius();
+		CPointGrid grid;
+		grid.SetPoints(n, &arrLandmarkX[0], &arrLandmarkY[0], radius);
+		std::vector<int> arrStart(1, 0), arrIndex;
+		std::vector<REAL> arrValue;
+		m_basis.Dispatch([&](const auto& kernel) {
+			for (int nAt = 0; nAt < n; nAt++) {
+				grid.ForEachNear(arrLandmarkX[nAt], arrLandmarkY[nAt], radius,
+					[&](int nOther, REAL r2) {
+						arrIndex.push_back(nOther);
+						arrValue.push_back(kernel(r2));
+					});
+				arrStart.push_back((int) arrIndex.size());
+			}
+		});
+		if (!m_sparseCholesky.Factorize(n, arrStart, arrIndex, arrValue)) {
+			return FALSE;
+		}
+
+		// K^-1 times the affine columns
+		m_arrSparseAffine.resize(3 * n);
+		for (int nAt = 0; nAt < n; nAt++) {
+			m_arrSparseAffine[nAt] = 1.0;
+			m_arrSparseAffine[n + nAt] = arrLandmarkX[nAt] - x0;
+			m_arrSparseAffine[2 * n + nAt] = arrLandmarkY[nAt] - y0;
+		}
+		for (int nCol = 0; nCol < 3; nCol++) {
+			m_sparseCholesky.Solve(&m_arrSparseAffine[nCol * n]);
+		}
+
+		m_arrSparseX = arrLandmarkX;
+		m_arrSparseY = arrLandmarkY;
+		m_sparseBasis = m_basis;
+	}
+
+	// K^-1 H
+	std::vector<REAL> arrVx(n), arrVy(n);
+	for (int nAt = 0; nAt < n; nAt++) {
+		arrVx[nAt] = GetFixedLandmark<1>(nAt)[0] - arrLandmarkX[nAt];
+		arrVy[nAt] = GetFixedLandmark<1>(nAt)[1] - arrLandmarkY[nAt];
+	}
+	m_sparseCholesky.Solve(&arrVx[0]);
+	m_sparseCholesky.Solve(&arrVy[0]);
+
+	// P' K^-1 P, and P' K^-1 H
+	ublas::matrix<REAL> mS(3, 3), mA(3, 2);
+	mS.clear();
+	mA.clear();
+	for (int nAt = 0; nAt < n; nAt++) {
+		const REAL arrP[3] = { 1.0, arrLandmarkX[nAt] - x0, arrLandmarkY[nAt] - y0 };
+		for (int nRow = 0; nRow < 3; nRow++) {
+			for (int nCol = 0; nCol < 3; nCol++) {
+				mS(nRow, nCol) += arrP[nRow] * m_arrSparseAffine[nCol * n + nAt];
+			}
+			mA(nRow, 0) += arrP[nRow] * arrVx[nAt];
+			mA(nRow, 1) += arrP[nRow] * arrVy[nAt];
+		}
+	}
+	ublas::permutation_matrix<size_t> vPivot(3);
+	if (ublas::lu_factorize(mS, vPivot) != 0) {
+		return FALSE;
+	}
+	ublas::lu_substitute(mS, vPivot, mA);
+
+	// the radial weights, and the affine terms back about the origin
+	m_vWx.resize(n + 3);
+	m_vWy.resize(n + 3);
+	for (int nAt = 0; nAt < n; nAt++) {
+		m_vWx(nAt) = arrVx[nAt];
+		m_vWy(nAt) = arrVy[nAt];
+		for (int nCol = 0; nCol < 3; nCol++) {
+			m_vWx(nAt) -= m_arrSparseAffine[nCol * n + nAt] * mA(nCol, 0);
+			m_vWy(nAt) -= m_arrSparseAffine[nCol * n + nAt] * mA(nCol, 1);
+		}
+	}
+	m_vWx(n) = mA(0, 0) - mA(1, 0) * x0 - mA(2, 0) * y0;
+	m_vWy(n) = mA(0, 1) - mA(1, 1) * x0 - mA(2, 1) * y0;
+	m_vWx(n + 1) = mA(1, 0);
+	m_vWy(n + 1) = mA(1, 1);
+	m_vWx(n + 2) = mA(2, 0);
+	m_vWy(n + 2) = mA(2, 1);
+
+	// the presampled field and the basis fields are not for L
+	m_bPresampledForL = FALSE;
+	m_basisFields.Clear();
+
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::SolveApproximate
+// 
+// with A the n x (m + 3) matrix of the basis of each landmark to each
+//		center, then (1, x, y), the weights minimize
+//			|A W - H|^2 + lambda W' K W
+//		subject to P' W = 0 over the centers.  the normal equations,
+//		bordered by the constraint, are solved by LU.  the affine terms
+//		are taken about the centroid, to keep A'A well scaled
+//////////////////////////////////////////////////////////////////////
+inline BOOL CTPSTransform::SolveApproximate(const std::vector<REAL>& arrLandmarkX, 
+	const std::vector<REAL>& arrLandmarkY)
+{
+	auto n = GetLandmarkCount();
+	const int m = m_nApproximateCenters;
+	SelectApproximateCenters(arrLandmarkX, arrLandmarkY, m);
+
+	REAL x0 = 0.0, y0 = 0.0;
+	for (int nAt = 0; nAt < n; nAt++) {
+		x0 += arrLandmarkX[nAt] / n;
+		y0 += arrLandmarkY[nAt] / n;
+	}
+
+	// accumulate the upper triangle of A'A, and A'H, a row at a time
+	const int nSize = m + 6;
+	ublas::matrix<REAL> mM(nSize, nSize);
+	ublas::matrix<REAL> mB(nSize, 2);
+	mM.clear();
+	mB.clear();
+	std::vector<REAL> arrRow(m + 3);
+	m_basis.Dispatch([&](const auto& kernel) {
+		for (int nAt = 0; nAt < n; nAt++) {
+			const REAL x = arrLandmarkX[nAt];
+			const REAL y = arrLandmarkY[nAt];
+			for (int nCenter = 0; nCenter < m; nCenter++) {
+				const REAL dx = x - m_arrApproximateCenterX[nCenter];
+				const REAL dy = y - m_arrApproximateCenterY[nCenter];
+				arrRow[nCenter] = kernel(dx * dx + dy * dy);
+			}
+			arrRow[m] = 1.0;
+			arrRow[m + 1] = x - x0;
+			arrRow[m + 2] = y - y0;
+
+			const REAL hx = GetFixedLandmark<1>(nAt)[0] - x;
+			const REAL hy = GetFixedLandmark<1>(nAt)[1] - y;
+			for (int nRow = 0; nRow < m + 3; nRow++) {
+				const REAL a = arrRow[nRow];
+				for (int nCol = nRow; nCol < m + 3; nCol++) {
+					mM(nRow, nCol) += a * arrRow[nCol];
+				}
+				mB(nRow, 0) += a * hx;
+				mB(nRow, 1) += a * hy;
+			}
+		}
+	});
+
+	// the bending energy of the radial weights, and the constraint rows
+	for (int nRow = 0; nRow < m; nRow++) {
+		const REAL x = m_arrApproximateCenterX[nRow];
+		const REAL y = m_arrApproximateCenterY[nRow];
+		if (m_approximateLambda != 0.0) {
+			for (int nCol = nRow; nCol < m; nCol++) {
+				const REAL dx = x - m_arrApproximateCenterX[nCol];
+				const REAL dy = y - m_arrApproximateCenterY[nCol];
+				mM(nRow, nCol) += m_approximateLambda * m_basis(dx * dx + dy * dy);
+			}
+		}
+		mM(nRow, m + 3) = 1.0;
+		mM(nRow, m + 4) = x - x0;
+		mM(nRow, m + 5) = y - y0;
+	}
+
+	// fill in the lower triangle
+	for (int nRow = 0; nRow < nSize; nRow++) {
+		for (int nCol = 0; nCol < nRow; nCol++) {
+			mM(nRow, nCol) = mM(nCol, nRow);
+		}
+	}
+
+	// the kernel columns are far larger than the affine ones, so scale
+	//		the rows and columns to a unit diagonal before factoring.  the
+	//		constraint rows, with a zero diagonal, are scaled to a unit
+	//		largest entry
+	std::vector<REAL> arrScale(nSize);
+	for (int nRow = 0; nRow < m + 3; nRow++) {
+		arrScale[nRow] = (mM(nRow, nRow) > 0.0) ? 1.0 / sqrt(mM(nRow, nRow)) : 1.0;
+	}
+	for (int nRow = m + 3; nRow < nSize; nRow++) {
+		REAL maxEntry = 0.0;
+		for (int nCol = 0; nCol < m; nCol++) {
+			maxEntry = __max(maxEntry, fabs(mM(nRow, nCol)) * arrScale[nCol]);
+		}
+		arrScale[nRow] = (maxEntry > 0.0) ? 1.0 / maxEntry : 1.0;
+	}
+	for (int nRow = 0; nRow < nSize; nRow++) {
+		for (int nCol = 0; nCol < nSize; nCol++) {
+			mM(nRow, nCol) *= arrScale[nRow] * arrScale[nCol];
+		}
+		mB(nRow, 0) *= arrScale[nRow];
+		mB(nRow, 1) *= arrScale[nRow];
+	}
+
+	ublas::permutation_matrix<size_t> vPivot(nSize);
+	if (ublas::lu_factorize(mM, vPivot) != 0) {
+		return FALSE;
+	}
+	ublas::lu_substitute(mM, vPivot, mB);
+	for (int nRow = 0; nRow < nSize; nRow++) {
+		mB(nRow, 0) *= arrScale[nRow];
+		mB(nRow, 1) *= arrScale[nRow];
+	}
+
+	// the affine terms back about the origin
+	m_vWx.resize(m + 3);
+	m_vWy.resize(m + 3);
+	for (int nAt = 0; nAt < m + 3; nAt++) {
+		m_vWx(nAt) = mB(nAt, 0);
+		m_vWy(nAt) = mB(nAt, 1);
+	}
+	m_vWx(m) -= m_vWx(m + 1) * x0 + m_vWx(m + 2) * y0;
+	m_vWy(m) -= m_vWy(m + 1) * x0 + m_vWy(m + 2) * y0;
+
+	// the presampled field and the basis fields are not for L
+	m_bPresampledForL = FALSE;
+	m_basisFields.Clear();
+
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::SelectApproximateCenters
+// 
+// farthest point sampling, starting from the landmark nearest the
+//		centroid.  O(n m), and deterministic
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::SelectApproximateCenters(const std::vector<REAL>& arrLandmarkX, 
+	const std::vector<REAL>& arrLandmarkY, int nCenters)
+{
+	const int n = (int) arrLandmarkX.size();
+	REAL x0 = 0.0, y0 = 0.0;
+	for (int nAt = 0; nAt < n; nAt++) {
+		x0 += arrLandmarkX[nAt] / n;
+		y0 += arrLandmarkY[nAt] / n;
+	}
+
+	// the squared distance of each landmark to the nearest center so far
+	std::vector<REAL> arrDist2(n);
+	for (int nAt = 0; nAt < n; nAt++) {
+		const REAL dx = arrLandmarkX[nAt] - x0;
+		const REAL dy = arrLandmarkY[nAt] - y0;
+		arrDist2[nAt] = dx * dx + dy * dy;
+	}
+	int nNext = (int) (std::min_element(arrDist2.begin(), arrDist2.end()) - arrDist2.begin());
+
+	m_arrApproximateCenterX.clear();
+	m_arrApproximateCenterY.clear();
+	for (int nCenter = 0; nCenter < nCenters; nCenter++) {
+		const REAL cx = arrLandmarkX[nNext];
+		const REAL cy = arrLandmarkY[nNext];
+		m_arrApproximateCenterX.push_back(cx);
+		m_arrApproximateCenterY.push_back(cy);
+
+		int nFarthest = nNext;
+		for (int nAt = 0; nAt < n; nAt++) {
+			const REAL dx = arrLandmarkX[nAt] - cx;
+			const REAL dy = arrLandmarkY[nAt] - cy;
+			const REAL d2 = dx * dx + dy * dy;
+			arrDist2[nAt] = (nCenter == 0) ? d2 : __min(arrDist2[nAt], d2);
+			if (arrDist2[nAt] > arrDist2[nFarthest]) {
+				nFarthest = nAt;
+			}
+		}
+		nNext = nFarthest;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::CalcHeights
+// 
+// computes the x- and y-direction "heights", as the two columns of
+//		one right-hand side in slot order.  the affine rows and any
+//		unused slots have zero height
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::CalcHeights(ublas::matrix<REAL>& mH)
+{
+	const int nSlots = m_factorization.GetSize();
+	mH.resize(nSlots, 2, false);
+	mH.clear();
+
+	auto n = GetLandmarkCount();
+	for (int nAtLandmark = 0; nAtLandmark < n; nAtLandmark++) {
+		int nSlot = m_arrLandmarkSlot[nAtLandmark];
+		mH(nSlot, 0) = GetFixedLandmark<1>(nAtLandmark)[0] - m_arrSourceX[nAtLandmark];
+		mH(nSlot, 1) = GetFixedLandmark<1>(nAtLandmark)[1] - m_arrSourceY[nAtLandmark];
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::SolveL
+// 
+// solves for the weights in slot order.  when the factors have been
+//		updated, the residual against m_mL is used for one step of 
+//		iterative refinement, which restores the accuracy of a fresh
+//		factorization as long as the updated factors are not too far
+//		off.  returns FALSE if they are
+//////////////////////////////////////////////////////////////////////
+inline BOOL CTPSTransform::SolveL(const ublas::matrix<REAL>& mH, ublas::matrix<REAL>& mW)
+{
+	const int nSlots = m_factorization.GetSize();
+	const int nCols = (int) mH.size2();
+
+	// solve for all columns in one pass over the factors.  a singular L
+	//		(e.g. collinear landmarks) leaves the field at zero
+	mW = mH;
+	if (!m_factorization.IsValid()) {
+		mW.clear();
+		return TRUE;
+	}
+	m_factorization.Solve(mW);
+
+	if (m_factorization.GetUpdateCount() == 0) {
+		return TRUE;
+	}
+
+	// the residual, and the componentwise backward error: the residual of
+	//		each row against the size of its terms.  the rows of unused
+	//		slots are skipped, as their weights are never used and (being
+	//		decoupled) do not affect the others
+	const REAL MAX_BACKWARD_ERROR = 1e-8;
+	ublas::matrix<REAL> mResidual = ublas::prod(m_mL, mW) - mH;
+	for (int nRow = 0; nRow < nSlots; nRow++) {
+		if (nRow >= 3 && !m_arrSlotUsed[nRow]) {
+			ublas::row(mResidual, nRow) = ublas::zero_vector<REAL>(nCols);
+			continue;
+		}
+
+		for (int nDim = 0; nDim < nCols; nDim++) {
+			REAL size = fabs(mH(nRow, nDim));
+			for (int nCol = 0; nCol < nSlots; nCol++) {
+				size += fabs(m_mL(nRow, nCol) * mW(nCol, nDim));
+			}
+			if (fabs(mResidual(nRow, nDim)) > MAX_BACKWARD_ERROR * size) {
+				return FALSE;
+			}
+		}
+	}
+
+	// refine
+	m_factorization.Solve(mResidual);
+	mW -= mResidual;
+
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::SetSlotColumn
+// 
+// L is symmetric, so the row is the column
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::SetSlotColumn(int nSlot, const ublas::vector<REAL>& vCol)
+{
+	ublas::column(m_mL, nSlot) = vCol;
+	ublas::row(m_mL, nSlot) = vCol;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::CalcSlotColumn
+// 
+// the column holds the affine terms (1, x, y) in slots 0-2, then the
+//		basis of the distance to every used slot.  the landmark's own
+//		slot, and unused slots, are zero
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::CalcSlotColumn(REAL x, REAL y, int nSlot, int nSize, 
+	ublas::vector<REAL>& vCol)
+{
+	vCol.resize(nSize, false);
+	vCol(0) = 1.0;
+	vCol(1) = x;
+	vCol(2) = y;
+	for (int nAtSlot = 3; nAtSlot < nSize; nAtSlot++) {
+		if (nAtSlot == nSlot) {
+			vCol(nAtSlot) = m_basis(0.0);
+		} else if (m_arrSlotUsed[nAtSlot]) {
+			const REAL dx = x - m_arrSlotX[nAtSlot];
+			const REAL dy = y - m_arrSlotY[nAtSlot];
+			vCol(nAtSlot) = m_basis(dx * dx + dy * dy);
+		} else {
+			vCol(nAtSlot) = 0.0;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::RefactorL
+// 
+// assembles L with the landmarks in consecutive slots after the
+//		affine rows, and factorizes it
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::RefactorL()
+{
+	auto n = GetLandmarkCount();
+	const int nSlots = n + 3;
+
+	// the presampled field and the basis fields are for the old L
+	m_bPresampledForL = FALSE;
+	m_basisFields.Clear();
+
+	// compact the slots
+	m_arrSlotX.assign(nSlots, 0.0);
+	m_arrSlotY.assign(nSlots, 0.0);
+	m_arrSlotUsed.assign(nSlots, FALSE);
+	for (int nAtLandmark = 0; nAtLandmark < n; nAtLandmark++) {
+		int nSlot = nAtLandmark + 3;
+		m_arrLandmarkSlot[nAtLandmark] = nSlot;
+		m_arrSlotX[nSlot] = m_arrSourceX[nAtLandmark];
+		m_arrSlotY[nSlot] = m_arrSourceY[nAtLandmark];
+		m_arrSlotUsed[nSlot] = TRUE;
+	}
+	m_arrRemovedSlots.clear();
+	m_arrFreeSlots.clear();
+
+	// stores the L matrix, with the landmarks in slot order
+	AssembleL(n, &m_arrSlotX[3], &m_arrSlotY[3], m_mL);
+
+	// factorize L; the factors are reused for every solve, and updated
+	//		as landmarks are added and removed
+	m_factorization.Factorize(m_mL);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::AssembleL
+// 
+// L is symmetric, so only the upper triangle of K is computed: each 
+//		row's squared distances to the landmarks after it go through the
+//		kernel's block form, with bands of rows spread over the threads.
+//		the lower triangle is then mirrored from it, also by rows, and 
+//		the affine blocks (1, x, y) are filled once, with zeros in the
+//		upper-left 3x3
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTransform::AssembleL(int n, const REAL *pX, const REAL *pY, 
+	ublas::matrix<REAL>& mL) const
+{
+	const int nSize = n + 3;
+	mL.resize(nSize, nSize, false);
+
+	for (int nRow = 0; nRow < 3; nRow++) {
+		for (int nCol = 0; nCol < 3; nCol++) {
+			mL(nRow, nCol) = 0.0;
+		}
+	}
+	for (int nAt = 0; nAt < n; nAt++) {
+		mL(0, nAt + 3) = mL(nAt + 3, 0) = 1.0;
+		mL(1, nAt + 3) = mL(nAt + 3, 1) = pX[nAt];
+		mL(2, nAt + 3) = mL(nAt + 3, 2) = pY[nAt];
+	}
+
+	const int nRowsPerBand = __max(1, ASSEMBLE_L_BAND_ENTRIES / __max(n, 1));
+	const REAL diagonal = m_basis(0.0);
+	m_basis.Dispatch([&](const auto& kernel) {
+		ParallelForRows(n, m_nThreadCount,
+			[&](int nStartRow, int nEndRow) {
+				std::vector<REAL> arrR2(n);
+				for (int nAt = nStartRow; nAt < nEndRow; nAt++) {
+					// the row of K, from the diagonal on
+					REAL *pRow = &mL(nAt + 3, nAt + 3);
+					const REAL x = pX[nAt], y = pY[nAt];
+					const int nCount = n - nAt - 1;
+					for (int nOther = 0; nOther < nCount; nOther++) {
+						const REAL dx = x - pX[nAt + 1 + nOther];
+						const REAL dy = y - pY[nAt + 1 + nOther];
+						arrR2[nOther] = dx * dx + dy * dy;
+					}
+					pRow[0] = diagonal;
+					kernel.Eval(nCount, arrR2.data(), &pRow[1]);
+				}
+			}, nRowsPerBand);
+	});
+
+	ParallelForRows(n, m_nThreadCount,
+		[&](int nStartRow, int nEndRow) {
+			for (int nAt = nStartRow; nAt < nEndRow; nAt++) {
+				for (int nOther = 0; nOther < nAt; nOther++) {
+					mL(nAt + 3, nOther + 3) = mL(nOther + 3, nAt + 3);
+				}
+			}
+		}, nRowsPerBand);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTransform::UpdateL
+// 
+// each added landmark (which includes a landmark whose source moved)
+//		takes over a removed landmark's slot, or an identity slot, with
+//		one rank-2 update of the factors; otherwise it gets a new slot.
+//		the slots of removed landmarks left over then become identity 
+//		rows.  each edit costs O(n^2), so a refactor is only done for 
+//		large batches, after many updates, or when an update reports 
+//		that the factors have lost stability
+//////////////////////////////////////////////////////////////////////
+inline BOOL CTPSTransform::UpdateL()
+{
+	if (!m_factorization.IsValid()
+		|| m_factorization.GetSize() != (int) m_arrSlotUsed.size()) {
+		return FALSE;
+	}
+
+	// count the edits.  an added (or moved) landmark that takes over a
+	//		removed landmark's slot is one edit
+	auto n = GetLandmarkCount();
+	int nAdded = 0;
+	for (int nAtLandmark = 0; nAtLandmark < n; nAtLandmark++) {
+		if (m_arrLandmarkSlot[nAtLandmark] < 0) {
+			nAdded++;
+		}
+	}
+	int nEdits = __max(nAdded, (int) m_arrRemovedSlots.size());
+
+	// a refactor is cheaper than a large batch of updates, and it also 
+	//		folds in a correction that has grown large enough to slow the
+	//		solve, restores the stability lost over many borderings, and 
+	//		compacts the slots once many of them are unused
+	int nSlots = m_factorization.GetSize();
+	if (nEdits * 16 > nSlots
+		|| (m_factorization.GetCorrectionRank() + 2 * nEdits) * 4 > nSlots
+		|| (m_factorization.GetUpdateCount() + nEdits) * 2 > nSlots
+		|| (int) (m_arrRemovedSlots.size() + m_arrFreeSlots.size()) * 4 > nSlots) {
+		return FALSE;
+	}
+
+	// the presampled field and the basis fields are for the old L
+	if (nEdits > 0) {
+		m_bPresampledForL = FALSE;
+		m_basisFields.Clear();
+	}
+
+	ublas::vector<REAL> vCol;
+
+	// place the added landmarks
+	for (int nAtLandmark = 0; nAtLandmark < n; nAtLandmark++) {
+		if (m_arrLandmarkSlot[nAtLandmark] >= 0) {
+			continue;
+		}
+
+		const REAL x = m_arrSourceX[nAtLandmark];
+		const REAL y = m_arrSourceY[nAtLandmark];
+
+		int nSlot = -1;
+		BOOL bFilled = FALSE;
+		if (!m_arrRemovedSlots.empty() || !m_arrFreeSlots.empty()) {
+			// take over a removed landmark's slot, or an identity slot
+			std::vector<int>& arrSlots = !m_arrRemovedSlots.empty() 
+				? m_arrRemovedSlots : m_arrFreeSlots;
+			nSlot = arrSlots.back();
+			arrSlots.pop_back();
+		} else {
+			// border the factors with a new slot.  once there is a 
+			//		correction, the slot starts as the identity instead
+			nSlot = nSlots;
+			CalcSlotColumn(x, y, nSlot, nSlots, vCol);
+			bFilled = m_factorization.Append(vCol, m_basis(0.0));
+			if (!bFilled) {
+				m_factorization.AppendIdentity();
+			}
+			nSlots++;
+
+			m_arrSlotX.push_back(0.0);
+			m_arrSlotY.push_back(0.0);
+			m_arrSlotUsed.push_back(FALSE);
+
+			m_mL.resize(nSlots, nSlots, true);
+			if (bFilled) {
+				vCol.resize(nSlots, true);
+				vCol(nSlot) = m_basis(0.0);
+			} else {
+				vCol = ublas::unit_vector<REAL>(nSlots, nSlot);
+			}
+			SetSlotColumn(nSlot, vCol);
+		}
+
+		// the slot's column changes to the landmark's
+		if (!bFilled) {
+			CalcSlotColumn(x, y, nSlot, nSlots, vCol);
+			if (!m_factorization.UpdateSymmetric(nSlot, vCol - ublas::column(m_mL, nSlot))) {
+				return FALSE;
+			}
+			SetSlotColumn(nSlot, vCol);
+		}
+
+		m_arrLandmarkSlot[nAtLandmark] = nSlot;
+		m_arrSlotX[nSlot] = x;
+		m_arrSlotY[nSlot] = y;
+		m_arrSlotUsed[nSlot] = TRUE;
+	}
+
+	// clear the slots of the remaining removed landmarks to the identity
+	while (!m_arrRemovedSlots.empty()) {
+		int nSlot = m_arrRemovedSlots.back();
+		m_arrRemovedSlots.pop_back();
+
+		vCol = ublas::unit_vector<REAL>(nSlots, nSlot);
+		if (!m_factorization.UpdateSymmetric(nSlot, vCol - ublas::column(m_mL, nSlot))) {
+			return FALSE;
+		}
+		SetSlotColumn(nSlot, vCol);
+
+		m_arrSlotUsed[nSlot] = FALSE;
+		m_arrFreeSlots.push_back(nSlot);
+	}
+
+	return TRUE;
 }
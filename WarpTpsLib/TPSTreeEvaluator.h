@@ -0,0 +1,572 @@
+//////////////////////////////////////////////////////////////////////
+// TPSTreeEvaluator.h: interface for the CTPSTreeEvaluator class.
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <complex>
+#include <algorithm>
+
+// math utilities
+#include "MathUtil.h"
+
+// radial basis kernels
+#include "RadialBasis.h"
+
+// most centers in a leaf of the tree
+const int TREE_LEAF_SIZE = 16;
+
+// deepest level of the tree; coincident centers stop splitting here
+const int TREE_MAX_DEPTH = 40;
+
+// default number of terms of the far field expansions
+const int TREE_DEFAULT_ORDER = 16;
+
+//////////////////////////////////////////////////////////////////////
+// class CTPSTreeEvaluator
+//
+// evaluates a TPS field Barnes-Hut style.  the centers are sorted into
+//		a quadtree, and each node keeps a far field (multipole)
+//		expansion of its centers' field about their centroid.  a node
+//		that is far from the point, relative to its radius, is summed
+//		from its expansion; near nodes are opened, down to leaves that
+//		are summed exactly.  
+//
+//		the expansion is that of Beatson and Newsam for r^2 log r, in
+//		complex z = x + iy: with t the centers relative to the centroid,
+//			sum w |z - t|^2 log|z - t| = Re[ conj(z) F(z) - G(z) ]
+//			F(z) = (a0 z - a1) log z - a1 + sum_j a(j+1) / (j (j+1) z^j)
+//			G(z) = (b0 z - b1) log z - b1 + sum_j b(j+1) / (j (j+1) z^j)
+//		with moments a(m) = sum w t^m and b(m) = sum w conj(t) t^m.
+//		truncated after the order'th term, the error of a node goes as
+//		theta^(order + 1), where theta is the largest ratio of node
+//		radius to distance that is expanded.
+//
+//		the expansion is only for the thin plate exponent (2); other
+//		exponents are summed exactly.  like CTPSEvaluator, all 
+//		evaluation is const
+//////////////////////////////////////////////////////////////////////
+class CTPSTreeEvaluator
+{
+public:
+	// construction
+	CTPSTreeEvaluator();
+
+	// the opening ratio, in (0, 1); 0 sums every center exactly
+	REAL GetTheta() const { return m_theta; }
+	void SetTheta(REAL theta) { m_theta = theta; }
+
+	// the number of terms of the expansions
+	int GetOrder() const { return m_nOrder; }
+	void SetOrder(int nOrder);
+
+	// builds the tree over the centers and loads the weights.  pWx/pWy
+	//		hold the nCenters radial weights followed by the three
+	//		affine weights
+	void SetBasis(int nCenters, const REAL *pCenterX, const REAL *pCenterY,
+		const REAL *pWx, const REAL *pWy, const CRadialBasis& basis);
+
+	// loads new weights for the same centers, recomputing the moments
+	void SetWeights(const REAL *pWx, const REAL *pWy);
+
+	// removes all centers, so that the field evaluates to zero
+	void Clear();
+
+	// number of radial centers, and of tree nodes
+	int GetCenterCount() const { return (int) m_arrCenterX.size(); }
+	int GetNodeCount() const { return (int) m_arrNodes.size(); }
+
+	// evaluates the offset at a single point
+	void EvalPoint(REAL x, REAL y, REAL& dx, REAL& dy) const;
+
+	// evaluates the offsets of nCount pixels along row y, starting at x0
+	void EvalRow(REAL y, REAL x0, int nCount, REAL *pDx, REAL *pDy) const;
+
+	// evaluates the offsets of nCount points; percent scales the radial
+	//		part of the offset only
+	void EvalPoints(int nCount, const REAL *pX, const REAL *pY,
+		REAL *pDx, REAL *pDy, REAL percent = 1.0) const;
+	void EvalPoints(int nCount, const REAL *pXY, REAL *pOffsetXY,
+		REAL percent = 1.0) const;
+
+	// the kernel block of L times the radial weights: the radial part of
+	//		the field of pWx/pWy (nCenters each, no affine terms) at each
+	//		center.  this is the matvec for an iterative solve of L.
+	//		replaces the loaded weights
+	void MultiplyKernel(const REAL *pWx, const REAL *pWy, REAL *pResultX, REAL *pResultY);
+
+protected:
+	// builds the node for sorted centers [nStart, nEnd), in the square
+	//		at (minX, minY) of the given size; returns its index
+	int BuildNode(int nStart, int nEnd, REAL minX, REAL minY, REAL size, int nDepth);
+
+	// the radial part of the field at a point
+	template<class KERNEL>
+	void EvalRadialT(const KERNEL& kernel, REAL x, REAL y, REAL& dx, REAL& dy) const;
+
+	// the number of coefficients of a node
+	int GetCoefficientCount() const { return 2 * (4 + 2 * m_nOrder); }
+
+private:
+	// a node of the quadtree
+	struct CNode
+	{
+		// the centroid of the node's centers, and their largest
+		//		distance from it
+		REAL m_centroidX;
+		REAL m_centroidY;
+		REAL m_radius;
+
+		// the node's centers, in the sorted order
+		int m_nStart;
+		int m_nEnd;
+
+		// the non-empty quadrants, or -1
+		int m_arrChild[4];
+	};
+
+	// the tree, root first
+	std::vector<CNode> m_arrNodes;
+
+	// the expansion coefficients of each node, for the x then the y
+	//		weights: a0, a1, b0, b1, then the order terms of F, then of G
+	std::vector<std::complex<REAL> > m_arrCoefficients;
+
+	// the centers and radial weights, sorted so that each node's
+	//		centers are contiguous, and the original index of each
+	std::vector<REAL> m_arrCenterX;
+	std::vector<REAL> m_arrCenterY;
+	std::vector<REAL> m_arrWeightX;
+	std::vector<REAL> m_arrWeightY;
+	std::vector<int> m_arrOrder;
+
+	// the affine weights: constant, x and y terms
+	REAL m_affineX[3];
+	REAL m_affineY[3];
+
+	// the radial basis
+	CRadialBasis m_basis;
+
+	// the opening ratio, and the order of the expansions
+	REAL m_theta;
+	int m_nOrder;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::CTPSTreeEvaluator
+//
+// constructs an empty evaluator
+//////////////////////////////////////////////////////////////////////
+inline CTPSTreeEvaluator::CTPSTreeEvaluator()
+	: m_theta(0.5)
+	, m_nOrder(TREE_DEFAULT_ORDER)
+{
+	Clear();
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::SetOrder
+//
+// sets the order, and expands the loaded weights to it
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTreeEvaluator::SetOrder(int nOrder)
+{
+	m_nOrder = nOrder;
+
+	// the loaded weights, back in the original order
+	const int nCenters = GetCenterCount();
+	std::vector<REAL> arrWx(nCenters + 3), arrWy(nCenters + 3);
+	for (int nAt = 0; nAt < nCenters; nAt++)
+	{
+		arrWx[m_arrOrder[nAt]] = m_arrWeightX[nAt];
+		arrWy[m_arrOrder[nAt]] = m_arrWeightY[nAt];
+	}
+	for (int nAt = 0; nAt < 3; nAt++)
+	{
+		arrWx[nCenters + nAt] = m_affineX[nAt];
+		arrWy[nCenters + nAt] = m_affineY[nAt];
+	}
+	SetWeights(arrWx.data(), arrWy.data());
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::SetBasis
+//
+// sorts the centers into the tree, then loads the weights
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTreeEvaluator::SetBasis(int nCenters, const REAL *pCenterX, const REAL *pCenterY,
+	const REAL *pWx, const REAL *pWy, const CRadialBasis& basis)
+{
+	m_basis = basis;
+	m_arrNodes.clear();
+	m_arrCenterX.assign(pCenterX, pCenterX + nCenters);
+	m_arrCenterY.assign(pCenterY, pCenterY + nCenters);
+	m_arrOrder.resize(nCenters);
+	for (int nAt = 0; nAt < nCenters; nAt++)
+	{
+		m_arrOrder[nAt] = nAt;
+	}
+
+	if (nCenters > 0)
+	{
+		// the bounding square of the centers
+		REAL minX = *std::min_element(pCenterX, pCenterX + nCenters);
+		REAL maxX = *std::max_element(pCenterX, pCenterX + nCenters);
+		REAL minY = *std::min_element(pCenterY, pCenterY + nCenters);
+		REAL maxY = *std::max_element(pCenterY, pCenterY + nCenters);
+		BuildNode(0, nCenters, minX, minY, __max(maxX - minX, maxY - minY), 0);
+	}
+
+	SetWeights(pWx, pWy);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::BuildNode
+//
+// splits the centers into quadrants of the square until a node holds
+//		TREE_LEAF_SIZE or fewer
+//////////////////////////////////////////////////////////////////////
+inline int CTPSTreeEvaluator::BuildNode(int nStart, int nEnd, REAL minX, REAL minY, REAL size, int nDepth)
+{
+	const int nNode = (int) m_arrNodes.size();
+	m_arrNodes.push_back(CNode());
+	{
+		CNode& node = m_arrNodes.back();
+		node.m_nStart = nStart;
+		node.m_nEnd = nEnd;
+		std::fill(node.m_arrChild, node.m_arrChild + 4, -1);
+
+		node.m_centroidX = 0.0;
+		node.m_centroidY = 0.0;
+		for (int nAt = nStart; nAt < nEnd; nAt++)
+		{
+			node.m_centroidX += m_arrCenterX[nAt];
+			node.m_centroidY += m_arrCenterY[nAt];
+		}
+		node.m_centroidX /= (nEnd - nStart);
+		node.m_centroidY /= (nEnd - nStart);
+
+		REAL radius2 = 0.0;
+		for (int nAt = nStart; nAt < nEnd; nAt++)
+		{
+			const REAL diffX = m_arrCenterX[nAt] - node.m_centroidX;
+			const REAL diffY = m_arrCenterY[nAt] - node.m_centroidY;
+			radius2 = __max(radius2, diffX * diffX + diffY * diffY);
+		}
+		node.m_radius = sqrt(radius2);
+	}
+
+	if (nEnd - nStart <= TREE_LEAF_SIZE || nDepth >= TREE_MAX_DEPTH)
+	{
+		return nNode;
+	}
+
+	// sort the centers of the node by quadrant: 0 = (low x, low y),
+	//		1 = (high x, low y), 2 = (low x, high y), 3 = (high x, high y)
+	const REAL halfSize = 0.5 * size;
+	const REAL midX = minX + halfSize;
+	const REAL midY = minY + halfSize;
+	std::vector<int> arrQuadrant(nEnd - nStart);
+	for (int nAt = nStart; nAt < nEnd; nAt++)
+	{
+		arrQuadrant[nAt - nStart] = (m_arrCenterX[nAt] >= midX ? 1 : 0) + (m_arrCenterY[nAt] >= midY ? 2 : 0);
+	}
+
+	std::vector<int> arrSorted(nEnd - nStart);
+	for (int nAt = 0; nAt < nEnd - nStart; nAt++)
+	{
+		arrSorted[nAt] = nAt;
+	}
+	std::stable_sort(arrSorted.begin(), arrSorted.end(),
+		[&](int nLeft, int nRight) { return arrQuadrant[nLeft] < arrQuadrant[nRight]; });
+
+	std::vector<REAL> arrX(nEnd - nStart), arrY(nEnd - nStart);
+	std::vector<int> arrOrder(nEnd - nStart);
+	for (int nAt = 0; nAt < nEnd - nStart; nAt++)
+	{
+		arrX[nAt] = m_arrCenterX[nStart + arrSorted[nAt]];
+		arrY[nAt] = m_arrCenterY[nStart + arrSorted[nAt]];
+		arrOrder[nAt] = m_arrOrder[nStart + arrSorted[nAt]];
+	}
+	std::copy(arrX.begin(), arrX.end(), &m_arrCenterX[nStart]);
+	std::copy(arrY.begin(), arrY.end(), &m_arrCenterY[nStart]);
+	std::copy(arrOrder.begin(), arrOrder.end(), &m_arrOrder[nStart]);
+
+	// build each non-empty quadrant
+	int nChildStart = nStart;
+	for (int nQuadrant = 0; nQuadrant < 4; nQuadrant++)
+	{
+		int nChildEnd = nChildStart;
+		while (nChildEnd < nEnd && arrQuadrant[arrSorted[nChildEnd - nStart]] == nQuadrant)
+		{
+			nChildEnd++;
+		}
+
+		if (nChildEnd > nChildStart)
+		{
+			int nChild = BuildNode(nChildStart, nChildEnd,
+				(nQuadrant & 1) ? midX : minX, (nQuadrant & 2) ? midY : minY, halfSize, nDepth + 1);
+			m_arrNodes[nNode].m_arrChild[nQuadrant] = nChild;
+		}
+		nChildStart = nChildEnd;
+	}
+
+	return nNode;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::SetWeights
+//
+// loads the weights in the sorted order, and sums each node's moments
+//		directly over its centers into its expansion coefficients
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTreeEvaluator::SetWeights(const REAL *pWx, const REAL *pWy)
+{
+	const int nCenters = GetCenterCount();
+	m_arrWeightX.resize(nCenters);
+	m_arrWeightY.resize(nCenters);
+	for (int nAt = 0; nAt < nCenters; nAt++)
+	{
+		m_arrWeightX[nAt] = pWx[m_arrOrder[nAt]];
+		m_arrWeightY[nAt] = pWy[m_arrOrder[nAt]];
+	}
+
+	for (int nAt = 0; nAt < 3; nAt++)
+	{
+		m_affineX[nAt] = pWx[nCenters + nAt];
+		m_affineY[nAt] = pWy[nCenters + nAt];
+	}
+
+	const int nCoefficients = GetCoefficientCount();
+	m_arrCoefficients.assign(m_arrNodes.size() * nCoefficients, std::complex<REAL>(0.0, 0.0));
+
+	// the moments a(0..order+1) and b(0..order+1)
+	std::vector<std::complex<REAL> > arrA(m_nOrder + 2), arrB(m_nOrder + 2);
+	for (int nNode = 0; nNode < (int) m_arrNodes.size(); nNode++)
+	{
+		const CNode& node = m_arrNodes[nNode];
+		for (int nChannel = 0; nChannel < 2; nChannel++)
+		{
+			const std::vector<REAL>& arrWeight = (nChannel == 0) ? m_arrWeightX : m_arrWeightY;
+			std::fill(arrA.begin(), arrA.end(), std::complex<REAL>(0.0, 0.0));
+			std::fill(arrB.begin(), arrB.end(), std::complex<REAL>(0.0, 0.0));
+			for (int nAt = node.m_nStart; nAt < node.m_nEnd; nAt++)
+			{
+				const std::complex<REAL> t(m_arrCenterX[nAt] - node.m_centroidX, 
+					m_arrCenterY[nAt] - node.m_centroidY);
+				std::complex<REAL> wt(arrWeight[nAt], 0.0);
+				for (int nPower = 0; nPower < m_nOrder + 2; nPower++)
+				{
+					arrA[nPower] += wt;
+					arrB[nPower] += std::conj(t) * wt;
+					wt *= t;
+				}
+			}
+
+			std::complex<REAL> *pCoefficient = &m_arrCoefficients[nNode * nCoefficients 
+				+ nChannel * (nCoefficients / 2)];
+			pCoefficient[0] = arrA[0];
+			pCoefficient[1] = arrA[1];
+			pCoefficient[2] = arrB[0];
+			pCoefficient[3] = arrB[1];
+			for (int nTerm = 1; nTerm <= m_nOrder; nTerm++)
+			{
+				const REAL scale = 1.0 / (nTerm * (nTerm + 1.0));
+				pCoefficient[3 + nTerm] = arrA[nTerm + 1] * scale;
+				pCoefficient[3 + m_nOrder + nTerm] = arrB[nTerm + 1] * scale;
+			}
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::Clear
+//
+// removes all centers and zeros the affine part
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTreeEvaluator::Clear()
+{
+	m_arrNodes.clear();
+	m_arrCoefficients.clear();
+	m_arrCenterX.clear();
+	m_arrCenterY.clear();
+	m_arrWeightX.clear();
+	m_arrWeightY.clear();
+	m_arrOrder.clear();
+
+	for (int nAt = 0; nAt < 3; nAt++)
+	{
+		m_affineX[nAt] = 0.0;
+		m_affineY[nAt] = 0.0;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::EvalPoint
+//
+// evaluates the offset at a single point
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTreeEvaluator::EvalPoint(REAL x, REAL y, REAL& dx, REAL& dy) const
+{
+	EvalPoints(1, &x, &y, &dx, &dy);
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::EvalRow
+//
+// evaluates the offsets of nCount pixels along a row
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTreeEvaluator::EvalRow(REAL y, REAL x0, int nCount, REAL *pDx, REAL *pDy) const
+{
+	m_basis.Dispatch([&](const auto& kernel) {
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			const REAL x = x0 + (REAL) nAt;
+			EvalRadialT(kernel, x, y, pDx[nAt], pDy[nAt]);
+			pDx[nAt] += m_affineX[0] + m_affineX[1] * x + m_affineX[2] * y;
+			pDy[nAt] += m_affineY[0] + m_affineY[1] * x + m_affineY[2] * y;
+		}
+	});
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::EvalPoints
+//
+// evaluates the offsets of arbitrary points
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTreeEvaluator::EvalPoints(int nCount, const REAL *pX, const REAL *pY,
+	REAL *pDx, REAL *pDy, REAL percent) const
+{
+	m_basis.Dispatch([&](const auto& kernel) {
+		for (int nAt = 0; nAt < nCount; nAt++)
+		{
+			EvalRadialT(kernel, pX[nAt], pY[nAt], pDx[nAt], pDy[nAt]);
+			pDx[nAt] = pDx[nAt] * percent
+				+ m_affineX[0] + m_affineX[1] * pX[nAt] + m_affineX[2] * pY[nAt];
+			pDy[nAt] = pDy[nAt] * percent
+				+ m_affineY[0] + m_affineY[1] * pX[nAt] + m_affineY[2] * pY[nAt];
+		}
+	});
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::EvalPoints
+//
+// evaluates the offsets of interleaved points
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTreeEvaluator::EvalPoints(int nCount, const REAL *pXY, REAL *pOffsetXY,
+	REAL percent) const
+{
+	for (int nAt = 0; nAt < nCount; nAt++)
+	{
+		EvalPoints(1, &pXY[2 * nAt + 0], &pXY[2 * nAt + 1],
+			&pOffsetXY[2 * nAt + 0], &pOffsetXY[2 * nAt + 1], percent);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::MultiplyKernel
+//
+// loads the radial weights (with no affine part), evaluates the radial
+//		field at each center, and returns it in the original order
+//////////////////////////////////////////////////////////////////////
+inline void CTPSTreeEvaluator::MultiplyKernel(const REAL *pWx, const REAL *pWy,
+	REAL *pResultX, REAL *pResultY)
+{
+	const int nCenters = GetCenterCount();
+	std::vector<REAL> arrWx(pWx, pWx + nCenters), arrWy(pWy, pWy + nCenters);
+	arrWx.resize(nCenters + 3, 0.0);
+	arrWy.resize(nCenters + 3, 0.0);
+	SetWeights(arrWx.data(), arrWy.data());
+
+	m_basis.Dispatch([&](const auto& kernel) {
+		for (int nAt = 0; nAt < nCenters; nAt++)
+		{
+			EvalRadialT(kernel, m_arrCenterX[nAt], m_arrCenterY[nAt],
+				pResultX[m_arrOrder[nAt]], pResultY[m_arrOrder[nAt]]);
+		}
+	});
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTPSTreeEvaluator::EvalRadialT
+//
+// walks the tree from the root, expanding the far nodes and summing
+//		the near leaves
+//////////////////////////////////////////////////////////////////////
+template<class KERNEL>
+inline void CTPSTreeEvaluator::EvalRadialT(const KERNEL& kernel, REAL x, REAL y, REAL& dx, REAL& dy) const
+{
+	dx = 0.0;
+	dy = 0.0;
+	if (m_arrNodes.empty())
+	{
+		return;
+	}
+
+	// only the thin plate basis has an expansion
+	const REAL theta2 = (m_basis.GetKernelType() == CRadialBasis::THIN_PLATE)
+		? m_theta * m_theta : 0.0;
+	const int nCoefficients = GetCoefficientCount();
+
+	int arrStack[3 * TREE_MAX_DEPTH + 4];
+	int nStack = 0;
+	arrStack[nStack++] = 0;
+	while (nStack > 0)
+	{
+		const int nNode = arrStack[--nStack];
+		const CNode& node = m_arrNodes[nNode];
+		const std::complex<REAL> z(x - node.m_centroidX, y - node.m_centroidY);
+		const REAL s = std::norm(z);
+
+		const bool bLeaf = node.m_arrChild[0] < 0 && node.m_arrChild[1] < 0
+			&& node.m_arrChild[2] < 0 && node.m_arrChild[3] < 0;
+		if (!bLeaf && node.m_radius * node.m_radius < theta2 * s)
+		{
+			// far: sum the expansion, with the series in 1/z by Horner's rule
+			const std::complex<REAL> logZ = std::log(z);
+			const std::complex<REAL> invZ = 1.0 / z;
+			for (int nChannel = 0; nChannel < 2; nChannel++)
+			{
+				const std::complex<REAL> *pCoefficient = &m_arrCoefficients[nNode * nCoefficients
+					+ nChannel * (nCoefficients / 2)];
+				std::complex<REAL> seriesF(0.0, 0.0), seriesG(0.0, 0.0);
+				for (int nTerm = m_nOrder; nTerm >= 1; nTerm--)
+				{
+					seriesF = (seriesF + pCoefficient[3 + nTerm]) * invZ;
+					seriesG = (seriesG + pCoefficient[3 + m_nOrder + nTerm]) * invZ;
+				}
+				const std::complex<REAL> F = (pCoefficient[0] * z - pCoefficient[1]) * logZ - pCoefficient[1] + seriesF;
+				const std::complex<REAL> G = (pCoefficient[2] * z - pCoefficient[3]) * logZ - pCoefficient[3] + seriesG;
+				const REAL d = m_basis.GetK() * std::real(std::conj(z) * F - G);
+				(nChannel == 0 ? dx : dy) += d;
+			}
+		}
+		else if (bLeaf)
+		{
+			// near leaf: sum exactly
+			for (int nAt = node.m_nStart; nAt < node.m_nEnd; nAt++)
+			{
+				const REAL diffX = x - m_arrCenterX[nAt];
+				const REAL diffY = y - m_arrCenterY[nAt];
+				const REAL d = kernel(diffX * diffX + diffY * diffY);
+				dx += m_arrWeightX[nAt] * d;
+				dy += m_arrWeightY[nAt] * d;
+			}
+		}
+		else
+		{
+			// near: open the node
+			for (int nChild = 0; nChild < 4; nChild++)
+			{
+				if (node.m_arrChild[nChild] >= 0)
+				{
+					arrStack[nStack++] = node.m_arrChild[nChild];
+				}
+			}
+		}
+	}
+}
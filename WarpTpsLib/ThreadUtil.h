@@ -0,0 +1,113 @@
+//////////////////////////////////////////////////////////////////////
+// ThreadUtil.h: helpers for spreading loops across worker threads
+//
+// Copyright (C) 2002-2025 Derek Lane
+//////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <exception>
+
+//////////////////////////////////////////////////////////////////////
+// GetHardwareThreadCount
+//
+// returns the number of hardware threads, or 1 if it can not be
+//		determined
+//////////////////////////////////////////////////////////////////////
+inline int GetHardwareThreadCount()
+{
+	int nThreads = (int) std::thread::hardware_concurrency();
+	return (nThreads > 0) ? nThreads : 1;
+}
+
+//////////////////////////////////////////////////////////////////////
+// ParallelForRows
+//
+// calls func(nStartRow, nEndRow) over consecutive bands of rows,
+//		handing the bands out to nThreads workers (nThreads <= 0 uses
+//		all hardware threads).  each band goes to exactly one worker,
+//		so a func that only writes its own rows needs no locking.
+//		with one thread (or one band) func runs on the caller's thread
+//////////////////////////////////////////////////////////////////////
+template<class FUNC>
+inline void ParallelForRows(int nRows, int nThreads, FUNC func, int nRowsPerBand = 0)
+{
+	if (nRows <= 0)
+	{
+		return;
+	}
+
+	if (nThreads <= 0)
+	{
+		nThreads = GetHardwareThreadCount();
+	}
+
+	// default to several bands per worker, so that uneven rows balance
+	if (nRowsPerBand <= 0)
+	{
+		nRowsPerBand = nRows / (nThreads * 8);
+		if (nRowsPerBand < 1) nRowsPerBand = 1;
+	}
+
+	int nBands = (nRows + nRowsPerBand - 1) / nRowsPerBand;
+	if (nThreads > nBands)
+	{
+		nThreads = nBands;
+	}
+
+	if (nThreads <= 1)
+	{
+		func(0, nRows);
+		return;
+	}
+
+	// the next band to be handed out
+	std::atomic<int> nNextBand(0);
+
+	// the first exception thrown by a worker, rethrown on the caller
+	std::exception_ptr pException;
+	std::atomic<bool> bFailed(false);
+
+	auto worker = [&]()
+	{
+		try
+		{
+			for (int nBand = nNextBand++; nBand < nBands && !bFailed; nBand = nNextBand++)
+			{
+				int nStartRow = nBand * nRowsPerBand;
+				int nEndRow = (nStartRow + nRowsPerBand < nRows)
+					? nStartRow + nRowsPerBand : nRows;
+				func(nStartRow, nEndRow);
+			}
+		}
+		catch (...)
+		{
+			if (!bFailed.exchange(true))
+			{
+				pException = std::current_exception();
+			}
+		}
+	};
+
+	// the caller's thread works too
+	std::vector<std::thread> arrThreads;
+	arrThreads.reserve(nThreads - 1);
+	for (int nAt = 0; nAt < nThreads - 1; nAt++)
+	{
+		arrThreads.emplace_back(worker);
+	}
+	worker();
+
+	for (auto& thread : arrThreads)
+	{
+		thread.join();
+	}
+
+	if (pException)
+	{
+		std::rethrow_exception(pException);
+	}
+}
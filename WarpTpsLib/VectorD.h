@@ -13,6 +13,9 @@
 // base class include
 #include "VectorBase.h"
 
+// the trivially copyable vector used internally
+#include "FixedVector.h"
+
 //////////////////////////////////////////////////////////////////////
 // class CVectorD<DIM, TYPE>
 //
@@ -30,6 +33,7 @@ public:
 	CVectorD(TYPE x, TYPE y, TYPE z, TYPE w);
 	CVectorD(const CVectorD& vFrom);
 	explicit CVectorD(const CVectorBase<TYPE>& vFrom);
+	CVectorD(const CFixedVector<DIM, TYPE>& vFrom);
 #ifdef __AFX_H__
 	CVectorD(const CPoint& pt);
 #endif
@@ -43,6 +47,9 @@ public:
 	operator CPoint() const;
 #endif
 
+	// the elements as a trivially copyable CFixedVector
+	CFixedVector<DIM, TYPE> GetFixed() const;
+
 	// tests for approximate equality using the EPS defined at the 
 	//		top of this file
 	BOOL IsApproxEqual(const CVectorD& v, TYPE epsilon = DEFAULT_EPSILON) const;
@@ -231,6 +238,24 @@ CVectorD<DIM, TYPE>::CVectorD(const CVectorBase<TYPE>& vFrom)
 }	// CVectorD<DIM, TYPE>::CVectorD<DIM, TYPE>(const CVectorBase<TYPE>& vFrom) 
 
 
+//////////////////////////////////////////////////////////////////
+// CVectorD<DIM, TYPE>::CVectorD<DIM, TYPE>(const CFixedVector<DIM, TYPE>& vFrom) 
+//
+// construct from a fixed vector
+//////////////////////////////////////////////////////////////////
+template<int DIM, class TYPE>
+CVectorD<DIM, TYPE>::CVectorD(const CFixedVector<DIM, TYPE>& vFrom) 
+{
+	// set the elements pointer to the static array 
+	//		and initialize the dimension
+	SetElements(DIM, const_cast<TYPE*>(&this->point().get<0>()), FALSE);
+
+	// copy the elements
+	memcpy((*this), vFrom.GetElements(), DIM * sizeof(TYPE));
+
+}	// CVectorD<DIM, TYPE>::CVectorD<DIM, TYPE>(const CFixedVector<DIM, TYPE>& vFrom) 
+
+
 #ifdef __AFX_H__
 //////////////////////////////////////////////////////////////////
 // CVectorD<DIM, TYPE>::CVectorD<DIM, TYPE>(const CPoint& pt)
@@ -311,6 +336,22 @@ CVectorD<DIM, TYPE>& CVectorD<DIM, TYPE>::operator=(const CVectorD<DIM, TYPE>& v
 }	// CVectorD<DIM, TYPE>& CVectorD<DIM, TYPE>::operator=
 
 
+//////////////////////////////////////////////////////////////////
+// CVectorD<DIM, TYPE>::GetFixed
+//
+// returns a copy of the elements as a fixed vector
+//////////////////////////////////////////////////////////////////
+template<int DIM, class TYPE>
+CFixedVector<DIM, TYPE> CVectorD<DIM, TYPE>::GetFixed() const
+{
+	CFixedVector<DIM, TYPE> vFixed;
+	memcpy(vFixed.GetElements(), (const TYPE *)(*this), DIM * sizeof(TYPE));
+
+	return vFixed;
+
+}	// CVectorD<DIM, TYPE>::GetFixed
+
+
 //////////////////////////////////////////////////////////////////
 // CVectorD<DIM, TYPE>::IsApproxEqual
 //
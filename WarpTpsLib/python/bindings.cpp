@@ -5,6 +5,9 @@
 #include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 
+#include <optional>
+#include <type_traits>
+
 // WarpTpsLib headers
 #include "../TPSTransform.h"
 #include "../VectorD.h"
@@ -27,8 +30,10 @@ py::tuple vector3_to_tuple(const CVectorD<3>& v) {
     return py::make_tuple(v[0], v[1], v[2]);
 }
 
-// Wrapper for ResampleRaw to work with numpy arrays
-void resample_numpy(CTPSTransform& self,
+// Wrapper for ResampleRaw to work with numpy arrays, for a transform or
+// a snapshot
+template<class TRANSFORM>
+void resample_numpy(TRANSFORM& self,
                    py::array_t<uint8_t> src_array,
                    py::array_t<uint8_t> dst_array,
                    float percent) {
@@ -61,12 +66,19 @@ void resample_numpy(CTPSTransform& self,
     // Calculate stride (bytes per row)
     size_t stride = width * channels;
 
+    // A snapshot is const throughout, so other Python threads can run meanwhile
+    std::optional<py::gil_scoped_release> release;
+    if (std::is_const<TRANSFORM>::value) {
+        release.emplace();
+    }
+
     // Call the actual ResampleRaw function
     self.ResampleRaw(src_ptr, dst_ptr, channels, width, height, stride, percent);
 }
 
 // Wrapper for ResampleRawWithField to work with numpy arrays
-void resample_with_field_numpy(CTPSTransform& self,
+template<class TRANSFORM>
+void resample_with_field_numpy(TRANSFORM& self,
                                py::array_t<uint8_t> src_array,
                                py::array_t<uint8_t> dst_array,
                                float percent) {
@@ -99,10 +111,48 @@ void resample_with_field_numpy(CTPSTransform& self,
     // Calculate stride (bytes per row)
     size_t stride = width * channels;
 
+    // A snapshot is const throughout, so other Python threads can run meanwhile
+    std::optional<py::gil_scoped_release> release;
+    if (std::is_const<TRANSFORM>::value) {
+        release.emplace();
+    }
+
     // Call the actual ResampleRawWithField function
     self.ResampleRawWithField(src_ptr, dst_ptr, channels, width, height, stride, percent);
 }
 
+// Wrapper for EvalPoints to work with an (N, 2) numpy array of positions
+template<class TRANSFORM>
+py::array_t<double> eval_points_numpy(TRANSFORM& self,
+                                      py::array_t<double, py::array::c_style | py::array::forcecast> positions,
+                                      float percent) {
+
+    // Get buffer info
+    py::buffer_info pos_info = positions.request();
+
+    // Validate dimensions
+    if (pos_info.ndim != 2 || pos_info.shape[1] != 2) {
+        throw std::runtime_error("Positions must be a 2D array of shape (N, 2)");
+    }
+
+    // Offsets come back in the same (N, 2) layout
+    py::ssize_t count = pos_info.shape[0];
+    py::array_t<double> offsets(std::vector<py::ssize_t>{count, 2});
+    py::buffer_info off_info = offsets.request();
+
+    {
+        std::optional<py::gil_scoped_release> release;
+        if (std::is_const<TRANSFORM>::value) {
+            release.emplace();
+        }
+        self.EvalPoints(static_cast<int>(count),
+                        static_cast<const double*>(pos_info.ptr),
+                        static_cast<double*>(off_info.ptr),
+                        percent);
+    }
+    return offsets;
+}
+
 // Main pybind11 module definition
 PYBIND11_MODULE(_warptps_core, m) {
     m.doc() = "WarpTPS Python bindings - Thin Plate Spline transformations for image warping";
@@ -135,6 +185,24 @@ PYBIND11_MODULE(_warptps_core, m) {
         .def_property_readonly("y", [](const CVectorD<3>& v) { return v[1]; })
         .def_property_readonly("z", [](const CVectorD<3>& v) { return v[2]; });
 
+    // CDisplacementField::Format bindings
+    py::enum_<CDisplacementField::Format>(m, "FieldFormat")
+        .value("DOUBLE", CDisplacementField::FORMAT_DOUBLE)
+        .value("FLOAT", CDisplacementField::FORMAT_FLOAT)
+        .value("FIXED16", CDisplacementField::FORMAT_FIXED16);
+
+    // Radial basis kernels
+    py::enum_<CRadialBasis::KernelType>(m, "KernelType")
+        .value("THIN_PLATE", CRadialBasis::THIN_PLATE)
+        .value("EVEN_POWER", CRadialBasis::EVEN_POWER)
+        .value("ODD_POWER", CRadialBasis::ODD_POWER)
+        .value("GENERAL_POWER", CRadialBasis::GENERAL_POWER)
+        .value("WENDLAND_C2", CRadialBasis::WENDLAND_C2)
+        .value("WENDLAND_C4", CRadialBasis::WENDLAND_C4)
+        .value("GAUSSIAN", CRadialBasis::GAUSSIAN)
+        .value("MULTIQUADRIC", CRadialBasis::MULTIQUADRIC)
+        .value("INVERSE_MULTIQUADRIC", CRadialBasis::INVERSE_MULTIQUADRIC);
+
     // CTPSTransform class bindings
     py::class_<CTPSTransform>(m, "TPSTransform")
         .def(py::init<>(), "Create a new TPS transform")
@@ -153,6 +221,34 @@ PYBIND11_MODULE(_warptps_core, m) {
              py::arg("source"), py::arg("destination"),
              "Add a landmark pair using Python tuples (x, y) or (x, y, z)")
 
+        .def("add_landmarks",
+             [](CTPSTransform& self,
+                py::array_t<double, py::array::c_style | py::array::forcecast> source,
+                py::array_t<double, py::array::c_style | py::array::forcecast> destination) {
+                 py::buffer_info src_info = source.request();
+                 py::buffer_info dst_info = destination.request();
+                 if (src_info.ndim != 2 || src_info.shape[1] != 2
+                     || dst_info.ndim != 2 || dst_info.shape[1] != 2
+                     || src_info.shape[0] != dst_info.shape[0]) {
+                     throw std::runtime_error("Landmarks must be two (N, 2) arrays");
+                 }
+                 return self.AddLandmarks(static_cast<int>(src_info.shape[0]),
+                                          static_cast<const double*>(src_info.ptr),
+                                          static_cast<const double*>(dst_info.ptr));
+             },
+             py::arg("source"), py::arg("destination"),
+             "Add many landmark pairs from (N, 2) arrays as one update; returns the first index")
+
+        .def("begin_update", &CTPSTransform::BeginUpdate,
+             "Start a batch of edits; the warp is not recalculated, and evaluates as before\n"
+             "the batch, until the matching end_update")
+
+        .def("end_update", &CTPSTransform::EndUpdate,
+             "End a batch of edits; the next evaluation solves once for all of them")
+
+        .def("is_updating", &CTPSTransform::IsUpdating,
+             "Check whether a batch of edits is open")
+
         .def("get_landmark_count", &CTPSTransform::GetLandmarkCount,
              "Get the number of landmarks")
 
@@ -160,9 +256,26 @@ PYBIND11_MODULE(_warptps_core, m) {
              py::arg("index"),
              "Get a landmark pair at the given index")
 
-        .def("set_landmark_tuple", &CTPSTransform::SetLandmarkTuple,
-             py::arg("index"), py::arg("tuple"),
-             "Set a landmark pair at the given index")
+        .def("set_landmark_tuple",
+             [](CTPSTransform& self, int index, py::tuple src, py::tuple dst) {
+                 if (index < 0 || index >= self.GetLandmarkCount()) {
+                     throw py::index_error("Index out of range");
+                 }
+                 self.SetLandmark<0>(index, tuple_to_vector3(src));
+                 self.SetLandmark<1>(index, tuple_to_vector3(dst));
+             },
+             py::arg("index"), py::arg("source"), py::arg("destination"),
+             "Move the landmark pair at the given index, using Python tuples")
+
+        .def("remove_landmark",
+             [](CTPSTransform& self, int index) {
+                 if (index < 0 || index >= self.GetLandmarkCount()) {
+                     throw py::index_error("Index out of range");
+                 }
+                 self.RemoveLandmark(index);
+             },
+             py::arg("index"),
+             "Remove the landmark pair at the given index")
 
         .def("remove_all_landmarks", &CTPSTransform::RemoveAllLandmarks,
              "Remove all landmarks from the transform")
@@ -176,6 +289,114 @@ PYBIND11_MODULE(_warptps_core, m) {
              py::arg("k"),
              "Set the radial basis function scaling factor (default: 1.0)")
 
+        .def("set_support_radius", &CTPSTransform::SetSupportRadius,
+             py::arg("radius"), py::arg("continuity") = 2,
+             "Use a compactly supported Wendland basis (C2 or C4) of this radius, so each\n"
+             "landmark only moves nearby pixels and the solve is sparse (0 = global basis)")
+
+        .def("get_support_radius", &CTPSTransform::GetSupportRadius,
+             "Get the support radius of the basis (0 for the global basis)")
+
+        .def("set_kernel", &CTPSTransform::SetKernel,
+             py::arg("kernel"), py::arg("scale"),
+             "Select the radial basis (KernelType.GAUSSIAN, MULTIQUADRIC, INVERSE_MULTIQUADRIC,\n"
+             "WENDLAND_C2 or C4) with its length scale c; THIN_PLATE or a scale of 0 restores\n"
+             "the polyharmonic r^r_exp * log(r) basis")
+
+        .def("get_kernel_type", &CTPSTransform::GetKernelType,
+             "Get the radial basis kernel in use")
+
+        .def("get_kernel_scale", &CTPSTransform::GetKernelScale,
+             "Get the length scale of the radial basis (0 for polyharmonic)")
+
+        .def("set_thread_count", &CTPSTransform::SetThreadCount,
+             py::arg("threads"),
+             "Set the number of threads used to resample (1 = serial, 0 = all cores)")
+
+        .def("get_thread_count", &CTPSTransform::GetThreadCount,
+             "Get the number of threads used to resample")
+
+        .def("set_basis_field_cache_size", &CTPSTransform::SetBasisFieldCacheSize,
+             py::arg("bytes"),
+             "Set the memory budget for caching per-landmark fields (0 = off);\n"
+             "with a budget, moving a destination again updates the presampled field cheaply")
+
+        .def("get_basis_field_cache_size", &CTPSTransform::GetBasisFieldCacheSize,
+             "Get the memory budget for caching per-landmark fields")
+
+        .def("set_field_format", &CTPSTransform::SetFieldFormat,
+             py::arg("format"), py::arg("subpixels") = 32.0,
+             "Set how the presampled field is stored (FieldFormat.DOUBLE, FLOAT or FIXED16);\n"
+             "FIXED16 stores offsets in steps of 1/subpixels")
+
+        .def("get_field_format", &CTPSTransform::GetFieldFormat,
+             "Get how the presampled field is stored")
+
+        .def("set_single_precision", &CTPSTransform::SetSinglePrecision,
+             py::arg("single"),
+             "Sum the presampled field in float32 (weights are still solved in double);\n"
+             "stays in double when the error bound for the image is over 1/64 pixel")
+
+        .def("get_single_precision", &CTPSTransform::GetSinglePrecision,
+             "Get whether the presampled field is summed in float32")
+
+        .def("set_presample_tolerance", &CTPSTransform::SetPresampleTolerance,
+             py::arg("tolerance"),
+             "Set the tolerance in pixels for interpolating the presampled field\n"
+             "from an adaptive lattice (0 = evaluate every pixel)")
+
+        .def("get_presample_tolerance", &CTPSTransform::GetPresampleTolerance,
+             "Get the tolerance for interpolating the presampled field")
+
+        .def("set_far_field_theta", &CTPSTransform::SetFarFieldTheta,
+             py::arg("theta"),
+             "Set the opening ratio for evaluating the field with a tree of far field\n"
+             "expansions, for thousands of landmarks (0 = exact sum, the default)")
+
+        .def("get_far_field_theta", &CTPSTransform::GetFarFieldTheta,
+             "Get the opening ratio of the far field tree")
+
+        .def("set_iterative_solve_threshold", &CTPSTransform::SetIterativeSolveThreshold,
+             py::arg("landmarks"),
+             "Solve for the weights by preconditioned GMRES from this many landmarks on,\n"
+             "instead of factoring the dense matrix (0 = never, the default)")
+
+        .def("get_iterative_solve_threshold", &CTPSTransform::GetIterativeSolveThreshold,
+             "Get the landmark count from which the weights are solved iteratively")
+
+        .def("get_iterative_solve_iterations", &CTPSTransform::GetIterativeSolveIterations,
+             "Get the GMRES iterations of the last iterative solve")
+
+        .def("set_mixed_precision_threshold", &CTPSTransform::SetMixedPrecisionThreshold,
+             py::arg("landmarks"),
+             "Factor the equilibrated matrix in float32 from this many landmarks on, and refine\n"
+             "each solve in double to full accuracy (0 = never, the default)")
+
+        .def("get_mixed_precision_threshold", &CTPSTransform::GetMixedPrecisionThreshold,
+             "Get the landmark count from which the weights are solved in mixed precision")
+
+        .def("get_mixed_precision_residual", &CTPSTransform::GetMixedPrecisionResidual,
+             "Get the backward error reached by the last mixed precision solve")
+
+        .def("get_condition_estimate", &CTPSTransform::GetConditionEstimate,
+             "Get the estimated condition number of the equilibrated matrix of the last\n"
+             "mixed precision solve")
+
+        .def("set_approximate_center_count", &CTPSTransform::SetApproximateCenterCount,
+             py::arg("centers"),
+             "With more landmarks than this, fit a TPS on this many of them by least squares,\n"
+             "so landmarks are only approximately matched (0 = off, the default)")
+
+        .def("get_approximate_center_count", &CTPSTransform::GetApproximateCenterCount,
+             "Get the number of centers of the approximate TPS")
+
+        .def("set_approximate_regularization", &CTPSTransform::SetApproximateRegularization,
+             py::arg("lambda_"),
+             "Set the weight of the bending energy in the approximate fit")
+
+        .def("get_approximate_regularization", &CTPSTransform::GetApproximateRegularization,
+             "Get the weight of the bending energy in the approximate fit")
+
         // Evaluation
         .def("eval",
              [](CTPSTransform& self, py::tuple pos, float percent) {
@@ -203,8 +424,17 @@ PYBIND11_MODULE(_warptps_core, m) {
              py::arg("position"), py::arg("percent") = 1.0f,
              "Evaluate the displacement vector field at a position")
 
+        .def("eval_points", &eval_points_numpy<CTPSTransform>,
+             py::arg("positions"), py::arg("percent") = 1.0f,
+             "Evaluate the displacement at many positions at once\n"
+             "Args:\n"
+             "    positions: numpy array (N, 2) of x, y positions\n"
+             "    percent: morphing percentage (0.0 to 1.0)\n"
+             "Returns:\n"
+             "    numpy array (N, 2) of x, y offsets")
+
         // Image resampling
-        .def("resample", &resample_numpy,
+        .def("resample", &resample_numpy<CTPSTransform>,
              py::arg("source"), py::arg("destination"), py::arg("percent") = 1.0f,
              "Resample source image to destination using TPS transform\n"
              "Args:\n"
@@ -212,7 +442,7 @@ PYBIND11_MODULE(_warptps_core, m) {
              "    destination: numpy array (height, width, channels) dtype=uint8\n"
              "    percent: morphing percentage (0.0 to 1.0)")
 
-        .def("resample_with_field", &resample_with_field_numpy,
+        .def("resample_with_field", &resample_with_field_numpy<CTPSTransform>,
              py::arg("source"), py::arg("destination"), py::arg("percent") = 1.0f,
              "Resample using presampled displacement field (faster for multiple calls)\n"
              "Args:\n"
@@ -220,11 +450,49 @@ PYBIND11_MODULE(_warptps_core, m) {
              "    destination: numpy array (height, width, channels) dtype=uint8\n"
              "    percent: morphing percentage (0.0 to 1.0)")
 
+        .def("compile",
+             [](CTPSTransform& self, int width, int height) {
+                 if (self.IsUpdating()) {
+                     throw std::runtime_error("Cannot compile between begin_update and end_update");
+                 }
+                 // the snapshot has no mutators, so Python can hold it as non-const
+                 return std::const_pointer_cast<CTPSSnapshot>(self.Compile(width, height));
+             },
+             py::arg("width") = 0, py::arg("height") = 0,
+             "Compile the current weights, and for a nonzero size the presampled field,\n"
+             "into an immutable TPSSnapshot that many threads can render from at once;\n"
+             "raises RuntimeError between begin_update and end_update")
+
         .def("__repr__", [](const CTPSTransform& self) {
             return "<TPSTransform with " + std::to_string(
                 const_cast<CTPSTransform&>(self).GetLandmarkCount()) + " landmarks>";
         });
 
+    // CTPSSnapshot class bindings
+    py::class_<CTPSSnapshot, std::shared_ptr<CTPSSnapshot>>(m, "TPSSnapshot")
+        .def("get_landmark_count", &CTPSSnapshot::GetLandmarkCount,
+             "Get the number of landmarks the snapshot was compiled with")
+
+        .def("has_presampled_field", &CTPSSnapshot::HasPresampledField,
+             py::arg("width"), py::arg("height"),
+             "Check whether the snapshot holds a presampled field for the size")
+
+        .def("eval_points", &eval_points_numpy<const CTPSSnapshot>,
+             py::arg("positions"), py::arg("percent") = 1.0f,
+             "Evaluate the displacement at many positions at once, without the GIL")
+
+        .def("resample", &resample_numpy<const CTPSSnapshot>,
+             py::arg("source"), py::arg("destination"), py::arg("percent") = 1.0f,
+             "Resample source image to destination, evaluating the field, without the GIL")
+
+        .def("resample_with_field", &resample_with_field_numpy<const CTPSSnapshot>,
+             py::arg("source"), py::arg("destination"), py::arg("percent") = 1.0f,
+             "Resample using the compiled field (or evaluating, without one), without the GIL")
+
+        .def("__repr__", [](const CTPSSnapshot& self) {
+            return "<TPSSnapshot with " + std::to_string(self.GetLandmarkCount()) + " landmarks>";
+        });
+
     // Module-level functions
     m.def("version", []() {
         return "1.0.0";
@@ -34,7 +34,10 @@ import numpy as np
 try:
     from ._warptps_core import (
         TPSTransform as _TPSTransform,
+        TPSSnapshot,
         Vector3D,
+        FieldFormat,
+        KernelType,
         version as _version,
     )
 except ImportError as e:
@@ -44,7 +47,7 @@ except ImportError as e:
     ) from e
 
 __version__ = "1.0.0"
-__all__ = ["TPSTransform", "Vector3D", "warp_image", "morph_images"]
+__all__ = ["TPSTransform", "TPSSnapshot", "Vector3D", "FieldFormat", "KernelType", "warp_image", "morph_images"]
 
 
 class TPSTransform(_TPSTransform):
@@ -83,13 +86,17 @@ class TPSTransform(_TPSTransform):
         if len(source_points.shape) != 2 or source_points.shape[1] not in (2, 3):
             raise ValueError("Point arrays must be Nx2 or Nx3")
 
-        for src, dst in zip(source_points, dest_points):
-            if len(src) == 2:
-                self.add_landmark_tuple((float(src[0]), float(src[1])),
-                                       (float(dst[0]), float(dst[1])))
-            else:
+        if source_points.shape[1] == 2:
+            super().add_landmarks(source_points, dest_points)
+            return
+
+        self.begin_update()
+        try:
+            for src, dst in zip(source_points, dest_points):
                 self.add_landmark_tuple((float(src[0]), float(src[1]), float(src[2])),
                                        (float(dst[0]), float(dst[1]), float(dst[2])))
+        finally:
+            self.end_update()
 
     def transform_points(self, points: np.ndarray, percent: float = 1.0) -> np.ndarray:
         """
@@ -106,13 +113,10 @@ class TPSTransform(_TPSTransform):
         if len(points.shape) != 2 or points.shape[1] not in (2, 3):
             raise ValueError("Points must be Nx2 or Nx3 array")
 
-        result = np.zeros_like(points)
-        for i, pt in enumerate(points):
-            if len(pt) == 2:
-                offset = self.eval((float(pt[0]), float(pt[1])), percent)
-            else:
-                offset = self.eval((float(pt[0]), float(pt[1]), float(pt[2])), percent)
-            result[i] = pt + np.array(offset[:len(pt)])
+        # the offsets are planar, so only x and y move
+        offsets = self.eval_points(points[:, :2], percent)
+        result = np.array(points, copy=True)
+        result[:, :2] = points[:, :2] + offsets
 
         return result
 
@@ -35,6 +35,10 @@ CWarpTPSDoc::CWarpTPSDoc()
 		// initialize each image
 		m_pImage[nAt] = NULL;
 	}
+
+	// dragging a destination landmark then only adds its cached field
+	m_transform.SetBasisFieldCacheSize(256 * 1024 * 1024);
+	m_inversetransform.SetBasisFieldCacheSize(256 * 1024 * 1024);
 }
 
 CWarpTPSDoc::~CWarpTPSDoc()
@@ -5,6 +5,20 @@ import numpy as np
 import pytest
 
 
+def add_warp_landmarks(tps, width, height):
+    """Pin three corners, and displace one landmark about halfway in by (6, 5)."""
+    x, y = width * 15 // 32, height * 5 // 12
+    tps.add_landmark_tuple((0, 0), (0, 0))
+    tps.add_landmark_tuple((width - 1, 0), (width - 1, 0))
+    tps.add_landmark_tuple((0, height - 1), (0, height - 1))
+    tps.add_landmark_tuple((x, y), (x + 6, y + 5))
+
+
+def make_test_image(width, height):
+    """A deterministic RGB test image."""
+    return (np.arange(height * width * 3) % 251).astype(np.uint8).reshape(height, width, 3)
+
+
 def test_import():
     """Test that the module can be imported."""
     import warptps
@@ -63,6 +77,38 @@ def test_add_multiple_landmarks():
     assert tps.get_landmark_count() == 3
 
 
+def test_batched_update():
+    """Test that edits inside begin_update/end_update only apply at the end."""
+    import warptps
+    tps = warptps.TPSTransform()
+    tps.add_landmarks(np.array([[0, 0], [127, 0], [0, 95], [60, 40]]),
+                      np.array([[0, 0], [127, 0], [0, 95], [66, 45]]))
+    points = np.array([[10.5, 20.25], [64.0, 48.0], [100.0, 80.0]])
+    before = tps.transform_points(points)
+
+    tps.begin_update()
+    assert tps.is_updating()
+    tps.add_landmark_tuple((100, 70), (90, 75))
+    np.testing.assert_array_equal(tps.transform_points(points), before)
+    with pytest.raises(RuntimeError):
+        tps.compile()
+    tps.end_update()
+    assert not tps.is_updating()
+    assert tps.compile().get_landmark_count() == 5
+
+    expected = warptps.TPSTransform()
+    expected.add_landmarks(np.array([[0, 0], [127, 0], [0, 95], [60, 40], [100, 70]]),
+                           np.array([[0, 0], [127, 0], [0, 95], [66, 45], [90, 75]]))
+    np.testing.assert_allclose(tps.transform_points(points),
+                               expected.transform_points(points), atol=1e-8)
+
+    # an unbalanced end_update is ignored
+    tps.end_update()
+    tps.begin_update()
+    assert tps.is_updating()
+    tps.end_update()
+
+
 def test_remove_landmarks():
     """Test removing all landmarks."""
     import warptps
@@ -76,6 +122,65 @@ def test_remove_landmarks():
     assert tps.get_landmark_count() == 0
 
 
+def test_remove_landmark():
+    """Test that removing a landmark gives the field without it."""
+    import warptps
+    import numpy as np
+
+    rng = np.random.default_rng(6)
+    source = rng.uniform(0, 200, (40, 2))
+    dest = source + rng.uniform(-5, 5, (40, 2))
+
+    tps = warptps.TPSTransform()
+    tps.add_landmarks(source, dest)
+    points = rng.uniform(0, 200, (20, 2))
+    tps.transform_points(points)
+
+    # add one more, then remove two, so that the factors are updated
+    tps.add_landmark_tuple((100.5, 99.5), (103.0, 97.0))
+    tps.transform_points(points)
+    tps.remove_landmark(40)
+    tps.remove_landmark(7)
+    assert tps.get_landmark_count() == 39
+
+    expected = warptps.TPSTransform()
+    expected.add_landmarks(np.delete(source, 7, axis=0), np.delete(dest, 7, axis=0))
+    np.testing.assert_allclose(tps.transform_points(points),
+                               expected.transform_points(points), atol=1e-6)
+
+    # indices past the end raise rather than corrupt the transform
+    with pytest.raises(IndexError):
+        tps.remove_landmark(39)
+    with pytest.raises(IndexError):
+        tps.set_landmark_tuple(-1, (0, 0), (1, 1))
+    assert tps.get_landmark_count() == 39
+
+
+def test_drag_source_landmark():
+    """Test that moving a source landmark gives the field built from scratch."""
+    import warptps
+    import numpy as np
+
+    rng = np.random.default_rng(7)
+    source = rng.uniform(0, 200, (40, 2))
+    dest = source + rng.uniform(-5, 5, (40, 2))
+
+    tps = warptps.TPSTransform()
+    tps.add_landmarks(source, dest)
+    points = rng.uniform(0, 200, (20, 2))
+
+    for step in range(5):
+        tps.transform_points(points)
+        source[3] += (1.0, -0.5)
+        tps.set_landmark_tuple(3, (source[3][0], source[3][1]),
+                               (dest[3][0], dest[3][1]))
+
+    expected = warptps.TPSTransform()
+    expected.add_landmarks(source, dest)
+    np.testing.assert_allclose(tps.transform_points(points),
+                               expected.transform_points(points), atol=1e-6)
+
+
 def test_set_parameters():
     """Test setting TPS parameters."""
     import warptps
@@ -86,6 +191,253 @@ def test_set_parameters():
     tps.set_k(0.5)
 
 
+def test_threaded_resample_matches_serial():
+    """Test that resampling on several threads gives the serial result."""
+    import warptps
+    tps = warptps.TPSTransform()
+    add_warp_landmarks(tps, 64, 48)
+
+    src = make_test_image(64, 48)
+    serial = np.zeros_like(src)
+    threaded = np.zeros_like(src)
+
+    tps.resample(src, serial, percent=1.0)
+    tps.set_thread_count(4)
+    assert tps.get_thread_count() == 4
+    tps.resample(src, threaded, percent=1.0)
+    assert np.array_equal(serial, threaded)
+
+
+def test_compact_field_formats():
+    """Test that compact field formats warp nearly as the double field does."""
+    import warptps
+    tps = warptps.TPSTransform()
+    add_warp_landmarks(tps, 64, 48)
+
+    src = make_test_image(64, 48)
+    expected = np.zeros_like(src)
+    tps.resample_with_field(src, expected, percent=1.0)
+
+    for field_format in (warptps.FieldFormat.FLOAT, warptps.FieldFormat.FIXED16):
+        tps.set_field_format(field_format, subpixels=64.0)
+        assert tps.get_field_format() == field_format
+        actual = np.zeros_like(src)
+        tps.resample_with_field(src, actual, percent=1.0)
+        assert np.count_nonzero(actual != expected) < actual.size // 20
+
+
+def test_single_precision():
+    """Test that a float32 presample warps nearly as the double one does."""
+    import warptps
+    tps = warptps.TPSTransform()
+    add_warp_landmarks(tps, 128, 96)
+
+    src = make_test_image(128, 96)
+    expected = np.zeros_like(src)
+    tps.resample_with_field(src, expected, percent=1.0)
+
+    tps.set_single_precision(True)
+    assert tps.get_single_precision()
+    actual = np.zeros_like(src)
+    tps.resample_with_field(src, actual, percent=1.0)
+    assert np.count_nonzero(actual != expected) < actual.size // 100
+
+
+def test_compiled_snapshot():
+    """Test that a snapshot renders as its transform did, from several threads."""
+    from concurrent.futures import ThreadPoolExecutor
+    import warptps
+    tps = warptps.TPSTransform()
+    add_warp_landmarks(tps, 128, 96)
+
+    src = make_test_image(128, 96)
+    expected = np.zeros_like(src)
+    tps.resample_with_field(src, expected, percent=1.0)
+    snapshot = tps.compile(128, 96)
+    assert snapshot.get_landmark_count() == 4
+    assert snapshot.has_presampled_field(128, 96)
+
+    # the transform changes, the snapshot does not
+    tps.add_landmark_tuple((100, 70), (90, 75))
+
+    def render(_):
+        actual = np.zeros_like(src)
+        snapshot.resample_with_field(src, actual, percent=1.0)
+        return actual
+
+    with ThreadPoolExecutor(max_workers=4) as pool:
+        for actual in pool.map(render, range(4)):
+            np.testing.assert_array_equal(actual, expected)
+
+
+def test_presample_tolerance():
+    """Test that a lattice presample warps nearly as the exact one does."""
+    import warptps
+    tps = warptps.TPSTransform()
+    add_warp_landmarks(tps, 128, 96)
+
+    src = make_test_image(128, 96)
+    expected = np.zeros_like(src)
+    tps.resample_with_field(src, expected, percent=1.0)
+
+    tps.set_presample_tolerance(0.01)
+    assert tps.get_presample_tolerance() == 0.01
+    actual = np.zeros_like(src)
+    tps.resample_with_field(src, actual, percent=1.0)
+    assert np.count_nonzero(actual != expected) < actual.size // 20
+
+
+def test_far_field_theta():
+    """Test that the far field tree transforms points as the exact sum does."""
+    import warptps
+    rng = np.random.default_rng(12)
+    tps = warptps.TPSTransform()
+    for _ in range(200):
+        src_pt = rng.uniform(0, 256, 2)
+        dst_pt = src_pt + rng.uniform(-4, 4, 2)
+        tps.add_landmark_tuple(tuple(src_pt), tuple(dst_pt))
+
+    points = rng.uniform(0, 256, (100, 2))
+    expected = tps.transform_points(points, percent=1.0)
+
+    tps.set_far_field_theta(0.5)
+    assert tps.get_far_field_theta() == 0.5
+    actual = tps.transform_points(points, percent=1.0)
+    np.testing.assert_allclose(actual, expected, atol=1e-3)
+
+
+def test_iterative_solve():
+    """Test that the GMRES solve transforms points as the dense solve does."""
+    import warptps
+    rng = np.random.default_rng(13)
+    dense = warptps.TPSTransform()
+    iterative = warptps.TPSTransform()
+    iterative.set_iterative_solve_threshold(100)
+    assert iterative.get_iterative_solve_threshold() == 100
+    for _ in range(300):
+        src_pt = rng.uniform(0, 512, 2)
+        dst_pt = src_pt + rng.uniform(-4, 4, 2)
+        dense.add_landmark_tuple(tuple(src_pt), tuple(dst_pt))
+        iterative.add_landmark_tuple(tuple(src_pt), tuple(dst_pt))
+
+    points = rng.uniform(0, 512, (100, 2))
+    np.testing.assert_allclose(iterative.transform_points(points),
+                               dense.transform_points(points), atol=1e-5)
+    assert iterative.get_iterative_solve_iterations() > 0
+
+
+def test_mixed_precision_solve():
+    """Test that the refined float32 solve transforms points as the dense solve does."""
+    import warptps
+    rng = np.random.default_rng(17)
+    dense = warptps.TPSTransform()
+    mixed = warptps.TPSTransform()
+    mixed.set_mixed_precision_threshold(100)
+    assert mixed.get_mixed_precision_threshold() == 100
+    for _ in range(200):
+        src_pt = rng.uniform(0, 1024, 2)
+        dst_pt = src_pt + rng.uniform(-8, 8, 2)
+        dense.add_landmark_tuple(tuple(src_pt), tuple(dst_pt))
+        mixed.add_landmark_tuple(tuple(src_pt), tuple(dst_pt))
+
+    points = rng.uniform(0, 1024, (100, 2))
+    np.testing.assert_allclose(mixed.transform_points(points),
+                               dense.transform_points(points), atol=1e-8)
+    assert mixed.get_mixed_precision_residual() <= 1e-13
+    assert mixed.get_condition_estimate() > 1.0
+
+
+def test_scaled_kernels():
+    """Test that the kernels with a length scale interpolate the landmarks."""
+    import warptps
+    tps = warptps.TPSTransform()
+    src = np.array([[0, 0], [0, 150], [200, 150], [200, 0], [60, 60], [140, 90]], dtype=float)
+    dst = src + np.array([[0, 0], [0, 0], [0, 0], [0, 0], [10, -15], [-20, 10]], dtype=float)
+    for src_pt, dst_pt in zip(src, dst):
+        tps.add_landmark_tuple(tuple(src_pt), tuple(dst_pt))
+
+    for kernel in (warptps.KernelType.GAUSSIAN, warptps.KernelType.MULTIQUADRIC,
+                   warptps.KernelType.INVERSE_MULTIQUADRIC):
+        tps.set_kernel(kernel, 60.0)
+        assert tps.get_kernel_type() == kernel
+        assert tps.get_kernel_scale() == 60.0
+        np.testing.assert_allclose(tps.transform_points(src), dst, atol=1e-6)
+
+    tps.set_kernel(warptps.KernelType.THIN_PLATE, 0.0)
+    assert tps.get_kernel_type() == warptps.KernelType.THIN_PLATE
+
+
+def test_compact_support():
+    """Test that a compactly supported basis interpolates and is affine far away."""
+    import warptps
+    rng = np.random.default_rng(15)
+    tps = warptps.TPSTransform()
+    src = rng.uniform(0, 64, (300, 2))
+    dst = src + rng.uniform(-4, 4, (300, 2))
+    for src_pt, dst_pt in zip(src, dst):
+        tps.add_landmark_tuple(tuple(src_pt), tuple(dst_pt))
+    tps.set_support_radius(20.0, continuity=4)
+    assert tps.get_support_radius() == 20.0
+
+    np.testing.assert_allclose(tps.transform_points(src), dst, atol=1e-6)
+
+    far = np.array([[100.0, 10.0], [120.0, 50.0], [140.0, 90.0]])
+    offsets = tps.transform_points(far) - far
+    np.testing.assert_allclose(2.0 * offsets[1], offsets[0] + offsets[2], atol=1e-9)
+
+
+def test_approximate_centers():
+    """Test that a least squares fit on fewer centers follows dense samples of a warp."""
+    import warptps
+    rng = np.random.default_rng(14)
+    exact = warptps.TPSTransform()
+    for _ in range(12):
+        src_pt = rng.uniform(0, 384, 2)
+        dst_pt = src_pt + rng.uniform(-10, 10, 2)
+        exact.add_landmark_tuple(tuple(src_pt), tuple(dst_pt))
+
+    samples = rng.uniform(0, 384, (2000, 2))
+    warped = exact.transform_points(samples)
+    approx = warptps.TPSTransform()
+    for src_pt, dst_pt in zip(samples, warped):
+        approx.add_landmark_tuple(tuple(src_pt), tuple(dst_pt))
+    approx.set_approximate_center_count(100)
+    assert approx.get_approximate_center_count() == 100
+    approx.set_approximate_regularization(1000.0)
+    assert approx.get_approximate_regularization() == 1000.0
+
+    points = rng.uniform(48, 336, (100, 2))
+    np.testing.assert_allclose(approx.transform_points(points),
+                               exact.transform_points(points), atol=1.0)
+
+
+def test_drag_destination_with_basis_fields():
+    """Test that cached basis fields give the same warp as a fresh transform."""
+    import warptps
+    landmarks = [((0, 0), (0, 0)), ((63, 0), (63, 0)), ((0, 47), (0, 47)),
+                 ((63, 47), (63, 47)), ((30, 20), (36, 25))]
+    tps = warptps.TPSTransform()
+    for src_pt, dst_pt in landmarks:
+        tps.add_landmark_tuple(src_pt, dst_pt)
+    tps.set_basis_field_cache_size(1 << 20)
+    assert tps.get_basis_field_cache_size() == 1 << 20
+
+    src = make_test_image(64, 48)
+    cached = np.zeros_like(src)
+    tps.resample_with_field(src, cached, percent=1.0)
+    for step in range(3):
+        tps.set_landmark_tuple(4, (30, 20), (36 + step, 25 - step))
+        tps.resample_with_field(src, cached, percent=1.0)
+
+    fresh = warptps.TPSTransform()
+    for src_pt, dst_pt in landmarks[:4]:
+        fresh.add_landmark_tuple(src_pt, dst_pt)
+    fresh.add_landmark_tuple((30, 20), (38, 23))
+    expected = np.zeros_like(src)
+    fresh.resample_with_field(src, expected, percent=1.0)
+    assert np.count_nonzero(cached != expected) < cached.size // 100
+
+
 def test_eval_with_landmarks():
     """Test evaluating displacement at a point."""
     import warptps
@@ -102,6 +454,26 @@ def test_eval_with_landmarks():
     assert len(offset) == 3
 
 
+def test_eval_points_matches_eval():
+    """Test that batch evaluation matches single point evaluation."""
+    import warptps
+    tps = warptps.TPSTransform()
+
+    tps.add_landmark_tuple((100, 100), (110, 110))
+    tps.add_landmark_tuple((200, 100), (210, 100))
+    tps.add_landmark_tuple((150, 200), (150, 210))
+    tps.add_landmark_tuple((120, 160), (125, 150))
+
+    positions = np.array([[150.0, 150.0], [90.5, 120.25], [210.0, 190.0]])
+    offsets = tps.eval_points(positions, percent=0.5)
+    assert offsets.shape == (3, 2)
+
+    for pos, offset in zip(positions, offsets):
+        expected = tps.eval((pos[0], pos[1]), percent=0.5)
+        assert offset[0] == pytest.approx(expected[0])
+        assert offset[1] == pytest.approx(expected[1])
+
+
 def test_transform_points():
     """Test transforming multiple points."""
     import warptps